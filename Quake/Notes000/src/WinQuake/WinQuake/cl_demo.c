@@ -21,6 +21,54 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "quakedef.h"
 
 void CL_FinishTimeDemo (void);
+static void CL_BenchmarkRunDone (qboolean failed);
+static void CL_BenchmarkFinish (void);
+
+// benchmark plays a list of demos as timedemos, over and over, keeping the
+// time of every frame; at the end it writes the statistics to
+// bench_output.json and the frames to bench_output.csv, and a headless
+// process quits with a status a test script can check
+#define	MAX_BENCHDEMOS	16
+
+#define	BENCH_OK		0
+#define	BENCH_SLOW		1		// missed bench_minfps or bench_maxp99
+#define	BENCH_FAILED	2		// a demo couldn't be played
+
+cvar_t	bench_output = {"bench_output", "benchmark"};
+cvar_t	bench_minfps = {"bench_minfps", "0"};	// 0 is no limit
+cvar_t	bench_maxp99 = {"bench_maxp99", "0"};	// ms, 0 is no limit
+
+// the host part is whatever the frame spent outside the server and the
+// screen update, so the three add up to the whole frame
+typedef struct
+{
+	float		frame;						// seconds
+	float		host, render, server;
+} benchframe_t;
+
+typedef struct
+{
+	int			demo, pass;
+	int			firstframe, numframes;
+	qboolean	failed;
+} benchrun_t;
+
+typedef struct
+{
+	int			frames;
+	double		seconds, fps;
+	double		mean, median, p99, worst;	// ms per host frame
+	double		host, render, server;		// mean ms
+} benchstats_t;
+
+static qboolean		cl_benchmark;
+static char			cl_benchdemos[MAX_BENCHDEMOS][MAX_QPATH];
+static int			cl_numbenchdemos, cl_benchpasses;
+static benchrun_t	*cl_benchruns;
+static int			cl_numbenchruns;		// started so far
+static benchframe_t	*cl_benchframes;
+static int			cl_numbenchframes, cl_maxbenchframes;
+static double		cl_benchlastframe;
 
 /*
 ==============================================================================
@@ -39,7 +87,8 @@ read from the demo file.
 ==============
 CL_StopPlayback
 
-Called when a demo file runs out, or the user starts a game
+Called when a demo file runs out, or the user starts a game, or an error
+disconnects the client
 ==============
 */
 void CL_StopPlayback (void)
@@ -54,6 +103,7 @@ void CL_StopPlayback (void)
 
 	if (cls.timedemo)
 		CL_FinishTimeDemo ();
+	cls.td_ended = false;
 }
 
 /*
@@ -128,6 +178,7 @@ int CL_GetMessage (void)
 		r = fread (net_message.data, net_message.cursize, 1, cls.demofile);
 		if (r != 1)
 		{
+			cls.td_ended = true;
 			CL_StopPlayback ();
 			return 0;
 		}
@@ -335,6 +386,17 @@ void CL_FinishTimeDemo (void)
 	if (!time)
 		time = 1;
 	Con_Printf ("%i frames %5.1f seconds %5.1f fps\n", frames, time, frames/time);
+
+// a run cut short by Host_Error, Host_EndGame or a disconnect doesn't count
+	if (cl_benchmark)
+	{
+		CL_BenchmarkRunDone (!cls.td_ended);
+		return;
+	}
+
+// headless benchmark runs have nobody to hand the console back to
+	if (COM_CheckParm ("-timedemoquit"))
+		Cbuf_AddText ("quit\n");
 }
 
 /*
@@ -356,6 +418,15 @@ void CL_TimeDemo_f (void)
 	}
 
 	CL_PlayDemo_f ();
+	if (!cls.demoplayback)
+	{
+		if (cl_benchmark)
+			CL_BenchmarkRunDone (true);
+		return;
+	}
+
+// the console would cover part of the view being timed
+	key_dest = key_game;
 	
 // cls.td_starttime will be grabbed at the second frame of the demo, so
 // all the loading time doesn't get counted
@@ -365,3 +436,377 @@ void CL_TimeDemo_f (void)
 	cls.td_lastframe = -1;		// get a new message this frame
 }
 
+
+
+/*
+==============================================================================
+
+BENCHMARK
+
+==============================================================================
+*/
+
+/*
+====================
+CL_BenchmarkNext
+
+Starts the next run, or writes the results when they have all been played
+====================
+*/
+static void CL_BenchmarkNext (void)
+{
+	benchrun_t	*run;
+	char		str[MAX_QPATH + 16];
+
+	if (cl_numbenchruns == cl_numbenchdemos * cl_benchpasses)
+	{
+		CL_BenchmarkFinish ();
+		return;
+	}
+
+// every demo once before any of them again, so a slow spell on the machine
+// doesn't all land on one demo
+	run = &cl_benchruns[cl_numbenchruns];
+	run->demo = cl_numbenchruns % cl_numbenchdemos;
+	run->pass = cl_numbenchruns / cl_numbenchdemos + 1;
+	run->firstframe = cl_numbenchframes;
+	run->numframes = 0;
+	run->failed = false;
+	cl_numbenchruns++;
+
+	snprintf (str, sizeof(str), "timedemo %s\n", cl_benchdemos[run->demo]);
+	Cbuf_InsertText (str);
+}
+
+/*
+====================
+CL_BenchmarkRunDone
+====================
+*/
+static void CL_BenchmarkRunDone (qboolean failed)
+{
+	benchrun_t	*run;
+
+	run = &cl_benchruns[cl_numbenchruns - 1];
+	run->numframes = cl_numbenchframes - run->firstframe;
+	run->failed = failed;
+
+	CL_BenchmarkNext ();
+}
+
+/*
+====================
+CL_BenchmarkFrame
+
+Called at the end of every host frame with the time spent in the server and
+in the screen update.  The frame that loaded the demo isn't kept, the same
+as in the timedemo count
+====================
+*/
+void CL_BenchmarkFrame (double server, double render)
+{
+	benchframe_t	*f;
+	double			now;
+
+	if (!cl_benchmark)
+		return;
+
+	now = Sys_FloatTime ();
+
+	if (cls.timedemo && host_framecount > cls.td_startframe)
+	{
+		if (cl_numbenchframes == cl_maxbenchframes)
+		{
+			cl_maxbenchframes = cl_maxbenchframes ? cl_maxbenchframes * 2 : 4096;
+			cl_benchframes = realloc (cl_benchframes,
+					cl_maxbenchframes * sizeof(*cl_benchframes));
+			if (!cl_benchframes)
+				Sys_Error ("CL_BenchmarkFrame: out of memory");
+		}
+		f = &cl_benchframes[cl_numbenchframes++];
+		f->frame = now - cl_benchlastframe;
+		f->host = f->frame - render - server;
+		f->render = render;
+		f->server = server;
+	}
+
+	cl_benchlastframe = now;
+}
+
+/*
+====================
+CL_BenchmarkStats
+
+Over the runs of one demo, in one pass or in all of them if pass is 0
+====================
+*/
+static void CL_BenchmarkStats (int demo, int pass, benchstats_t *st)
+{
+	benchrun_t		*run;
+	benchframe_t	*f;
+	float			*times;
+	double			frame, host, render, server;
+	int				i, j, n;
+
+	memset (st, 0, sizeof(*st));
+
+	n = 0;
+	for (i=0, run=cl_benchruns ; i<cl_numbenchruns ; i++, run++)
+		if (run->demo == demo && (!pass || run->pass == pass))
+			n += run->numframes;
+	if (!n)
+		return;
+
+	times = malloc (n * sizeof(*times));
+	if (!times)
+		Sys_Error ("CL_BenchmarkStats: out of memory");
+
+	n = 0;
+	frame = host = render = server = 0;
+	for (i=0, run=cl_benchruns ; i<cl_numbenchruns ; i++, run++)
+	{
+		if (run->demo != demo || (pass && run->pass != pass))
+			continue;
+		for (j=0, f=cl_benchframes + run->firstframe ; j<run->numframes ; j++, f++)
+		{
+			times[n++] = f->frame * 1000;
+			frame += f->frame;
+			host += f->host;
+			render += f->render;
+			server += f->server;
+		}
+	}
+	qsort (times, n, sizeof(*times), CompareFloats);
+
+	st->frames = n;
+	st->seconds = frame;
+	st->fps = frame > 0 ? n / frame : 0;
+	st->mean = frame * 1000 / n;
+	st->median = (n & 1) ? times[n/2] : (times[n/2 - 1] + times[n/2]) * 0.5;
+	st->p99 = times[(int)ceil (n * 0.99) - 1];
+	st->worst = times[n - 1];
+	st->host = host * 1000 / n;
+	st->render = render * 1000 / n;
+	st->server = server * 1000 / n;
+
+	free (times);
+}
+
+/*
+====================
+CL_BenchmarkWriteStats
+====================
+*/
+static void CL_BenchmarkWriteStats (FILE *f, benchstats_t *st)
+{
+	fprintf (f, "\"frames\": %i, \"seconds\": %.4f, \"fps\": %.3f, "
+		"\"mean_ms\": %.4f, \"median_ms\": %.4f, \"p99_ms\": %.4f, "
+		"\"worst_ms\": %.4f, \"host_ms\": %.4f, \"render_ms\": %.4f, "
+		"\"server_ms\": %.4f", st->frames, st->seconds, st->fps, st->mean,
+		st->median, st->p99, st->worst, st->host, st->render, st->server);
+}
+
+/*
+====================
+CL_BenchmarkFinish
+
+Works out the statistics and the exit status, and writes the results
+====================
+*/
+static void CL_BenchmarkFinish (void)
+{
+	benchstats_t	st;
+	benchrun_t		*run;
+	benchframe_t	*fr;
+	char			name[MAX_OSPATH];
+	FILE			*f;
+	int				i, j, d, status, failed;
+
+	cl_benchmark = false;
+	status = BENCH_OK;
+
+	snprintf (name, sizeof(name), "%s/%s.json", com_gamedir, bench_output.string);
+	f = fopen (name, "w");
+	if (!f)
+	{
+		Con_Printf ("couldn't open %s\n", name);
+		status = BENCH_FAILED;
+	}
+	else
+		fprintf (f, "{\n  \"passes\": %i,\n  \"demos\": [", cl_benchpasses);
+
+	for (d=0 ; d<cl_numbenchdemos ; d++)
+	{
+		failed = 0;
+		for (i=0, run=cl_benchruns ; i<cl_numbenchruns ; i++, run++)
+			if (run->demo == d && run->failed)
+				failed++;
+
+		CL_BenchmarkStats (d, 0, &st);
+		if (failed || !st.frames)
+		{
+			Con_Printf ("%s: couldn't be played\n", cl_benchdemos[d]);
+			status = BENCH_FAILED;
+		}
+		else
+		{
+			Con_Printf ("%s: %i frames %.1f fps, ms mean %.2f median %.2f "
+				"p99 %.2f worst %.2f host %.2f render %.2f server %.2f\n",
+				cl_benchdemos[d], st.frames, st.fps, st.mean, st.median,
+				st.p99, st.worst, st.host, st.render, st.server);
+			if ((bench_minfps.value && st.fps < bench_minfps.value) ||
+				(bench_maxp99.value && st.p99 > bench_maxp99.value))
+			{
+				Con_Printf ("%s: too slow\n", cl_benchdemos[d]);
+				if (status == BENCH_OK)
+					status = BENCH_SLOW;
+			}
+		}
+
+		if (!f)
+			continue;
+
+		fprintf (f, "%s\n    {\"demo\": \"%s\", \"failed\": %s, ",
+			d ? "," : "", cl_benchdemos[d], failed ? "true" : "false");
+		CL_BenchmarkWriteStats (f, &st);
+		fprintf (f, ",\n     \"passes\": [");
+		for (i=1 ; i<=cl_benchpasses ; i++)
+		{
+			CL_BenchmarkStats (d, i, &st);
+			fprintf (f, "%s\n      {\"pass\": %i, ", i > 1 ? "," : "", i);
+			CL_BenchmarkWriteStats (f, &st);
+			fprintf (f, "}");
+		}
+		fprintf (f, "]}");
+	}
+
+	if (f)
+	{
+		fprintf (f, "\n  ],\n  \"status\": %i\n}\n", status);
+		fclose (f);
+		Con_Printf ("wrote %s\n", name);
+	}
+
+	snprintf (name, sizeof(name), "%s/%s.csv", com_gamedir, bench_output.string);
+	f = fopen (name, "w");
+	if (!f)
+	{
+		Con_Printf ("couldn't open %s\n", name);
+		status = BENCH_FAILED;
+	}
+	else
+	{
+		fprintf (f, "demo,pass,frame,frame_ms,host_ms,render_ms,server_ms\n");
+		for (i=0, run=cl_benchruns ; i<cl_numbenchruns ; i++, run++)
+		{
+			for (j=0, fr=cl_benchframes + run->firstframe ; j<run->numframes ; j++, fr++)
+				fprintf (f, "%s,%i,%i,%.4f,%.4f,%.4f,%.4f\n",
+					cl_benchdemos[run->demo], run->pass, j, fr->frame * 1000,
+					fr->host * 1000, fr->render * 1000, fr->server * 1000);
+		}
+		fclose (f);
+		Con_Printf ("wrote %s\n", name);
+	}
+
+	Con_Printf ("benchmark status %i\n", status);
+
+	free (cl_benchruns);
+	cl_benchruns = NULL;
+	free (cl_benchframes);
+	cl_benchframes = NULL;
+	cl_numbenchframes = cl_maxbenchframes = 0;
+
+// nobody is there to read the console
+	if (host_headless)
+	{
+		host_exitcode = status;
+		Cbuf_AddText ("quit\n");
+	}
+}
+
+/*
+====================
+CL_BenchmarkRefuse
+
+A headless client quits with BENCH_FAILED instead of waiting for a command
+that will never come
+====================
+*/
+static void CL_BenchmarkRefuse (char *msg)
+{
+	Con_Printf ("benchmark: %s\n", msg);
+	if (host_headless)
+	{
+		host_exitcode = BENCH_FAILED;
+		Cbuf_AddText ("quit\n");
+	}
+}
+
+/*
+====================
+CL_Benchmark_f
+
+benchmark <passes> <demoname> [demoname ...]
+====================
+*/
+void CL_Benchmark_f (void)
+{
+	int		i;
+	char	*name, *c;
+
+	if (cmd_source != src_command)
+		return;
+
+	if (Cmd_Argc () < 3)
+	{
+		Con_Printf ("benchmark <passes> <demoname> [demoname ...] : times "
+			"demos into %s.json and .csv\n", bench_output.string);
+		return;
+	}
+
+	if (cl_benchmark)
+	{
+		Con_Printf ("a benchmark is already running\n");
+		return;
+	}
+
+	cl_benchpasses = Q_atoi (Cmd_Argv (1));
+	if (cl_benchpasses < 1)
+		cl_benchpasses = 1;
+
+	cl_numbenchdemos = Cmd_Argc () - 2;
+	if (cl_numbenchdemos > MAX_BENCHDEMOS)
+	{
+		Con_Printf ("only the first %i demos will be played\n", MAX_BENCHDEMOS);
+		cl_numbenchdemos = MAX_BENCHDEMOS;
+	}
+	for (i=0 ; i<cl_numbenchdemos ; i++)
+	{
+	// the names go into the json and csv as they are
+		name = Cmd_Argv (i + 2);
+		for (c=name ; *c ; c++)
+			if (*c == '"' || *c == '\\' || *c == ',' || (unsigned char)*c < ' ')
+				break;
+		if (*c)
+		{
+			CL_BenchmarkRefuse ("demo names can't have quotes, backslashes or commas");
+			return;
+		}
+		Q_strncpy (cl_benchdemos[i], name, MAX_QPATH - 1);
+		cl_benchdemos[i][MAX_QPATH - 1] = 0;
+	}
+
+	cl_benchruns = malloc (cl_numbenchdemos * cl_benchpasses *
+			sizeof(*cl_benchruns));
+	if (!cl_benchruns)
+	{
+		CL_BenchmarkRefuse ("out of memory");
+		return;
+	}
+	cl_numbenchruns = 0;
+	cl_numbenchframes = 0;
+
+	cls.demonum = -1;		// the demo loop mustn't start anything between runs
+	cl_benchmark = true;
+	CL_BenchmarkNext ();
+}
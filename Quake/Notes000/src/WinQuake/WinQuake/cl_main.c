@@ -44,14 +44,14 @@ cvar_t	m_side = {"m_side","0.8", true};
 client_static_t	cls;
 client_state_t	cl;
 // FIXME: put these on hunk?
-efrag_t			cl_efrags[MAX_EFRAGS];
 entity_t		cl_entities[MAX_EDICTS];
 entity_t		cl_static_entities[MAX_STATIC_ENTITIES];
 lightstyle_t	cl_lightstyle[MAX_LIGHTSTYLES];
 dlight_t		cl_dlights[MAX_DLIGHTS];
 
 int				cl_numvisedicts;
-entity_t		*cl_visedicts[MAX_VISEDICTS];
+entity_t		**cl_visedicts;
+static int		cl_maxvisedicts;
 
 /*
 =====================
@@ -61,8 +61,6 @@ CL_ClearState
 */
 void CL_ClearState (void)
 {
-	int			i;
-
 	if (!sv.active)
 		Host_ClearMemory ();
 
@@ -72,7 +70,6 @@ void CL_ClearState (void)
 	SZ_Clear (&cls.message);
 
 // clear other arrays	
-	memset (cl_efrags, 0, sizeof(cl_efrags));
 	memset (cl_entities, 0, sizeof(cl_entities));
 	memset (cl_dlights, 0, sizeof(cl_dlights));
 	memset (cl_lightstyle, 0, sizeof(cl_lightstyle));
@@ -80,12 +77,9 @@ void CL_ClearState (void)
 	memset (cl_beams, 0, sizeof(cl_beams));
 
 //
-// allocate the efrags and chain together into a free list
+// chain the efrags together into a free list
 //
-	cl.free_efrags = cl_efrags;
-	for (i=0 ; i<MAX_EFRAGS-1 ; i++)
-		cl.free_efrags[i].entnext = &cl.free_efrags[i+1];
-	cl.free_efrags[i].entnext = NULL;
+	R_ClearEfrags ();
 }
 
 /*
@@ -614,16 +608,34 @@ void CL_RelinkEntities (void)
 		if ( ent->effects & EF_NODRAW )
 			continue;
 #endif
-		if (cl_numvisedicts < MAX_VISEDICTS)
-		{
-			cl_visedicts[cl_numvisedicts] = ent;
-			cl_numvisedicts++;
-		}
+		CL_AddVisEdict (ent);
 	}
 
 }
 
 
+/*
+===============
+CL_AddVisEdict
+
+Adds an entity to the ones drawn this frame, growing the list when it fills
+===============
+*/
+void CL_AddVisEdict (entity_t *ent)
+{
+	if (cl_numvisedicts == cl_maxvisedicts)
+	{
+		cl_maxvisedicts = cl_maxvisedicts ? cl_maxvisedicts * 2 : 256;
+		cl_visedicts = realloc (cl_visedicts,
+				cl_maxvisedicts * sizeof(*cl_visedicts));
+		if (!cl_visedicts)
+			Sys_Error ("CL_AddVisEdict: out of memory");
+	}
+
+	cl_visedicts[cl_numvisedicts++] = ent;
+}
+
+
 /*
 ===============
 CL_ReadFromServer
@@ -753,5 +765,10 @@ void CL_Init (void)
 	Cmd_AddCommand ("stop", CL_Stop_f);
 	Cmd_AddCommand ("playdemo", CL_PlayDemo_f);
 	Cmd_AddCommand ("timedemo", CL_TimeDemo_f);
+
+	Cvar_RegisterVariable (&bench_output);
+	Cvar_RegisterVariable (&bench_minfps);
+	Cvar_RegisterVariable (&bench_maxp99);
+	Cmd_AddCommand ("benchmark", CL_Benchmark_f);
 }
 
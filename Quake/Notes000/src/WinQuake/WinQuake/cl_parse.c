@@ -787,6 +787,8 @@ void CL_ParseServerMessage (void)
 			break;
 			
 		case svc_disconnect:
+			if (cls.demoplayback)
+				cls.td_ended = true;	// how a recorded demo ends
 			Host_EndGame ("Server disconnected\n");
 
 		case svc_print:
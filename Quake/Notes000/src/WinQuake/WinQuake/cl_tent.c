@@ -302,15 +302,12 @@ entity_t *CL_NewTempEntity (void)
 {
 	entity_t	*ent;
 
-	if (cl_numvisedicts == MAX_VISEDICTS)
-		return NULL;
 	if (num_temp_entities == MAX_TEMP_ENTITIES)
 		return NULL;
 	ent = &cl_temp_entities[num_temp_entities];
 	memset (ent, 0, sizeof(*ent));
 	num_temp_entities++;
-	cl_visedicts[cl_numvisedicts] = ent;
-	cl_numvisedicts++;
+	CL_AddVisEdict (ent);
 
 	ent->colormap = vid.colormap;
 	return ent;
@@ -862,15 +862,16 @@ void COM_FileBase (char *in, char *out)
 	while (s != in && *s != '.')
 		s--;
 	
-	for (s2 = s ; *s2 && *s2 != '/' ; s2--)
+	for (s2 = s ; s2 != in && *s2 != '/' ; s2--)
 	;
+	if (*s2 == '/')
+		s2++;
 	
-	if (s-s2 < 2)
+	if (s-s2 < 1)
 		strcpy (out,"?model?");
 	else
 	{
-		s--;
-		strncpy (out,s2+1, s-s2);
+		strncpy (out,s2, s-s2);
 		out[s-s2] = 0;
 	}
 }
@@ -24,6 +24,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #endif
 #ifndef _MSC_VER
 #include <unistd.h>
+#define _unlink unlink
 #endif
 #include <fcntl.h>
 #include "quakedef.h"
@@ -60,6 +61,14 @@ extern	int		key_linepos;
 
 qboolean	con_initialized;
 
+// messages printed off the main thread wait here for Con_FlushQueue, one
+// null terminated string after another
+#define		CON_QUEUESIZE	16384
+void		*con_queuelock;
+char		con_queue[CON_QUEUESIZE];
+int			con_queuelen;
+int			con_queuedropped;
+
 int			con_notifylines;		// scan lines to clear for notify lines
 
 extern void M_Menu_Main_f (void);
@@ -226,6 +235,8 @@ void Con_Init (void)
 		}
 	}
 
+	con_queuelock = Sys_CreateMutex ();
+
 	con_text = Hunk_AllocName (CON_TEXTSIZE, "context");
 	Q_memset (con_text, ' ', CON_TEXTSIZE);
 	con_linewidth = -1;
@@ -365,6 +376,59 @@ void Con_DebugLog(char *file, char *fmt, ...)
 }
 
 
+#define	MAXPRINTMSG	4096
+
+/*
+================
+Con_Queue
+================
+*/
+static void Con_Queue (char *msg)
+{
+	int		len;
+
+	len = strlen (msg) + 1;
+
+	Sys_LockMutex (con_queuelock);
+	if (con_queuelen + len > CON_QUEUESIZE)
+		con_queuedropped++;
+	else
+	{
+		memcpy (con_queue + con_queuelen, msg, len);
+		con_queuelen += len;
+	}
+	Sys_UnlockMutex (con_queuelock);
+}
+
+/*
+================
+Con_FlushQueue
+
+Prints the messages other threads have queued.  Main thread only
+================
+*/
+void Con_FlushQueue (void)
+{
+	static char	queue[CON_QUEUESIZE];
+	int			i, len, dropped;
+
+	if (!con_queuelock)
+		return;
+
+	Sys_LockMutex (con_queuelock);
+	len = con_queuelen;
+	memcpy (queue, con_queue, len);
+	con_queuelen = 0;
+	dropped = con_queuedropped;
+	con_queuedropped = 0;
+	Sys_UnlockMutex (con_queuelock);
+
+	for (i=0 ; i<len ; i += strlen (queue + i) + 1)
+		Con_Printf ("%s", queue + i);
+	if (dropped)
+		Con_Printf ("%i messages from other threads dropped\n", dropped);
+}
+
 /*
 ================
 Con_Printf
@@ -372,7 +436,6 @@ Con_Printf
 Handles cursor positioning, line wrapping, etc
 ================
 */
-#define	MAXPRINTMSG	4096
 // FIXME: make a buffer size safe vsprintf?
 void Con_Printf (char *fmt, ...)
 {
@@ -383,6 +446,13 @@ void Con_Printf (char *fmt, ...)
 	va_start (argptr,fmt);
 	vsprintf (msg,fmt,argptr);
 	va_end (argptr);
+
+// the server thread can't write the console while the main thread draws it
+	if (con_queuelock && !Sys_IsMainThread ())
+	{
+		Con_Queue (msg);
+		return;
+	}
 	
 // also echo to debugging console
 	Sys_Printf ("%s", msg);	// also echo to debugging console
@@ -401,7 +471,8 @@ void Con_Printf (char *fmt, ...)
 	Con_Print (msg);
 	
 // update the screen if the console is displayed
-	if (cls.signon != SIGNONS && !scr_disabled_for_loading )
+// (never from the server thread, the main thread may be drawing)
+	if (cls.signon != SIGNONS && !scr_disabled_for_loading && Sys_IsMainThread ())
 	{
 	// protect against infinite loop if something in SCR_UpdateScreen calls
 	// Con_Printd
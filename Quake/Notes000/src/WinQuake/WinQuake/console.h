@@ -35,6 +35,7 @@ void Con_Init (void);
 void Con_DrawConsole (int lines, qboolean drawinput);
 void Con_Print (char *txt);
 void Con_Printf (char *fmt, ...);
+void Con_FlushQueue (void);
 void Con_DPrintf (char *fmt, ...);
 void Con_SafePrintf (char *fmt, ...);
 void Con_Clear_f (void);
@@ -0,0 +1,281 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// d_blit.c: expansion of the 8 bit view to 32 bit pixels for display
+//
+// The renderer still draws palette indices.  A driver with a 32 bit surface
+// keeps a 256 entry table of display pixels, rebuilt from VID_SetPalette and
+// VID_ShiftPalette, and expands the finished frame through it once on the
+// way to the screen.  Only the offscreen driver's -bpp 32 presents this way
+// so far; vid_win.c still hands its palette to the display device.
+
+#include "quakedef.h"
+#include "d_local.h"
+
+#define	BLIT_BENCHFRAMES	4	// d_blitbench cycles through this many outputs
+
+static unsigned	*blit_dest;
+static int		blit_destpitch;
+static byte		*blit_src;
+static int		blit_srcrowbytes;
+static int		blit_width, blit_height;
+static unsigned	*blit_lut;
+
+
+/*
+=============
+D_BuildPalette32
+
+Fills lut with the display pixel for each index, blue in the low byte and
+opaque alpha in the high byte, which is how both DIB sections and 24 bit
+X visuals lay out a 32 bit pixel
+=============
+*/
+void D_BuildPalette32 (unsigned *lut, byte *palette)
+{
+	int		i;
+
+	for (i=0 ; i<256 ; i++, palette+=3)
+		lut[i] = 0xff000000 | (palette[0] << 16) | (palette[1] << 8) |
+				palette[2];
+}
+
+
+/*
+=============
+D_BlitRows32C
+
+The reference expansion, a table lookup per pixel
+=============
+*/
+static void D_BlitRows32C (unsigned *pdest, int destpitch, byte *psrc,
+	int srcrowbytes, int width, int height, unsigned *lut)
+{
+	int		x;
+
+	for ( ; height > 0 ; height--, pdest += destpitch, psrc += srcrowbytes)
+	{
+		for (x=0 ; x<width-3 ; x+=4)
+		{
+			pdest[x] = lut[psrc[x]];
+			pdest[x+1] = lut[psrc[x+1]];
+			pdest[x+2] = lut[psrc[x+2]];
+			pdest[x+3] = lut[psrc[x+3]];
+		}
+		for ( ; x<width ; x++)
+			pdest[x] = lut[psrc[x]];
+	}
+}
+
+
+#if idSSE2
+
+/*
+=============
+D_BlitRows32Stream
+
+The lookups are the same scalar ones as D_BlitRows32C; neither SSE2 nor
+NEON can index a 256 entry table of dwords.  What differs is the stores: the
+expanded frame is four times the size of the view and is not read again
+before the display takes it, so each group of four pixels goes out with a
+non-temporal store that skips reading the destination lines into the cache
+first.  There is no NEON version, as NEON intrinsics have no non-temporal
+store and the plain loop is all AArch64 would get
+=============
+*/
+static void D_BlitRows32Stream (unsigned *pdest, int destpitch, byte *psrc,
+	int srcrowbytes, int width, int height, unsigned *lut)
+{
+	int		x;
+
+	for ( ; height > 0 ; height--, pdest += destpitch, psrc += srcrowbytes)
+	{
+		for (x=0 ; x<width && ((size_t)&pdest[x] & 15) ; x++)
+			pdest[x] = lut[psrc[x]];
+
+		for ( ; x<width-3 ; x+=4)
+			_mm_stream_si128 ((__m128i *)&pdest[x],
+					_mm_setr_epi32 (lut[psrc[x]], lut[psrc[x+1]],
+						lut[psrc[x+2]], lut[psrc[x+3]]));
+
+		for ( ; x<width ; x++)
+			pdest[x] = lut[psrc[x]];
+	}
+
+	_mm_sfence ();
+}
+
+#endif
+
+
+/*
+=============
+D_BlitThread
+
+Each rasterizer thread expands its own band of rows
+=============
+*/
+static void D_BlitThread (int thread, int numthreads)
+{
+	int		v, vend;
+
+	v = blit_height * thread / numthreads;
+	vend = blit_height * (thread + 1) / numthreads;
+	if (v == vend)
+		return;
+
+#if idSSE2
+	if (d_simd.value)
+	{
+		D_BlitRows32Stream (blit_dest + v*blit_destpitch, blit_destpitch,
+				blit_src + v*blit_srcrowbytes, blit_srcrowbytes, blit_width,
+				vend - v, blit_lut);
+		return;
+	}
+#endif
+
+	D_BlitRows32C (blit_dest + v*blit_destpitch, blit_destpitch,
+			blit_src + v*blit_srcrowbytes, blit_srcrowbytes, blit_width,
+			vend - v, blit_lut);
+}
+
+
+/*
+=============
+D_Blit32
+
+Expands width by height indices from psrc into pdest through lut.  The pitches
+are in pixels of each buffer, so a driver can expand straight into a locked
+surface with padded rows.
+=============
+*/
+void D_Blit32 (unsigned *pdest, int destpitch, byte *psrc, int srcrowbytes,
+	int width, int height, unsigned *lut)
+{
+	blit_dest = pdest;
+	blit_destpitch = destpitch;
+	blit_src = psrc;
+	blit_srcrowbytes = srcrowbytes;
+	blit_width = width;
+	blit_height = height;
+	blit_lut = lut;
+
+	D_RunThreads (D_BlitThread);
+}
+
+
+/*
+=============
+D_TimeBlit
+
+Each pass writes the next of BLIT_BENCHFRAMES outputs, so that like a real
+frame the destination is not already in the cache
+=============
+*/
+static double D_TimeBlit (void (*blit) (unsigned *pdest, int destpitch,
+	byte *psrc, int srcrowbytes, int width, int height, unsigned *lut),
+	unsigned *buffer, byte *frame, unsigned *lut, int passes)
+{
+	double	start, time, best;
+	int		pass;
+
+	best = 1e9;
+	for (pass=0 ; pass<passes ; pass++)
+	{
+		start = Sys_FloatTime ();
+		blit (buffer + (pass % BLIT_BENCHFRAMES) * vid.width * vid.height,
+				vid.width, frame, vid.width, vid.width, vid.height, lut);
+		time = Sys_FloatTime () - start;
+		if (time < best)
+			best = time;
+	}
+	return best;
+}
+
+
+static unsigned	*d_blitbenchbuffer, d_blitbenchlut[256];
+static byte		*d_blitbenchframe;
+static int		d_blitbenchpasses;
+static double	d_blitbenchtime[2];
+
+/*
+=============
+D_BlitBenchRun
+=============
+*/
+static void D_BlitBenchRun (int mode)
+{
+	void	(*blit) (unsigned *pdest, int destpitch, byte *psrc,
+				int srcrowbytes, int width, int height, unsigned *lut);
+
+	blit = D_BlitRows32C;
+#if idSSE2
+	if (mode)
+		blit = D_BlitRows32Stream;
+#endif
+	d_blitbenchtime[mode] = D_TimeBlit (blit, d_blitbenchbuffer,
+			d_blitbenchframe, d_blitbenchlut, d_blitbenchpasses);
+}
+
+/*
+=============
+D_BlitBench_f
+
+Times the expansion of the current frame on the main thread, best of the
+given number of passes, and checks that the expansions agree.  The frame is
+copied first, since printing the results can redraw the screen.
+=============
+*/
+void D_BlitBench_f (void)
+{
+	int			i, pixels, differ;
+
+	d_blitbenchpasses = 100;
+	if (Cmd_Argc () > 1)
+		d_blitbenchpasses = Q_atoi (Cmd_Argv (1));
+	if (d_blitbenchpasses < 1)
+		d_blitbenchpasses = 1;
+
+	D_BuildPalette32 (d_blitbenchlut, host_basepal);
+	pixels = vid.width * vid.height;
+
+	d_blitbenchframe = malloc (pixels);
+	d_blitbenchbuffer = malloc (pixels * sizeof(unsigned) * BLIT_BENCHFRAMES);
+	if (!d_blitbenchframe || !d_blitbenchbuffer)
+		Sys_Error ("D_BlitBench_f: out of memory");
+	for (i=0 ; i<vid.height ; i++)
+		memcpy (d_blitbenchframe + i*vid.width, vid.buffer + i*vid.rowbytes,
+				vid.width);
+
+// the first pass of each always writes the first output
+	differ = R_BenchModes (NULL, D_BlitBenchRun, (byte *)d_blitbenchbuffer,
+			pixels * sizeof(unsigned));
+
+	Con_Printf ("%ix%i, %i passes\n", vid.width, vid.height, d_blitbenchpasses);
+	Con_Printf ("scalar: %.3f ms, %.2f ns/pixel\n",
+			d_blitbenchtime[0] * 1000, d_blitbenchtime[0] * 1e9 / pixels);
+#if idSSE2
+	Con_Printf ("stream: %.3f ms, %.2f ns/pixel, %s\n",
+			d_blitbenchtime[1] * 1000, d_blitbenchtime[1] * 1e9 / pixels,
+			R_BenchVerdict (differ));
+#endif
+
+	free (d_blitbenchbuffer);
+	free (d_blitbenchframe);
+}
@@ -19,6 +19,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 */
 // d_edge.c
 
+#include <stdint.h>
+
 #include "quakedef.h"
 #include "d_local.h"
 
@@ -35,6 +37,46 @@ extern void			R_TransformFrustum (void);
 
 vec3_t		transformed_modelorg;
 
+// with d_threads set, D_DrawSurfaces does all the per-surface setup on the
+// main thread, saving what the span drawers need, has the workers build
+// the surface cache blocks it allocated, then every thread draws the spans
+// that fall in its own interleaved strips of scanlines.  Spans from one
+// flush never overlap, so the result matches a serial draw
+#define	D_STRIPSHIFT	2		// 4 scanlines per strip
+#define	D_STRIPSPANS	64		// spans copied out per drawer call
+
+typedef enum {ds_solid, ds_sky, ds_turb, ds_turbtile, ds_spans} drawkind_t;
+
+typedef struct
+{
+	surf_t		*surf;
+	drawkind_t	kind;
+	int			color;
+	float		zistepu, zistepv, ziorigin;
+	float		sdivzstepu, tdivzstepu, sdivzstepv, tdivzstepv;
+	float		sdivzorigin, tdivzorigin;
+	fixed16_t	sadjust, tadjust, bbextents, bbextentt;
+	pixel_t		*cacheblock;
+	int			cachewidth;
+} drawsurf_rec_t;
+
+static qboolean			d_recording;
+static drawsurf_rec_t	*d_records;
+static int				d_numrecords, d_maxrecords;
+
+// d_spanbench keeps the textured spans of one frame to replay
+typedef struct
+{
+	drawsurf_rec_t	rec;
+	int				firstspan, numspans;
+} capsurf_t;
+
+static qboolean			d_spancapture;
+static capsurf_t		*d_capsurfs;
+static int				d_numcapsurfs, d_maxcapsurfs;
+static espan_t			*d_capspans;
+static int				d_numcapspans, d_maxcapspans;
+
 /*
 ==============
 D_DrawPoly
@@ -74,20 +116,19 @@ int D_MipLevelForScale (float scale)
 
 /*
 ==============
-D_DrawSolidSurface
+D_DrawSolidSpans
 ==============
 */
 
 // FIXME: clean this up
 
-void D_DrawSolidSurface (surf_t *surf, int color)
+static void D_DrawSolidSpans (espan_t *span, int color)
 {
-	espan_t	*span;
 	byte	*pdest;
 	int		u, u2, pix;
 	
 	pix = (color<<24) | (color<<16) | (color<<8) | color;
-	for (span=surf->spans ; span ; span=span->pnext)
+	for ( ; span ; span=span->pnext)
 	{
 		pdest = (byte *)d_viewbuffer + screenwidth*span->v;
 		u = span->u;
@@ -115,6 +156,17 @@ void D_DrawSolidSurface (surf_t *surf, int color)
 }
 
 
+/*
+==============
+D_DrawSolidSurface
+==============
+*/
+void D_DrawSolidSurface (surf_t *surf, int color)
+{
+	D_DrawSolidSpans (surf->spans, color);
+}
+
+
 /*
 ==============
 D_CalcGradients
@@ -168,10 +220,208 @@ void D_CalcGradients (msurface_t *pface)
 
 /*
 ==============
-D_DrawSurfaces
+D_DrawSpanList
+
+Draws spans with the gradients and cache already set up
 ==============
 */
-void D_DrawSurfaces (void)
+static void D_DrawSpanList (espan_t *pspan, drawkind_t kind, int color)
+{
+	switch (kind)
+	{
+	case ds_solid:
+		D_DrawSolidSpans (pspan, color);
+		break;
+	case ds_sky:
+		D_DrawSkyScans8 (pspan);
+		break;
+	case ds_turb:
+		Turbulent8 (pspan);
+		break;
+	case ds_turbtile:
+		TurbulentTile8 (pspan);
+		break;
+	case ds_spans:
+		(*d_drawspans) (pspan);
+		break;
+	}
+
+	D_DrawZSpans (pspan);
+}
+
+
+/*
+==============
+D_SaveDrawState
+==============
+*/
+static void D_SaveDrawState (drawsurf_rec_t *rec)
+{
+	rec->zistepu = d_zistepu;
+	rec->zistepv = d_zistepv;
+	rec->ziorigin = d_ziorigin;
+	rec->sdivzstepu = d_sdivzstepu;
+	rec->tdivzstepu = d_tdivzstepu;
+	rec->sdivzstepv = d_sdivzstepv;
+	rec->tdivzstepv = d_tdivzstepv;
+	rec->sdivzorigin = d_sdivzorigin;
+	rec->tdivzorigin = d_tdivzorigin;
+	rec->sadjust = sadjust;
+	rec->tadjust = tadjust;
+	rec->bbextents = bbextents;
+	rec->bbextentt = bbextentt;
+	rec->cacheblock = cacheblock;
+	rec->cachewidth = cachewidth;
+}
+
+
+/*
+==============
+D_LoadDrawState
+==============
+*/
+static void D_LoadDrawState (drawsurf_rec_t *rec)
+{
+	d_zistepu = rec->zistepu;
+	d_zistepv = rec->zistepv;
+	d_ziorigin = rec->ziorigin;
+	d_sdivzstepu = rec->sdivzstepu;
+	d_tdivzstepu = rec->tdivzstepu;
+	d_sdivzstepv = rec->sdivzstepv;
+	d_tdivzstepv = rec->tdivzstepv;
+	d_sdivzorigin = rec->sdivzorigin;
+	d_tdivzorigin = rec->tdivzorigin;
+	sadjust = rec->sadjust;
+	tadjust = rec->tadjust;
+	bbextents = rec->bbextents;
+	bbextentt = rec->bbextentt;
+	cacheblock = rec->cacheblock;
+	cachewidth = rec->cachewidth;
+}
+
+
+/*
+==============
+D_CaptureSurface
+==============
+*/
+static void D_CaptureSurface (surf_t *s)
+{
+	capsurf_t	*cap;
+	espan_t		*span;
+
+	if (d_numcapsurfs == d_maxcapsurfs)
+	{
+		d_maxcapsurfs = d_maxcapsurfs*2 + 256;
+		d_capsurfs = realloc (d_capsurfs, d_maxcapsurfs * sizeof(*d_capsurfs));
+		if (!d_capsurfs)
+			Sys_Error ("D_CaptureSurface: out of memory");
+	}
+
+	cap = &d_capsurfs[d_numcapsurfs++];
+	D_SaveDrawState (&cap->rec);
+	cap->firstspan = d_numcapspans;
+
+	for (span=s->spans ; span ; span=span->pnext)
+	{
+		if (d_numcapspans == d_maxcapspans)
+		{
+			d_maxcapspans = d_maxcapspans*2 + 4096;
+			d_capspans = realloc (d_capspans, d_maxcapspans * sizeof(*d_capspans));
+			if (!d_capspans)
+				Sys_Error ("D_CaptureSurface: out of memory");
+		}
+		d_capspans[d_numcapspans++] = *span;
+	}
+
+	cap->numspans = d_numcapspans - cap->firstspan;
+}
+
+
+/*
+==============
+D_EmitSurface
+
+Draws the surface now, or saves its drawing state for D_DrawSurfaceStrips
+==============
+*/
+static void D_EmitSurface (surf_t *s, drawkind_t kind, int color)
+{
+	drawsurf_rec_t	*rec;
+
+	if (d_spancapture && kind == ds_spans)
+		D_CaptureSurface (s);
+
+	if (!d_recording)
+	{
+		D_DrawSpanList (s->spans, kind, color);
+		return;
+	}
+
+	rec = &d_records[d_numrecords++];
+	rec->surf = s;
+	rec->kind = kind;
+	rec->color = color;
+	D_SaveDrawState (rec);
+}
+
+
+/*
+==============
+D_DrawSurfaceStrips
+
+Worker for D_RunThreads: draws the recorded surfaces' spans on the
+scanline strips that belong to this thread
+==============
+*/
+static void D_DrawSurfaceStrips (int thread, int numthreads)
+{
+	drawsurf_rec_t	*rec;
+	espan_t			*span;
+	espan_t			strip[D_STRIPSPANS];
+	int				i, j, count;
+
+	for (i=0, rec=d_records ; i<d_numrecords ; i++, rec++)
+	{
+		D_LoadDrawState (rec);
+
+		count = 0;
+		for (span=rec->surf->spans ; span ; span=span->pnext)
+		{
+			if ((span->v >> D_STRIPSHIFT) % numthreads != thread)
+				continue;
+
+			strip[count++] = *span;
+			if (count == D_STRIPSPANS)
+			{
+				for (j=0 ; j<count-1 ; j++)
+					strip[j].pnext = &strip[j+1];
+				strip[count-1].pnext = NULL;
+				D_DrawSpanList (strip, rec->kind, rec->color);
+				count = 0;
+			}
+		}
+
+		if (count)
+		{
+			for (j=0 ; j<count-1 ; j++)
+				strip[j].pnext = &strip[j+1];
+			strip[count-1].pnext = NULL;
+			D_DrawSpanList (strip, rec->kind, rec->color);
+		}
+	}
+}
+
+
+/*
+==============
+D_SetupSurfaces
+
+Does the per-surface setup in the original serial order, handing each
+surface to D_EmitSurface
+==============
+*/
+static void D_SetupSurfaces (void)
 {
 	surf_t			*s;
 	msurface_t		*pface;
@@ -195,8 +445,7 @@ void D_DrawSurfaces (void)
 			d_zistepv = s->d_zistepv;
 			d_ziorigin = s->d_ziorigin;
 
-			D_DrawSolidSurface (s, (int)s->data & 0xFF);
-			D_DrawZSpans (s->spans);
+			D_EmitSurface (s, ds_solid, (int)(intptr_t)s->data & 0xFF);
 		}
 	}
 	else
@@ -219,8 +468,7 @@ void D_DrawSurfaces (void)
 					R_MakeSky ();
 				}
 
-				D_DrawSkyScans8 (s->spans);
-				D_DrawZSpans (s->spans);
+				D_EmitSurface (s, ds_sky, 0);
 			}
 			else if (s->flags & SURF_DRAWBACKGROUND)
 			{
@@ -230,17 +478,30 @@ void D_DrawSurfaces (void)
 				d_zistepv = 0;
 				d_ziorigin = -0.9;
 
-				D_DrawSolidSurface (s, (int)r_clearcolor.value & 0xFF);
-				D_DrawZSpans (s->spans);
+				D_EmitSurface (s, ds_solid, (int)r_clearcolor.value & 0xFF);
 			}
 			else if (s->flags & SURF_DRAWTURB)
 			{
+				drawkind_t	kind;
+
 				pface = s->data;
 				miplevel = 0;
-				cacheblock = (pixel_t *)
-						((byte *)pface->texinfo->texture +
-						pface->texinfo->texture->offsets[0]);
-				cachewidth = 64;
+				kind = ds_turb;
+				cacheblock = NULL;
+				if (d_turbcache.value)
+					cacheblock = (pixel_t *)D_TurbulentTile (pface->texinfo->texture);
+				if (cacheblock)
+				{
+					kind = ds_turbtile;
+					cachewidth = CYCLE;
+				}
+				else
+				{
+					cacheblock = (pixel_t *)
+							((byte *)pface->texinfo->texture +
+							pface->texinfo->texture->offsets[0]);
+					cachewidth = 64;
+				}
 
 				if (s->insubmodel)
 				{
@@ -257,8 +518,7 @@ void D_DrawSurfaces (void)
 				}
 
 				D_CalcGradients (pface);
-				Turbulent8 (s->spans);
-				D_DrawZSpans (s->spans);
+				D_EmitSurface (s, kind, 0);
 
 				if (s->insubmodel)
 				{
@@ -304,9 +564,7 @@ void D_DrawSurfaces (void)
 
 				D_CalcGradients (pface);
 
-				(*d_drawspans) (s->spans);
-
-				D_DrawZSpans (s->spans);
+				D_EmitSurface (s, ds_spans, 0);
 
 				if (s->insubmodel)
 				{
@@ -329,3 +587,201 @@ void D_DrawSurfaces (void)
 	}
 }
 
+
+/*
+==============
+D_DrawSurfaces
+==============
+*/
+void D_DrawSurfaces (void)
+{
+	int		count, polycount;
+	double	prof_start;
+
+	d_drawflush++;
+	prof_start = Prof_Begin ();
+
+	if (D_NumThreads () == 1)
+	{
+		d_recording = false;
+		D_SetupSurfaces ();
+		Prof_End (PROF_SPANDRAW, prof_start);
+		return;
+	}
+
+	count = surface_p - surfaces;
+	if (count > d_maxrecords)
+	{
+		free (d_records);
+		d_maxrecords = count + 256;
+		d_records = malloc (d_maxrecords * sizeof(*d_records));
+		if (!d_records)
+			Sys_Error ("D_DrawSurfaces: couldn't allocate %i records",
+					d_maxrecords);
+	}
+
+	polycount = r_drawnpolycount;
+	d_cacheconflict = false;
+	d_numrecords = 0;
+	d_recording = true;
+	D_BeginSurfaceBuilds ();
+	D_SetupSurfaces ();
+	d_recording = false;
+
+	if (d_cacheconflict)
+	{
+	// the surface cache reused a block that an earlier surface in this
+	// flush still points at, so draw the flush again in order
+		D_CancelSurfaceBuilds ();
+		r_drawnpolycount = polycount;
+		d_drawflush++;
+		D_SetupSurfaces ();
+		Prof_End (PROF_SPANDRAW, prof_start);
+		return;
+	}
+
+	D_EndSurfaceBuilds ();
+	D_RunThreads (D_DrawSurfaceStrips);
+	Prof_End (PROF_SPANDRAW, prof_start);
+}
+
+
+/*
+==============
+D_TimeSpans
+
+Replays the captured spans through one drawer into buffer, returning the
+fastest of the passes
+==============
+*/
+static double D_TimeSpans (void (*drawspans) (espan_t *pspan), byte *buffer,
+	int size, int passes)
+{
+	capsurf_t	*cap;
+	double		start, time, best;
+	int			i, pass;
+
+	memset (buffer, 0, size);
+	d_viewbuffer = buffer;
+
+	best = 1e9;
+	for (pass=0 ; pass<passes ; pass++)
+	{
+		start = Sys_FloatTime ();
+		for (i=0, cap=d_capsurfs ; i<d_numcapsurfs ; i++, cap++)
+		{
+			D_LoadDrawState (&cap->rec);
+			drawspans (&d_capspans[cap->firstspan]);
+		}
+		time = Sys_FloatTime () - start;
+		if (time < best)
+			best = time;
+	}
+	return best;
+}
+
+
+static byte		*d_spanbenchbuffer;
+static int		d_spanbenchsize, d_spanbenchpasses;
+static double	d_spanbenchtime[2];
+
+/*
+==============
+D_SpanBenchRun
+==============
+*/
+static void D_SpanBenchRun (int mode)
+{
+	void	(*drawspans) (espan_t *pspan);
+
+	drawspans = D_DrawSpans8;
+#if idSIMD
+	if (mode)
+		drawspans = D_DrawSpans8SIMD;
+#endif
+	d_spanbenchtime[mode] = D_TimeSpans (drawspans, d_spanbenchbuffer,
+			d_spanbenchsize, d_spanbenchpasses);
+}
+
+
+/*
+==============
+D_SpanBench_f
+
+Captures the textured spans of one frame from the current view, then times
+the span drawers over them, best of the given number of passes, and checks
+that they write the same pixels
+==============
+*/
+void D_SpanBench_f (void)
+{
+	capsurf_t	*cap;
+	pixel_t		*savedbuffer;
+	int			i, j, passes, pixels, maxv, differ;
+
+	if (!cl.worldmodel)
+	{
+		Con_Printf ("d_spanbench: no map loaded\n");
+		return;
+	}
+
+	passes = 100;
+	if (Cmd_Argc () > 1)
+		passes = Q_atoi (Cmd_Argv (1));
+	if (passes < 1)
+		passes = 1;
+
+	d_numcapsurfs = 0;
+	d_numcapspans = 0;
+	d_spancapture = true;
+
+	VID_LockBuffer ();
+	R_RenderView ();
+	VID_UnlockBuffer ();
+
+	d_spancapture = false;
+
+	if (!d_numcapspans)
+	{
+		Con_Printf ("d_spanbench: no textured spans in view\n");
+		return;
+	}
+
+// chain each surface's spans and find the extent of the buffer they touch
+	pixels = 0;
+	maxv = 0;
+	for (i=0, cap=d_capsurfs ; i<d_numcapsurfs ; i++, cap++)
+	{
+		for (j=cap->firstspan ; j<cap->firstspan+cap->numspans ; j++)
+		{
+			d_capspans[j].pnext = &d_capspans[j+1];
+			pixels += d_capspans[j].count;
+			if (d_capspans[j].v > maxv)
+				maxv = d_capspans[j].v;
+		}
+		d_capspans[j-1].pnext = NULL;
+	}
+
+	d_spanbenchsize = screenwidth * (maxv + 1);
+	d_spanbenchpasses = passes;
+	savedbuffer = d_viewbuffer;
+
+	d_spanbenchbuffer = malloc (d_spanbenchsize);
+	if (!d_spanbenchbuffer)
+		Sys_Error ("D_SpanBench_f: out of memory");
+	differ = R_BenchModes (NULL, D_SpanBenchRun, d_spanbenchbuffer,
+			d_spanbenchsize);
+
+	Con_Printf ("%i surfaces, %i spans, %i pixels, %i passes\n",
+			d_numcapsurfs, d_numcapspans, pixels, passes);
+	Con_Printf ("scalar: %.3f ms, %.2f ns/pixel\n",
+			d_spanbenchtime[0] * 1000, d_spanbenchtime[0] * 1e9 / pixels);
+#if idSIMD
+	Con_Printf ("simd:   %.3f ms, %.2f ns/pixel, %s\n",
+			d_spanbenchtime[1] * 1000, d_spanbenchtime[1] * 1e9 / pixels,
+			R_BenchVerdict (differ));
+#endif
+
+	free (d_spanbenchbuffer);
+	d_viewbuffer = savedbuffer;
+}
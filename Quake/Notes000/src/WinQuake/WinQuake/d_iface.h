@@ -35,19 +35,23 @@ typedef enum {
 	pt_static, pt_grav, pt_slowgrav, pt_fire, pt_explode, pt_explode2, pt_blob, pt_blob2
 } ptype_t;
 
-// !!! if this is changed, it must be changed in d_ifacea.h too !!!
-typedef struct particle_s
+#define	NUM_PARTICLETYPES	(pt_blob2+1)
+
+#define	PARTICLEBLOCK	64		// particles per block, a multiple of 4
+
+// live particles are kept in blocks of a single type, a field at a time
+typedef struct particleblock_s
 {
 // driver-usable fields
-	vec3_t		org;
-	float		color;
+	int			count;
+	float		org[3][PARTICLEBLOCK];
+	float		color[PARTICLEBLOCK];
 // drivers never touch the following fields
-	struct particle_s	*next;
-	vec3_t		vel;
-	float		ramp;
-	float		die;
-	ptype_t		type;
-} particle_t;
+	struct particleblock_s	*next;
+	float		vel[3][PARTICLEBLOCK];
+	float		ramp[PARTICLEBLOCK];
+	float		die[PARTICLEBLOCK];
+} particleblock_t;
 
 #define PARTICLE_Z_CLIP	8.0
 
@@ -107,6 +111,9 @@ typedef struct
 } zpointdesc_t;
 
 extern cvar_t	r_drawflat;
+extern cvar_t	r_occlusion;
+extern int		r_occluded;			// models thrown out by D_Occluded this frame
+extern cvar_t	d_simd;
 extern int		d_spanpixcount;
 extern int		r_framecount;		// sequence # of current frame since Quake
 									//  started
@@ -148,7 +155,7 @@ void D_DisableBackBufferAccess (void);
 void D_EndDirectRect (int x, int y, int width, int height);
 void D_PolysetDraw (void);
 void D_PolysetDrawFinalVerts (finalvert_t *fv, int numverts);
-void D_DrawParticle (particle_t *pparticle);
+void D_DrawParticles (particleblock_t *pblock);
 void D_DrawPoly (void);
 void D_DrawSprite (void);
 void D_DrawSurfaces (void);
@@ -162,6 +169,24 @@ void D_StartParticles (void);
 void D_TurnZOn (void);
 void D_WarpScreen (void);
 
+// hierarchical z buffer built from the world's z, for throwing out models
+// that are completely behind it; izi is in z buffer units
+void D_BeginOcclusion (void);
+qboolean D_Occluded (int x0, int y0, int x1, int y1, int izi);
+
+// rasterizer worker threads; func is called once on every thread, with the
+// caller as thread 0, and D_RunThreads returns when all calls have finished
+void D_InitThreads (void);
+void D_SetupThreads (void);
+int D_NumThreads (void);
+void D_RunThreads (void (*func) (int thread, int numthreads));
+
+// 32 bit display output; the renderer still draws indices, and the driver
+// expands the finished frame through a table built from the palette
+void D_BuildPalette32 (unsigned *lut, byte *palette);
+void D_Blit32 (unsigned *pdest, int destpitch, byte *psrc, int srcrowbytes,
+	int width, int height, unsigned *lut);
+
 void D_FillRect (vrect_t *vrect, int color);
 void D_DrawRect (void);
 void D_UpdateRects (vrect_t *prect);
@@ -199,9 +224,10 @@ typedef struct
 	int			surfmip;	// mipmapped ratio of surface texels / world pixels
 	int			surfwidth;	// in mipmapped texels
 	int			surfheight;	// in mipmapped texels
+	qboolean	cachelight;	// may use and update surf->staticlight
 } drawsurf_t;
 
-extern drawsurf_t	r_drawsurf;
+extern THREADLOCAL drawsurf_t	r_drawsurf;
 
 void R_DrawSurface (void);
 void R_GenTile (msurface_t *psurf, void *pdest);
@@ -222,7 +248,7 @@ void R_GenTile (msurface_t *psurf, void *pdest);
 extern float	skyspeed, skyspeed2;
 extern float	skytime;
 
-extern int		c_surf;
+extern int		c_surf, c_surftexels;
 extern vrect_t	scr_vrect;
 
 extern byte		*r_warpbuffer;
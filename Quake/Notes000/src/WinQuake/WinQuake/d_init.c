@@ -27,6 +27,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 cvar_t	d_subdiv16 = {"d_subdiv16", "1"};
 cvar_t	d_mipcap = {"d_mipcap", "0"};
 cvar_t	d_mipscale = {"d_mipscale", "1"};
+cvar_t	d_simd = {"d_simd", "1"};	// vector span and surface drawers, where compiled in
 
 surfcache_t		*d_initial_rover;
 qboolean		d_roverwrapped;
@@ -53,6 +54,15 @@ void D_Init (void)
 	Cvar_RegisterVariable (&d_subdiv16);
 	Cvar_RegisterVariable (&d_mipcap);
 	Cvar_RegisterVariable (&d_mipscale);
+	Cvar_RegisterVariable (&d_simd);
+	Cvar_RegisterVariable (&d_surfcachemax);
+	Cvar_RegisterVariable (&d_turbcache);
+
+	Cmd_AddCommand ("d_spanbench", D_SpanBench_f);
+	Cmd_AddCommand ("d_blitbench", D_BlitBench_f);
+	Cmd_AddCommand ("scstats", D_SCStats_f);
+
+	D_InitThreads ();
 
 	r_drawpolys = false;
 	r_worldpolysbacktofront = false;
@@ -133,6 +143,8 @@ void D_SetupFrame (void)
 	else
 		screenwidth = vid.rowbytes;
 
+	D_SCNewFrame ();
+
 	d_roverwrapped = false;
 	d_initial_rover = sc_rover;
 
@@ -150,11 +162,18 @@ void D_SetupFrame (void)
 					d_drawspans = D_DrawSpans16;
 				else
 					d_drawspans = D_DrawSpans8;
+#elif idSIMD
+				if (d_simd.value)
+					d_drawspans = D_DrawSpans8SIMD;
+				else
+					d_drawspans = D_DrawSpans8;
 #else
 				d_drawspans = D_DrawSpans8;
 #endif
 
 	d_aflatcolor = 0;
+
+	D_SetupThreads ();
 }
 
 
@@ -45,6 +45,8 @@ typedef struct surfcache_s
 	unsigned			height;		// DEBUG only needed for debug
 	float				mipscale;
 	struct texture_s	*texture;	// checked for animating textures
+	int					usedflush;	// d_drawflush when last handed out
+	int					usedframe;	// d_scframe when last drawn
 	byte				data[4];	// width*height elements
 } surfcache_t;
 
@@ -55,6 +57,8 @@ typedef struct sspan_s
 } sspan_t;
 
 extern cvar_t	d_subdiv16;
+extern cvar_t	d_turbcache;
+extern cvar_t	d_surfcachemax;
 
 extern float	scale_for_mip;
 
@@ -62,26 +66,56 @@ extern qboolean		d_roverwrapped;
 extern surfcache_t	*sc_rover;
 extern surfcache_t	*d_initial_rover;
 
-extern float	d_sdivzstepu, d_tdivzstepu, d_zistepu;
-extern float	d_sdivzstepv, d_tdivzstepv, d_zistepv;
-extern float	d_sdivzorigin, d_tdivzorigin, d_ziorigin;
+#define	MAX_DTHREADS	16		// d_threads limit, including the main thread
 
-fixed16_t	sadjust, tadjust;
-fixed16_t	bbextents, bbextentt;
+extern int			d_drawflush;		// counts D_DrawSurfaces calls
+extern qboolean		d_cacheconflict;	// a block handed out this flush was
+										//  reused before it was drawn
+
+extern THREADLOCAL float	d_sdivzstepu, d_tdivzstepu, d_zistepu;
+extern THREADLOCAL float	d_sdivzstepv, d_tdivzstepv, d_zistepv;
+extern THREADLOCAL float	d_sdivzorigin, d_tdivzorigin, d_ziorigin;
+
+extern THREADLOCAL fixed16_t	sadjust, tadjust;
+extern THREADLOCAL fixed16_t	bbextents, bbextentt;
 
 
 void D_DrawSpans8 (espan_t *pspans);
 void D_DrawSpans16 (espan_t *pspans);
+#if idSIMD
+void D_DrawSpans8SIMD (espan_t *pspans);
+#endif
 void D_DrawZSpans (espan_t *pspans);
 void Turbulent8 (espan_t *pspan);
+void TurbulentTile8 (espan_t *pspan);
+byte *D_TurbulentTile (texture_t *texture);
+void D_FlushTurbulentTiles (void);
 void D_SpriteDrawSpans (sspan_t *pspan);
 
 void D_DrawSkyScans8 (espan_t *pspan);
 void D_DrawSkyScans16 (espan_t *pspan);
 
+void D_SpanBench_f (void);
+void D_BlitBench_f (void);
+
+extern qboolean	d_polysetcapture;
+
+void D_PolysetBeginCapture (void);
+void D_PolysetBench (int passes);
+
+void D_PolysetSizeSpans (void);
+void D_SpriteSizeSpans (void);
+void D_WarpSizeBuffers (void);
+void D_OcclusionSizeBuffers (void);
+
 void R_ShowSubDiv (void);
 void (*prealspandrawer)(void);
 surfcache_t	*D_CacheSurface (msurface_t *surface, int miplevel);
+void D_SCNewFrame (void);
+void D_SCStats_f (void);
+void D_BeginSurfaceBuilds (void);
+void D_EndSurfaceBuilds (void);
+void D_CancelSurfaceBuilds (void);
 
 extern int D_MipLevelForScale (float scale);
 
@@ -94,7 +128,7 @@ extern short *d_pzbuffer;
 extern unsigned int d_zrowbytes, d_zwidth;
 
 extern int	*d_pscantable;
-extern int	d_scantable[MAXHEIGHT];
+extern int	*d_scantable;
 
 extern int	d_vrectx, d_vrecty, d_vrectright_particle, d_vrectbottom_particle;
 
@@ -102,7 +136,7 @@ extern int	d_y_aspect_shift, d_pix_min, d_pix_max, d_pix_shift;
 
 extern pixel_t	*d_viewbuffer;
 
-extern short	*zspantable[MAXHEIGHT];
+extern short	**zspantable;
 
 extern int		d_minmip;
 extern float	d_scalemip[3];
@@ -26,8 +26,9 @@ int	d_vrectx, d_vrecty, d_vrectright_particle, d_vrectbottom_particle;
 
 int	d_y_aspect_shift, d_pix_min, d_pix_max, d_pix_shift;
 
-int		d_scantable[MAXHEIGHT];
-short	*zspantable[MAXHEIGHT]; 
+int		*d_scantable;		// [vid.height]
+short	**zspantable;
+int		d_scanheight;
 
 /*
 ================
@@ -92,6 +93,20 @@ void D_ViewChanged (void)
 	d_vrectbottom_particle =
 			r_refdef.vrectbottom - (d_pix_max << d_y_aspect_shift);
 
+	if (d_scanheight != vid.height)
+	{
+		d_scantable = R_ModeAlloc (d_scantable, vid.height * sizeof(int),
+				"d_scantable");
+		zspantable = R_ModeAlloc (zspantable, vid.height * sizeof(short *),
+				"zspantable");
+		d_scanheight = vid.height;
+	}
+
+	D_PolysetSizeSpans ();
+	D_SpriteSizeSpans ();
+	D_WarpSizeBuffers ();
+	D_OcclusionSizeBuffers ();
+
 	{
 		int		i;
 
@@ -0,0 +1,300 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// d_occlude.c: hierarchical z buffer for rejecting hidden models
+
+#include "quakedef.h"
+#include "d_local.h"
+
+// once the world has been drawn, the z buffer is reduced to the farthest
+// (smallest) 1/z of every 8x8 pixel tile, and those tiles again to the
+// farthest of every 8x8 tile block.  A model whose nearest 1/z is still
+// farther than everything under its screen bounds can't pass a single z
+// compare, so it is thrown out before any of its vertices are touched
+#define OCC_TILESHIFT	3
+#define OCC_TILESIZE	(1 << OCC_TILESHIFT)
+#define OCC_BLOCKSHIFT	3		// in tiles
+
+static short	*d_occtiles, *d_occblocks;
+static int		d_occtilesize, d_occblocksize;
+static int		d_occtilewidth, d_occtileheight;
+static int		d_occblockwidth, d_occblockheight;
+static qboolean	d_occvalid;
+
+
+/*
+=============
+D_OcclusionSizeBuffers
+=============
+*/
+void D_OcclusionSizeBuffers (void)
+{
+	int		tiles, blocks;
+
+	tiles = ((vid.width + OCC_TILESIZE - 1) >> OCC_TILESHIFT) *
+			((vid.height + OCC_TILESIZE - 1) >> OCC_TILESHIFT);
+	if (tiles != d_occtilesize)
+	{
+		d_occtiles = R_ModeAlloc (d_occtiles, tiles * sizeof(short),
+				"occlusion tiles");
+		d_occtilesize = tiles;
+	}
+
+	blocks = ((vid.width + (OCC_TILESIZE << OCC_BLOCKSHIFT) - 1) >>
+			(OCC_TILESHIFT + OCC_BLOCKSHIFT)) *
+			((vid.height + (OCC_TILESIZE << OCC_BLOCKSHIFT) - 1) >>
+			(OCC_TILESHIFT + OCC_BLOCKSHIFT));
+	if (blocks != d_occblocksize)
+	{
+		d_occblocks = R_ModeAlloc (d_occblocks, blocks * sizeof(short),
+				"occlusion blocks");
+		d_occblocksize = blocks;
+	}
+
+	d_occvalid = false;
+}
+
+
+/*
+=============
+D_BeginOcclusion
+
+The z buffer is about to change, so the tiles are rebuilt on the next test
+=============
+*/
+void D_BeginOcclusion (void)
+{
+	d_occvalid = false;
+}
+
+
+/*
+=============
+D_TileMin
+
+Farthest z of a tile that is a full OCC_TILESIZE pixels wide
+=============
+*/
+static int D_TileMin (short *pz, int rows)
+{
+#if idSIMD
+	if (d_simd.value)
+	{
+#if idNEON
+		int16x8_t	vmin;
+
+		vmin = vld1q_s16 (pz);
+		for (pz += d_zwidth, rows-- ; rows ; rows--, pz += d_zwidth)
+			vmin = vminq_s16 (vmin, vld1q_s16 (pz));
+
+		return vminvq_s16 (vmin);
+#else
+		__m128i		vmin;
+
+		vmin = _mm_loadu_si128 ((__m128i *)pz);
+		for (pz += d_zwidth, rows-- ; rows ; rows--, pz += d_zwidth)
+			vmin = _mm_min_epi16 (vmin, _mm_loadu_si128 ((__m128i *)pz));
+
+		vmin = _mm_min_epi16 (vmin, _mm_srli_si128 (vmin, 8));
+		vmin = _mm_min_epi16 (vmin, _mm_srli_si128 (vmin, 4));
+		vmin = _mm_min_epi16 (vmin, _mm_srli_si128 (vmin, 2));
+
+		return (short)_mm_cvtsi128_si32 (vmin);
+#endif
+	}
+#endif
+
+	{
+		int		x, zmin;
+
+		zmin = 0x7fff;
+		for ( ; rows ; rows--, pz += d_zwidth)
+		{
+			for (x=0 ; x<OCC_TILESIZE ; x++)
+			{
+				if (pz[x] < zmin)
+					zmin = pz[x];
+			}
+		}
+
+		return zmin;
+	}
+}
+
+
+/*
+=============
+D_BuildOcclusion
+=============
+*/
+static void D_BuildOcclusion (void)
+{
+	int		tx, ty, bx, by, x, y, rows, cols, zmin, z;
+	short	*pz, *ptile;
+
+	d_occtilewidth = (r_refdef.vrect.width + OCC_TILESIZE - 1) >>
+			OCC_TILESHIFT;
+	d_occtileheight = (r_refdef.vrect.height + OCC_TILESIZE - 1) >>
+			OCC_TILESHIFT;
+	d_occblockwidth = (d_occtilewidth + (1 << OCC_BLOCKSHIFT) - 1) >>
+			OCC_BLOCKSHIFT;
+	d_occblockheight = (d_occtileheight + (1 << OCC_BLOCKSHIFT) - 1) >>
+			OCC_BLOCKSHIFT;
+
+	ptile = d_occtiles;
+
+	for (ty=0 ; ty<d_occtileheight ; ty++)
+	{
+		y = ty << OCC_TILESHIFT;
+		rows = r_refdef.vrect.height - y;
+		if (rows > OCC_TILESIZE)
+			rows = OCC_TILESIZE;
+		pz = zspantable[r_refdef.vrect.y + y] + r_refdef.vrect.x;
+
+		for (tx=0 ; tx<d_occtilewidth ; tx++, pz += OCC_TILESIZE)
+		{
+			cols = r_refdef.vrect.width - (tx << OCC_TILESHIFT);
+			if (cols >= OCC_TILESIZE)
+			{
+				*ptile++ = D_TileMin (pz, rows);
+				continue;
+			}
+
+		// partial tile on the right side of the view
+			zmin = 0x7fff;
+			for (y=0 ; y<rows ; y++)
+			{
+				for (x=0 ; x<cols ; x++)
+				{
+					if (pz[y*d_zwidth + x] < zmin)
+						zmin = pz[y*d_zwidth + x];
+				}
+			}
+			*ptile++ = zmin;
+		}
+	}
+
+	for (by=0 ; by<d_occblockheight ; by++)
+	{
+		for (bx=0 ; bx<d_occblockwidth ; bx++)
+		{
+			zmin = 0x7fff;
+
+			for (ty = by << OCC_BLOCKSHIFT ;
+				 ty < ((by + 1) << OCC_BLOCKSHIFT) && ty < d_occtileheight ;
+				 ty++)
+			{
+				ptile = d_occtiles + ty*d_occtilewidth;
+
+				for (tx = bx << OCC_BLOCKSHIFT ;
+					 tx < ((bx + 1) << OCC_BLOCKSHIFT) && tx < d_occtilewidth ;
+					 tx++)
+				{
+					z = ptile[tx];
+					if (z < zmin)
+						zmin = z;
+				}
+			}
+
+			d_occblocks[by*d_occblockwidth + bx] = zmin;
+		}
+	}
+
+	d_occvalid = true;
+}
+
+
+/*
+=============
+D_Occluded
+
+True if every z buffer value in the inclusive screen rectangle is nearer
+than izi, so nothing drawn there with a 1/z of at most izi can show
+=============
+*/
+qboolean D_Occluded (int x0, int y0, int x1, int y1, int izi)
+{
+	int		tx0, ty0, tx1, ty1, bx0, by0, bx1, by1, bx, by, tx, ty;
+	int		btx0, bty0, btx1, bty1;
+	short	*ptile;
+
+	if (izi >= 0x7fff)
+		return false;
+
+	if (x0 < r_refdef.vrect.x)
+		x0 = r_refdef.vrect.x;
+	if (y0 < r_refdef.vrect.y)
+		y0 = r_refdef.vrect.y;
+	if (x1 >= r_refdef.vrectright)
+		x1 = r_refdef.vrectright - 1;
+	if (y1 >= r_refdef.vrectbottom)
+		y1 = r_refdef.vrectbottom - 1;
+
+	if (x0 > x1 || y0 > y1)
+		return false;	// let the normal clipping deal with it
+
+	if (!d_occvalid)
+		D_BuildOcclusion ();
+
+	tx0 = (x0 - r_refdef.vrect.x) >> OCC_TILESHIFT;
+	tx1 = (x1 - r_refdef.vrect.x) >> OCC_TILESHIFT;
+	ty0 = (y0 - r_refdef.vrect.y) >> OCC_TILESHIFT;
+	ty1 = (y1 - r_refdef.vrect.y) >> OCC_TILESHIFT;
+
+	bx0 = tx0 >> OCC_BLOCKSHIFT;
+	bx1 = tx1 >> OCC_BLOCKSHIFT;
+	by0 = ty0 >> OCC_BLOCKSHIFT;
+	by1 = ty1 >> OCC_BLOCKSHIFT;
+
+	for (by=by0 ; by<=by1 ; by++)
+	{
+		for (bx=bx0 ; bx<=bx1 ; bx++)
+		{
+			if (d_occblocks[by*d_occblockwidth + bx] > izi)
+				continue;	// the whole block is in front
+
+		// look at the tiles of the block that the rectangle covers
+			btx0 = bx << OCC_BLOCKSHIFT;
+			if (btx0 < tx0)
+				btx0 = tx0;
+			btx1 = ((bx + 1) << OCC_BLOCKSHIFT) - 1;
+			if (btx1 > tx1)
+				btx1 = tx1;
+			bty0 = by << OCC_BLOCKSHIFT;
+			if (bty0 < ty0)
+				bty0 = ty0;
+			bty1 = ((by + 1) << OCC_BLOCKSHIFT) - 1;
+			if (bty1 > ty1)
+				bty1 = ty1;
+
+			for (ty=bty0 ; ty<=bty1 ; ty++)
+			{
+				ptile = d_occtiles + ty*d_occtilewidth;
+
+				for (tx=btx0 ; tx<=btx1 ; tx++)
+				{
+					if (ptile[tx] <= izi)
+						return false;
+				}
+			}
+		}
+	}
+
+	return true;
+}
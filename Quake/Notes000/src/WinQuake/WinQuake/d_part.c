@@ -45,36 +45,91 @@ void D_StartParticles (void)
 }
 
 
-#if	!id386
+#if idSIMD
 
 /*
 ==============
-D_DrawParticle
+D_SplatRowsSIMD
+
+Z tests and fills rows of a particle square eight pixels at a time, with
+the pixels past the right side of the square masked off.  The caller makes
+sure every eight pixel run stays inside the view
 ==============
 */
-void D_DrawParticle (particle_t *pparticle)
+static void D_SplatRowsSIMD (short *pz, byte *pdest, int izi, int pix,
+	int count, int color)
 {
-	vec3_t	local, transformed;
-	float	zi;
-	byte	*pdest;
-	short	*pz;
-	int		i, izi, pix, count, u, v;
+	int		x, left;
 
-// transform point
-	VectorSubtract (pparticle->org, r_origin, local);
+#if idNEON
+	static const short	lanes[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+	int16x8_t	vz, vizi, vlanes;
+	uint16x8_t	vmask;
+	uint8x8_t	vcolor;
 
-	transformed[0] = DotProduct(local, r_pright);
-	transformed[1] = DotProduct(local, r_pup);
-	transformed[2] = DotProduct(local, r_ppn);		
+	vizi = vdupq_n_s16 (izi);
+	vlanes = vld1q_s16 (lanes);
+	vcolor = vdup_n_u8 (color);
 
-	if (transformed[2] < PARTICLE_Z_CLIP)
-		return;
+	for ( ; count ; count--, pz += d_zwidth, pdest += screenwidth)
+	{
+		for (x=0 ; x<pix ; x+=8)
+		{
+			left = pix - x;
+			vz = vld1q_s16 (pz + x);
+			vmask = vandq_u16 (vcleq_s16 (vz, vizi),
+					vcltq_s16 (vlanes, vdupq_n_s16 (left)));
+			vst1q_s16 (pz + x, vbslq_s16 (vmask, vizi, vz));
+			vst1_u8 (pdest + x, vbsl_u8 (vmovn_u16 (vmask), vcolor,
+					vld1_u8 (pdest + x)));
+		}
+	}
+#else
+	__m128i		vz, vizi, vlanes, vmask, vcolor, vpix;
+
+	vizi = _mm_set1_epi16 ((short)izi);
+	vlanes = _mm_setr_epi16 (0, 1, 2, 3, 4, 5, 6, 7);
+	vcolor = _mm_set1_epi8 ((char)color);
+
+	for ( ; count ; count--, pz += d_zwidth, pdest += screenwidth)
+	{
+		for (x=0 ; x<pix ; x+=8)
+		{
+			left = pix - x;
+			vz = _mm_loadu_si128 ((__m128i *)(pz + x));
+			vmask = _mm_andnot_si128 (_mm_cmpgt_epi16 (vz, vizi),
+					_mm_cmpgt_epi16 (_mm_set1_epi16 ((short)left), vlanes));
+			_mm_storeu_si128 ((__m128i *)(pz + x), _mm_or_si128 (
+					_mm_and_si128 (vmask, vizi), _mm_andnot_si128 (vmask, vz)));
+
+			vmask = _mm_packs_epi16 (vmask, vmask);
+			vpix = _mm_loadl_epi64 ((__m128i *)(pdest + x));
+			_mm_storel_epi64 ((__m128i *)(pdest + x), _mm_or_si128 (
+					_mm_and_si128 (vmask, vcolor), _mm_andnot_si128 (vmask, vpix)));
+		}
+	}
+#endif
+}
+
+#endif	// idSIMD
+
+
+/*
+==============
+D_SplatParticle
+
+Draws a projected particle as a z tested square, sized by its distance
+==============
+*/
+static void D_SplatParticle (float px, float py, float zi, int color)
+{
+	byte	*pdest;
+	short	*pz;
+	int		i, izi, pix, count, u, v;
 
-// project the point
 // FIXME: preadjust xcenter and ycenter
-	zi = 1.0 / transformed[2];
-	u = (int)(xcenter + zi * transformed[0] + 0.5);
-	v = (int)(ycenter - zi * transformed[1] + 0.5);
+	u = (int)(xcenter + px + 0.5);
+	v = (int)(ycenter - py + 0.5);
 
 	if ((v > d_vrectbottom_particle) || 
 		(u > d_vrectright_particle) ||
@@ -88,13 +143,25 @@ void D_DrawParticle (particle_t *pparticle)
 	pdest = d_viewbuffer + d_scantable[v] + u;
 	izi = (int)(zi * 0x8000);
 
-	pix = izi >> d_pix_shift;
+// the shift goes negative on modes much wider than 2560
+	if (d_pix_shift >= 0)
+		pix = izi >> d_pix_shift;
+	else
+		pix = izi << -d_pix_shift;
 
 	if (pix < d_pix_min)
 		pix = d_pix_min;
 	else if (pix > d_pix_max)
 		pix = d_pix_max;
 
+#if idSIMD
+	if (d_simd.value && u + ((pix + 7) & ~7) <= r_refdef.vrectright)
+	{
+		D_SplatRowsSIMD (pz, pdest, izi, pix, pix << d_y_aspect_shift, color);
+		return;
+	}
+#endif
+
 	switch (pix)
 	{
 	case 1:
@@ -105,7 +172,7 @@ void D_DrawParticle (particle_t *pparticle)
 			if (pz[0] <= izi)
 			{
 				pz[0] = izi;
-				pdest[0] = pparticle->color;
+				pdest[0] = color;
 			}
 		}
 		break;
@@ -118,13 +185,13 @@ void D_DrawParticle (particle_t *pparticle)
 			if (pz[0] <= izi)
 			{
 				pz[0] = izi;
-				pdest[0] = pparticle->color;
+				pdest[0] = color;
 			}
 
 			if (pz[1] <= izi)
 			{
 				pz[1] = izi;
-				pdest[1] = pparticle->color;
+				pdest[1] = color;
 			}
 		}
 		break;
@@ -137,19 +204,19 @@ void D_DrawParticle (particle_t *pparticle)
 			if (pz[0] <= izi)
 			{
 				pz[0] = izi;
-				pdest[0] = pparticle->color;
+				pdest[0] = color;
 			}
 
 			if (pz[1] <= izi)
 			{
 				pz[1] = izi;
-				pdest[1] = pparticle->color;
+				pdest[1] = color;
 			}
 
 			if (pz[2] <= izi)
 			{
 				pz[2] = izi;
-				pdest[2] = pparticle->color;
+				pdest[2] = color;
 			}
 		}
 		break;
@@ -162,25 +229,25 @@ void D_DrawParticle (particle_t *pparticle)
 			if (pz[0] <= izi)
 			{
 				pz[0] = izi;
-				pdest[0] = pparticle->color;
+				pdest[0] = color;
 			}
 
 			if (pz[1] <= izi)
 			{
 				pz[1] = izi;
-				pdest[1] = pparticle->color;
+				pdest[1] = color;
 			}
 
 			if (pz[2] <= izi)
 			{
 				pz[2] = izi;
-				pdest[2] = pparticle->color;
+				pdest[2] = color;
 			}
 
 			if (pz[3] <= izi)
 			{
 				pz[3] = izi;
-				pdest[3] = pparticle->color;
+				pdest[3] = color;
 			}
 		}
 		break;
@@ -195,7 +262,7 @@ void D_DrawParticle (particle_t *pparticle)
 				if (pz[i] <= izi)
 				{
 					pz[i] = izi;
-					pdest[i] = pparticle->color;
+					pdest[i] = color;
 				}
 			}
 		}
@@ -203,5 +270,127 @@ void D_DrawParticle (particle_t *pparticle)
 	}
 }
 
-#endif	// !id386
 
+/*
+==============
+D_DrawParticles
+
+Transforms and projects a block of particles, four at a time under d_simd,
+then splats the ones in front of the near clip.  The vector projection does
+the scalar math in the same order, so the same pixels come out either way
+==============
+*/
+void D_DrawParticles (particleblock_t *pblock)
+{
+	float	depth[PARTICLEBLOCK], px[PARTICLEBLOCK], py[PARTICLEBLOCK];
+	float	zi[PARTICLEBLOCK];
+	vec3_t	local, transformed;
+	int		i, count;
+
+	count = pblock->count;
+
+#if idSIMD
+	if (d_simd.value)
+	{
+#if idNEON
+		float32x4_t	ox, oy, oz, lx, ly, lz, t0, t1, t2, vzi;
+		float32x4_t	rx0, rx1, rx2, ry0, ry1, ry2, rz0, rz1, rz2;
+
+		ox = vdupq_n_f32 (r_origin[0]);
+		oy = vdupq_n_f32 (r_origin[1]);
+		oz = vdupq_n_f32 (r_origin[2]);
+		rx0 = vdupq_n_f32 (r_pright[0]);
+		rx1 = vdupq_n_f32 (r_pright[1]);
+		rx2 = vdupq_n_f32 (r_pright[2]);
+		ry0 = vdupq_n_f32 (r_pup[0]);
+		ry1 = vdupq_n_f32 (r_pup[1]);
+		ry2 = vdupq_n_f32 (r_pup[2]);
+		rz0 = vdupq_n_f32 (r_ppn[0]);
+		rz1 = vdupq_n_f32 (r_ppn[1]);
+		rz2 = vdupq_n_f32 (r_ppn[2]);
+
+		for (i=0 ; i<count ; i+=4)
+		{
+			lx = vsubq_f32 (vld1q_f32 (&pblock->org[0][i]), ox);
+			ly = vsubq_f32 (vld1q_f32 (&pblock->org[1][i]), oy);
+			lz = vsubq_f32 (vld1q_f32 (&pblock->org[2][i]), oz);
+
+			t0 = vaddq_f32 (vaddq_f32 (vmulq_f32 (lx, rx0), vmulq_f32 (ly, rx1)),
+					vmulq_f32 (lz, rx2));
+			t1 = vaddq_f32 (vaddq_f32 (vmulq_f32 (lx, ry0), vmulq_f32 (ly, ry1)),
+					vmulq_f32 (lz, ry2));
+			t2 = vaddq_f32 (vaddq_f32 (vmulq_f32 (lx, rz0), vmulq_f32 (ly, rz1)),
+					vmulq_f32 (lz, rz2));
+			vzi = vdivq_f32 (vdupq_n_f32 (1.0), t2);
+
+			vst1q_f32 (&depth[i], t2);
+			vst1q_f32 (&zi[i], vzi);
+			vst1q_f32 (&px[i], vmulq_f32 (vzi, t0));
+			vst1q_f32 (&py[i], vmulq_f32 (vzi, t1));
+		}
+#else
+		__m128	ox, oy, oz, lx, ly, lz, t0, t1, t2, vzi;
+		__m128	rx0, rx1, rx2, ry0, ry1, ry2, rz0, rz1, rz2;
+
+		ox = _mm_set1_ps (r_origin[0]);
+		oy = _mm_set1_ps (r_origin[1]);
+		oz = _mm_set1_ps (r_origin[2]);
+		rx0 = _mm_set1_ps (r_pright[0]);
+		rx1 = _mm_set1_ps (r_pright[1]);
+		rx2 = _mm_set1_ps (r_pright[2]);
+		ry0 = _mm_set1_ps (r_pup[0]);
+		ry1 = _mm_set1_ps (r_pup[1]);
+		ry2 = _mm_set1_ps (r_pup[2]);
+		rz0 = _mm_set1_ps (r_ppn[0]);
+		rz1 = _mm_set1_ps (r_ppn[1]);
+		rz2 = _mm_set1_ps (r_ppn[2]);
+
+		for (i=0 ; i<count ; i+=4)
+		{
+			lx = _mm_sub_ps (_mm_loadu_ps (&pblock->org[0][i]), ox);
+			ly = _mm_sub_ps (_mm_loadu_ps (&pblock->org[1][i]), oy);
+			lz = _mm_sub_ps (_mm_loadu_ps (&pblock->org[2][i]), oz);
+
+			t0 = _mm_add_ps (_mm_add_ps (_mm_mul_ps (lx, rx0), _mm_mul_ps (ly, rx1)),
+					_mm_mul_ps (lz, rx2));
+			t1 = _mm_add_ps (_mm_add_ps (_mm_mul_ps (lx, ry0), _mm_mul_ps (ly, ry1)),
+					_mm_mul_ps (lz, ry2));
+			t2 = _mm_add_ps (_mm_add_ps (_mm_mul_ps (lx, rz0), _mm_mul_ps (ly, rz1)),
+					_mm_mul_ps (lz, rz2));
+			vzi = _mm_div_ps (_mm_set1_ps (1.0), t2);
+
+			_mm_storeu_ps (&depth[i], t2);
+			_mm_storeu_ps (&zi[i], vzi);
+			_mm_storeu_ps (&px[i], _mm_mul_ps (vzi, t0));
+			_mm_storeu_ps (&py[i], _mm_mul_ps (vzi, t1));
+		}
+#endif
+	}
+	else
+#endif
+	{
+		for (i=0 ; i<count ; i++)
+		{
+			local[0] = pblock->org[0][i] - r_origin[0];
+			local[1] = pblock->org[1][i] - r_origin[1];
+			local[2] = pblock->org[2][i] - r_origin[2];
+
+			transformed[0] = DotProduct(local, r_pright);
+			transformed[1] = DotProduct(local, r_pup);
+			transformed[2] = DotProduct(local, r_ppn);
+
+		// a float divide rounds the same as the old double one did
+			depth[i] = transformed[2];
+			zi[i] = 1.0f / transformed[2];
+			px[i] = zi[i] * transformed[0];
+			py[i] = zi[i] * transformed[1];
+		}
+	}
+
+	for (i=0 ; i<count ; i++)
+	{
+		if (depth[i] < PARTICLE_Z_CLIP)
+			continue;
+		D_SplatParticle (px[i], py[i], zi[i], (int)pblock->color[i]);
+	}
+}
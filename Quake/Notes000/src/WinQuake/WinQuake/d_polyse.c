@@ -26,7 +26,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 // TODO: put in span spilling to shrink list size
 // !!! if this is changed, it must be changed in d_polysa.s too !!!
-#define DPS_MAXSPANS			MAXHEIGHT+1	
+#define DPS_MAXSPANS			(vid.height+1)
 									// 1 extra for spanpackage that marks end
 
 // !!! if this is changed, it must be changed in asm_draw.h too !!!
@@ -81,6 +81,8 @@ int				r_zistepx, r_zistepy;
 int				d_aspancount, d_countextrastep;
 
 spanpackage_t			*a_spans;
+byte					*d_polysetspans;	// DPS_MAXSPANS for the mode
+int						d_polysetheight;
 spanpackage_t			*d_pedgespanpackage;
 static int				ystart;
 byte					*d_pdest, *d_ptex;
@@ -113,8 +115,248 @@ void D_DrawNonSubdiv (void);
 void D_PolysetRecursiveTriangle (int *p1, int *p2, int *p3);
 void D_PolysetSetEdgeTable (void);
 void D_RasterizeAliasPolySmooth (void);
+#if idSIMD
+void D_RasterizeAliasPolyHalfSpace (void);
+#endif
 void D_PolysetScanLeftEdge (int height);
 
+/*
+================
+D_PolysetSizeSpans
+================
+*/
+void D_PolysetSizeSpans (void)
+{
+	if (d_polysetheight == vid.height)
+		return;
+
+// one extra because of cache line pretouching
+	d_polysetspans = R_ModeAlloc (d_polysetspans,
+			(DPS_MAXSPANS + 1) * sizeof(spanpackage_t) + CACHE_SIZE,
+			"polyset spans");
+	d_polysetheight = vid.height;
+}
+
+
+/*
+==============================================================================
+
+POLYSET CAPTURE
+
+While d_polysetcapture is set, every D_PolysetDraw call is recorded along
+with the screen and z buffer from before the first one, so D_PolysetBench
+can time the rasterization of a frame's alias models on its own.
+
+==============================================================================
+*/
+
+#define MAX_CAPTURESETS		(64*1024)
+#define MAX_CAPTURETRIS		(256*1024)
+
+typedef struct
+{
+	affinetridesc_t	desc;
+	void			*colormap;
+	int				firsttri;
+} capturedset_t;
+
+qboolean				d_polysetcapture;
+
+static capturedset_t	*cap_sets;
+static finalvert_t		*cap_verts;
+static mtriangle_t		*cap_tris;
+static int				cap_numsets, cap_numtris;
+static byte				*cap_pixels;
+static short			*cap_zbuffer;
+static int				cap_pixelsize, cap_zsize;
+
+
+/*
+================
+D_PolysetFreeCapture
+================
+*/
+static void D_PolysetFreeCapture (void)
+{
+	free (cap_sets);
+	free (cap_verts);
+	free (cap_tris);
+	free (cap_pixels);
+	free (cap_zbuffer);
+	cap_sets = NULL;
+	cap_verts = NULL;
+	cap_tris = NULL;
+	cap_pixels = NULL;
+	cap_zbuffer = NULL;
+	d_polysetcapture = false;
+}
+
+
+/*
+================
+D_PolysetBeginCapture
+================
+*/
+void D_PolysetBeginCapture (void)
+{
+	D_PolysetFreeCapture ();
+
+	cap_sets = malloc (MAX_CAPTURESETS * sizeof(*cap_sets));
+	cap_verts = malloc (MAX_CAPTURETRIS * 3 * sizeof(*cap_verts));
+	cap_tris = malloc (MAX_CAPTURETRIS * sizeof(*cap_tris));
+	if (!cap_sets || !cap_verts || !cap_tris)
+		Sys_Error ("D_PolysetBeginCapture: out of memory");
+
+	cap_numsets = cap_numtris = 0;
+	d_polysetcapture = true;
+}
+
+
+/*
+================
+D_PolysetCapture
+
+Keeps a copy of the current polyset's triangles, each with its own copy of
+its three final verts, as the clipped triangles come one at a time out of
+the whole model's verts
+================
+*/
+static void D_PolysetCapture (void)
+{
+	capturedset_t	*pset;
+	mtriangle_t		*ptri, *pcap;
+	finalvert_t		*pfv;
+	int				i, j, numtris;
+
+	ptri = r_affinetridesc.ptriangles;
+	pfv = r_affinetridesc.pfinalverts;
+	numtris = r_affinetridesc.numtriangles;
+
+	if (cap_numsets == MAX_CAPTURESETS ||
+		cap_numtris + numtris > MAX_CAPTURETRIS)
+		return;
+
+	if (!cap_numsets)
+	{
+		cap_pixelsize = screenwidth * r_refdef.vrectbottom;
+		cap_zsize = d_zwidth * r_refdef.vrectbottom * sizeof(short);
+		cap_pixels = malloc (cap_pixelsize);
+		cap_zbuffer = malloc (cap_zsize);
+		if (!cap_pixels || !cap_zbuffer)
+			Sys_Error ("D_PolysetCapture: out of memory");
+		memcpy (cap_pixels, d_viewbuffer, cap_pixelsize);
+		memcpy (cap_zbuffer, d_pzbuffer, cap_zsize);
+	}
+
+	pset = &cap_sets[cap_numsets++];
+	pset->desc = r_affinetridesc;
+	pset->colormap = acolormap;
+	pset->firsttri = cap_numtris;
+
+	pcap = cap_tris + cap_numtris;
+	for (i=0 ; i<numtris ; i++, ptri++, pcap++)
+	{
+		pcap->facesfront = ptri->facesfront;
+		for (j=0 ; j<3 ; j++)
+		{
+			cap_verts[cap_numtris*3 + j] = pfv[ptri->vertindex[j]];
+			pcap->vertindex[j] = i*3 + j;
+		}
+		cap_numtris++;
+	}
+}
+
+
+/*
+================
+D_PolysetTimeCapture
+
+Best of passes draws of the captured polysets over the captured buffers
+================
+*/
+static double D_PolysetTimeCapture (int passes)
+{
+	capturedset_t	*pset;
+	int				i, pass;
+	double			start, time, best;
+
+	best = 1e9;
+	for (pass=0 ; pass<passes ; pass++)
+	{
+		VID_LockBuffer ();
+		memcpy (d_viewbuffer, cap_pixels, cap_pixelsize);
+		memcpy (d_pzbuffer, cap_zbuffer, cap_zsize);
+
+		start = Sys_FloatTime ();
+		for (i=0, pset=cap_sets ; i<cap_numsets ; i++, pset++)
+		{
+			r_affinetridesc = pset->desc;
+			r_affinetridesc.pfinalverts = cap_verts + pset->firsttri*3;
+			r_affinetridesc.ptriangles = cap_tris + pset->firsttri;
+			acolormap = pset->colormap;
+			if (r_affinetridesc.drawtype)
+				D_PolysetUpdateTables ();
+			D_PolysetDraw ();
+		}
+		time = Sys_FloatTime () - start;
+		VID_UnlockBuffer ();
+
+		if (time < best)
+			best = time;
+	}
+	return best;
+}
+
+
+static int		d_polysetbenchpasses;
+static double	d_polysetbenchtime[2];
+
+/*
+================
+D_PolysetBenchRun
+================
+*/
+static void D_PolysetBenchRun (int mode)
+{
+	d_polysetbenchtime[mode] = D_PolysetTimeCapture (d_polysetbenchpasses);
+}
+
+
+/*
+================
+D_PolysetBench
+
+Ends a capture, and times drawing what it caught with the edge stepping
+and the half-space rasterizers, and counts the pixels they disagree on
+================
+*/
+void D_PolysetBench (int passes)
+{
+	int		differ;
+
+	d_polysetcapture = false;
+	if (!cap_numsets)
+	{
+		Con_Printf ("no alias models were drawn\n");
+		D_PolysetFreeCapture ();
+		return;
+	}
+
+	d_polysetbenchpasses = passes;
+	differ = R_BenchModes ("d_simd", D_PolysetBenchRun, d_viewbuffer,
+			cap_pixelsize);
+
+	Con_Printf ("rasterize %i polysets, %i triangles\n",
+			cap_numsets, cap_numtris);
+	Con_Printf ("edge stepping: %.3f ms\n", d_polysetbenchtime[0] * 1000);
+#if idSIMD
+	Con_Printf ("half-space:    %.3f ms, %s\n", d_polysetbenchtime[1] * 1000,
+			R_BenchVerdict (differ));
+#endif
+
+	D_PolysetFreeCapture ();
+}
+
 #if	!id386
 
 /*
@@ -124,12 +366,11 @@ D_PolysetDraw
 */
 void D_PolysetDraw (void)
 {
-	spanpackage_t	spans[DPS_MAXSPANS + 1 +
-			((CACHE_SIZE - 1) / sizeof(spanpackage_t)) + 1];
-						// one extra because of cache line pretouching
-
 	a_spans = (spanpackage_t *)
-			(((long)&spans[0] + CACHE_SIZE - 1) & ~(CACHE_SIZE - 1));
+			(((long)d_polysetspans + CACHE_SIZE - 1) & ~(CACHE_SIZE - 1));
+
+	if (d_polysetcapture)
+		D_PolysetCapture ();
 
 	if (r_affinetridesc.drawtype)
 	{
@@ -299,6 +540,13 @@ void D_DrawNonSubdiv (void)
 		}
 
 		D_PolysetSetEdgeTable ();
+#if idSIMD
+		if (d_simd.value)
+		{
+			D_RasterizeAliasPolyHalfSpace ();
+			continue;
+		}
+#endif
 		D_RasterizeAliasPolySmooth ();
 	}
 }
@@ -973,6 +1221,442 @@ void D_RasterizeAliasPolySmooth (void)
 }
 
 
+#if idSIMD
+
+/*
+==============================================================================
+
+HALF-SPACE RASTERIZATION
+
+The triangle's bounding box is walked in HS_TILE pixel square tiles, each
+edge's function being checked at the tile corners to skip tiles that are
+wholly outside and drop the per pixel edge tests from tiles that are wholly
+inside, and then HS_TILE pixels of a row are z tested and drawn at a time.
+Vertices are whole pixels, so the edge functions are exact; a pixel is in if
+it is on or right of the left edges and left of the right edges, and on or
+below the top vertex and above the bottom one, which is just what the edge
+stepping of D_RasterizeAliasPolySmooth ends up covering.  The s, t, light
+and 1/z of each pixel are worked out from the origin of the left edge that
+the row is on, with the same integer steps, so the pixels come out the same
+as from D_PolysetDrawSpans8.
+
+==============================================================================
+*/
+
+#define HS_TILE		8
+
+typedef struct
+{
+	int		e;					// edge function at the bounding box origin,
+								//  >= 0 for pixels inside the edge
+	int		stepx, stepy;
+	int		lanes[HS_TILE];		// stepx times the lane
+} hsedge_t;
+
+typedef struct
+{
+	int		*pvert;				// the top of the left edge
+	int		s, t;				// the bottom edge starts on a whole texel
+	int		ybottom;
+	int		dx, dy;
+} hsleft_t;
+
+static hsedge_t	hs_edges[4];
+static int		hs_numedges;
+static hsleft_t	hs_left[2];
+static int		hs_slanes[HS_TILE], hs_tlanes[HS_TILE];
+static int		hs_llanes[HS_TILE], hs_zilanes[HS_TILE];
+
+
+/*
+================
+D_HalfSpaceAddEdge
+
+Horizontal edges add nothing, as the rows are already limited to the
+triangle's.  Right edges are negated and biased by one, so the pixels on
+them fail the >= 0 test.
+================
+*/
+static void D_HalfSpaceAddEdge (int *ptop, int *pbottom, qboolean right,
+	int x, int y)
+{
+	hsedge_t	*pedge;
+	int			i, dx, dy;
+
+	dy = pbottom[1] - ptop[1];
+	if (dy <= 0)
+		return;
+	dx = pbottom[0] - ptop[0];
+
+	pedge = &hs_edges[hs_numedges++];
+	if (right)
+	{
+		pedge->stepx = -dy;
+		pedge->stepy = dx;
+		pedge->e = -1;
+	}
+	else
+	{
+		pedge->stepx = dy;
+		pedge->stepy = -dx;
+		pedge->e = 0;
+	}
+	pedge->e += (x - ptop[0]) * pedge->stepx + (y - ptop[1]) * pedge->stepy;
+
+	for (i=0 ; i<HS_TILE ; i++)
+		pedge->lanes[i] = pedge->stepx * i;
+}
+
+
+/*
+================
+D_HalfSpaceDrawPixels
+
+One pixel at a time, for the tiles that run off the right of the screen,
+where there isn't room for a whole vector of pixels
+================
+*/
+static void D_HalfSpaceDrawPixels (int x, int y, int count, int *e, int s,
+	int t, int light, int zi)
+{
+	byte	*pdest, *pskin;
+	short	*pz;
+	int		i, j, z;
+
+	pdest = (byte *)d_viewbuffer + y * screenwidth + x;
+	pz = d_pzbuffer + y * d_zwidth + x;
+	pskin = (byte *)r_affinetridesc.pskin;
+
+	for (i=0 ; i<count ; i++, pdest++, pz++)
+	{
+		for (j=0 ; j<hs_numedges ; j++)
+			if (e[j] + hs_edges[j].lanes[i] < 0)
+				break;
+		if (j < hs_numedges)
+			continue;
+
+		z = (zi + hs_zilanes[i]) >> 16;
+		if (z >= *pz)
+		{
+			*pdest = ((byte *)acolormap)[pskin[((s + hs_slanes[i]) >> 16) +
+					((t + hs_tlanes[i]) >> 16) * r_affinetridesc.skinwidth] +
+					((light + hs_llanes[i]) & 0xFF00)];
+			*pz = z;
+		}
+	}
+}
+
+
+/*
+================
+D_HalfSpaceDraw8
+
+HS_TILE pixels of a row, starting at x, y, which has e for its edge
+functions and s, t, light and zi.  Lanes that are out of the triangle or
+fail the z test fetch texel 0 with no light, and are masked out of the
+stores.
+================
+*/
+static void D_HalfSpaceDraw8 (int x, int y, int *e, qboolean inside, int s,
+	int t, int light, int zi)
+{
+	byte	*pdest, *pskin, *pcolormap;
+	short	*pz;
+	int		i, offsets[HS_TILE], lights[HS_TILE];
+	byte	pix[HS_TILE];
+
+	pdest = (byte *)d_viewbuffer + y * screenwidth + x;
+	pz = d_pzbuffer + y * d_zwidth + x;
+
+#if idNEON
+{
+	uint32x4_t	m0, m1;
+	uint16x8_t	m16;
+	uint8x8_t	m8;
+	int32x4_t	v, zi0, zi1, zb0, zb1, o0, o1, lmask;
+	int16x8_t	zb;
+
+	m0 = m1 = vdupq_n_u32 (~0u);
+	if (!inside)
+	{
+		for (i=0 ; i<hs_numedges ; i++)
+		{
+			v = vdupq_n_s32 (e[i]);
+			m0 = vandq_u32 (m0, vcgeq_s32 (vaddq_s32 (v,
+					vld1q_s32 (hs_edges[i].lanes)), vdupq_n_s32 (0)));
+			m1 = vandq_u32 (m1, vcgeq_s32 (vaddq_s32 (v,
+					vld1q_s32 (hs_edges[i].lanes + 4)), vdupq_n_s32 (0)));
+		}
+	}
+
+	v = vdupq_n_s32 (zi);
+	zi0 = vshrq_n_s32 (vaddq_s32 (v, vld1q_s32 (hs_zilanes)), 16);
+	zi1 = vshrq_n_s32 (vaddq_s32 (v, vld1q_s32 (hs_zilanes + 4)), 16);
+	zb = vld1q_s16 (pz);
+	zb0 = vmovl_s16 (vget_low_s16 (zb));
+	zb1 = vmovl_s16 (vget_high_s16 (zb));
+	m0 = vandq_u32 (m0, vcgeq_s32 (zi0, zb0));
+	m1 = vandq_u32 (m1, vcgeq_s32 (zi1, zb1));
+
+	m16 = vcombine_u16 (vmovn_u32 (m0), vmovn_u32 (m1));
+	m8 = vmovn_u16 (m16);
+	if (!vget_lane_u64 (vreinterpret_u64_u8 (m8), 0))
+		return;
+
+	v = vdupq_n_s32 (s);
+	o0 = vshrq_n_s32 (vaddq_s32 (v, vld1q_s32 (hs_slanes)), 16);
+	o1 = vshrq_n_s32 (vaddq_s32 (v, vld1q_s32 (hs_slanes + 4)), 16);
+	v = vdupq_n_s32 (t);
+	o0 = vmlaq_n_s32 (o0, vshrq_n_s32 (vaddq_s32 (v,
+			vld1q_s32 (hs_tlanes)), 16), r_affinetridesc.skinwidth);
+	o1 = vmlaq_n_s32 (o1, vshrq_n_s32 (vaddq_s32 (v,
+			vld1q_s32 (hs_tlanes + 4)), 16), r_affinetridesc.skinwidth);
+	vst1q_s32 (offsets, vandq_s32 (o0, vreinterpretq_s32_u32 (m0)));
+	vst1q_s32 (offsets + 4, vandq_s32 (o1, vreinterpretq_s32_u32 (m1)));
+
+	v = vdupq_n_s32 (light);
+	lmask = vdupq_n_s32 (0xFF00);
+	vst1q_s32 (lights, vandq_s32 (vandq_s32 (vaddq_s32 (v,
+			vld1q_s32 (hs_llanes)), lmask), vreinterpretq_s32_u32 (m0)));
+	vst1q_s32 (lights + 4, vandq_s32 (vandq_s32 (vaddq_s32 (v,
+			vld1q_s32 (hs_llanes + 4)), lmask), vreinterpretq_s32_u32 (m1)));
+
+	pskin = (byte *)r_affinetridesc.pskin;
+	pcolormap = (byte *)acolormap;
+	for (i=0 ; i<HS_TILE ; i++)
+		pix[i] = pcolormap[pskin[offsets[i]] + lights[i]];
+
+	vst1_u8 (pdest, vbsl_u8 (m8, vld1_u8 (pix), vld1_u8 (pdest)));
+	vst1q_s16 (pz, vbslq_s16 (m16, vcombine_s16 (vmovn_s32 (zi0),
+			vmovn_s32 (zi1)), zb));
+}
+#else
+{
+	__m128i	m0, m1, m16, m8, v, zi0, zi1, zb, zb0, zb1, o0, o1, st;
+	__m128i	lmask, tmask, dest, minus1;
+
+	minus1 = _mm_set1_epi32 (-1);
+	m0 = m1 = minus1;
+	if (!inside)
+	{
+		for (i=0 ; i<hs_numedges ; i++)
+		{
+			v = _mm_set1_epi32 (e[i]);
+			m0 = _mm_and_si128 (m0, _mm_cmpgt_epi32 (_mm_add_epi32 (v,
+					_mm_loadu_si128 ((__m128i *)hs_edges[i].lanes)), minus1));
+			m1 = _mm_and_si128 (m1, _mm_cmpgt_epi32 (_mm_add_epi32 (v,
+					_mm_loadu_si128 ((__m128i *)(hs_edges[i].lanes + 4))),
+					minus1));
+		}
+	}
+
+// the z buffer is widened to compare, and the new z cut back down to 16
+// bits through sign extension so the saturating pack doesn't clamp it
+	v = _mm_set1_epi32 (zi);
+	zi0 = _mm_srai_epi32 (_mm_add_epi32 (v,
+			_mm_loadu_si128 ((__m128i *)hs_zilanes)), 16);
+	zi1 = _mm_srai_epi32 (_mm_add_epi32 (v,
+			_mm_loadu_si128 ((__m128i *)(hs_zilanes + 4))), 16);
+	zb = _mm_loadu_si128 ((__m128i *)pz);
+	zb0 = _mm_srai_epi32 (_mm_unpacklo_epi16 (zb, zb), 16);
+	zb1 = _mm_srai_epi32 (_mm_unpackhi_epi16 (zb, zb), 16);
+	m0 = _mm_andnot_si128 (_mm_cmplt_epi32 (zi0, zb0), m0);
+	m1 = _mm_andnot_si128 (_mm_cmplt_epi32 (zi1, zb1), m1);
+
+	m16 = _mm_packs_epi32 (m0, m1);
+	if (!_mm_movemask_epi8 (m16))
+		return;
+
+// the whole s and t go in the low and high halves of each lane, for one
+// multiply-add by 1 and the skin width
+	st = _mm_set1_epi32 ((r_affinetridesc.skinwidth << 16) | 1);
+	tmask = _mm_set1_epi32 (0xFFFF0000);
+	v = _mm_set1_epi32 (s);
+	o0 = _mm_srli_epi32 (_mm_add_epi32 (v,
+			_mm_loadu_si128 ((__m128i *)hs_slanes)), 16);
+	o1 = _mm_srli_epi32 (_mm_add_epi32 (v,
+			_mm_loadu_si128 ((__m128i *)(hs_slanes + 4))), 16);
+	v = _mm_set1_epi32 (t);
+	o0 = _mm_or_si128 (o0, _mm_and_si128 (_mm_add_epi32 (v,
+			_mm_loadu_si128 ((__m128i *)hs_tlanes)), tmask));
+	o1 = _mm_or_si128 (o1, _mm_and_si128 (_mm_add_epi32 (v,
+			_mm_loadu_si128 ((__m128i *)(hs_tlanes + 4))), tmask));
+	_mm_storeu_si128 ((__m128i *)offsets,
+			_mm_and_si128 (_mm_madd_epi16 (o0, st), m0));
+	_mm_storeu_si128 ((__m128i *)(offsets + 4),
+			_mm_and_si128 (_mm_madd_epi16 (o1, st), m1));
+
+	v = _mm_set1_epi32 (light);
+	lmask = _mm_set1_epi32 (0xFF00);
+	_mm_storeu_si128 ((__m128i *)lights, _mm_and_si128 (_mm_and_si128 (
+			_mm_add_epi32 (v, _mm_loadu_si128 ((__m128i *)hs_llanes)),
+			lmask), m0));
+	_mm_storeu_si128 ((__m128i *)(lights + 4), _mm_and_si128 (_mm_and_si128 (
+			_mm_add_epi32 (v, _mm_loadu_si128 ((__m128i *)(hs_llanes + 4))),
+			lmask), m1));
+
+	pskin = (byte *)r_affinetridesc.pskin;
+	pcolormap = (byte *)acolormap;
+	for (i=0 ; i<HS_TILE ; i++)
+		pix[i] = pcolormap[pskin[offsets[i]] + lights[i]];
+
+	m8 = _mm_packs_epi16 (m16, m16);
+	dest = _mm_loadl_epi64 ((__m128i *)pdest);
+	_mm_storel_epi64 ((__m128i *)pdest, _mm_or_si128 (_mm_and_si128 (m8,
+			_mm_loadl_epi64 ((__m128i *)pix)), _mm_andnot_si128 (m8, dest)));
+	_mm_storeu_si128 ((__m128i *)pz, _mm_or_si128 (_mm_and_si128 (m16,
+			_mm_packs_epi32 (
+			_mm_srai_epi32 (_mm_slli_epi32 (zi0, 16), 16),
+			_mm_srai_epi32 (_mm_slli_epi32 (zi1, 16), 16))),
+			_mm_andnot_si128 (m16, zb)));
+}
+#endif
+}
+
+
+/*
+================
+D_RasterizeAliasPolyHalfSpace
+
+The same triangle as D_RasterizeAliasPolySmooth, from the same edge table
+================
+*/
+void D_RasterizeAliasPolyHalfSpace (void)
+{
+	int			*ptop, *pbottom;
+	int			i, j, x, y, minx, maxx, ytop, ybottom, yend, lo, hi, k, dx;
+	int			e[4], rows[HS_TILE][4];
+	int			s, t, light, zi;
+	qboolean	inside;
+	hsleft_t	*pleft;
+
+	D_PolysetCalcGradients (r_affinetridesc.skinwidth);
+
+	ytop = pedgetable->pleftedgevert0[1];
+	if (pedgetable->numleftedges == 2)
+		ybottom = pedgetable->pleftedgevert2[1];
+	else
+		ybottom = pedgetable->pleftedgevert1[1];
+
+	minx = maxx = r_p0[0];
+	if (r_p1[0] < minx)
+		minx = r_p1[0];
+	if (r_p1[0] > maxx)
+		maxx = r_p1[0];
+	if (r_p2[0] < minx)
+		minx = r_p2[0];
+	if (r_p2[0] > maxx)
+		maxx = r_p2[0];
+
+	hs_numedges = 0;
+	D_HalfSpaceAddEdge (pedgetable->pleftedgevert0,
+			pedgetable->pleftedgevert1, false, minx, ytop);
+	if (pedgetable->numleftedges == 2)
+		D_HalfSpaceAddEdge (pedgetable->pleftedgevert1,
+				pedgetable->pleftedgevert2, false, minx, ytop);
+	D_HalfSpaceAddEdge (pedgetable->prightedgevert0,
+			pedgetable->prightedgevert1, true, minx, ytop);
+	if (pedgetable->numrightedges == 2)
+		D_HalfSpaceAddEdge (pedgetable->prightedgevert1,
+				pedgetable->prightedgevert2, true, minx, ytop);
+
+// the rows of the bottom left edge carry on from its top vertex, with the
+// fractions of s and t dropped, as the edge stepper does
+	for (i=0 ; i<pedgetable->numleftedges ; i++)
+	{
+		ptop = i ? pedgetable->pleftedgevert1 : pedgetable->pleftedgevert0;
+		pbottom = i ? pedgetable->pleftedgevert2 : pedgetable->pleftedgevert1;
+		pleft = &hs_left[i];
+		pleft->pvert = ptop;
+		pleft->s = i ? ptop[2] & ~0xFFFF : ptop[2];
+		pleft->t = i ? ptop[3] & ~0xFFFF : ptop[3];
+		pleft->ybottom = pbottom[1];
+		pleft->dx = pbottom[0] - ptop[0];
+		pleft->dy = pbottom[1] - ptop[1];
+	}
+
+	for (i=0 ; i<HS_TILE ; i++)
+	{
+		hs_slanes[i] = r_sstepx * i;
+		hs_tlanes[i] = r_tstepx * i;
+		hs_llanes[i] = r_lstepx * i;
+		hs_zilanes[i] = r_zistepx * i;
+	}
+
+	for (y=ytop ; y<ybottom ; y+=HS_TILE)
+	{
+		yend = y + HS_TILE;
+		if (yend > ybottom)
+			yend = ybottom;
+
+	// s, t, light and 1/z at the left of the bounding box for each row
+		for (k=y ; k<yend ; k++)
+		{
+			pleft = &hs_left[k >= hs_left[0].ybottom];
+			i = k - pleft->pvert[1];
+			dx = minx - pleft->pvert[0];
+
+			rows[k-y][0] = pleft->s + i * r_sstepy + dx * r_sstepx;
+			rows[k-y][1] = pleft->t + i * r_tstepy + dx * r_tstepx;
+			rows[k-y][3] = pleft->pvert[5] + i * r_zistepy + dx * r_zistepx;
+
+		// the edge stepper takes one off the light step for each pixel that
+		// a left edge leaning left moves over
+			rows[k-y][2] = pleft->pvert[4] + i * r_lstepy + dx * r_lstepx;
+			if (pleft->dx < 0)
+				rows[k-y][2] -= i * pleft->dx / pleft->dy;
+		}
+
+		for (x=minx ; x<maxx ; x+=HS_TILE)
+		{
+		// the edge functions are linear, so their extremes over the tile
+		// are at its corners
+			inside = true;
+			for (j=0 ; j<hs_numedges ; j++)
+			{
+				e[j] = hs_edges[j].e + (x - minx) * hs_edges[j].stepx +
+						(y - ytop) * hs_edges[j].stepy;
+				lo = hi = e[j];
+				if (hs_edges[j].stepx < 0)
+					lo += hs_edges[j].stepx * (HS_TILE - 1);
+				else
+					hi += hs_edges[j].stepx * (HS_TILE - 1);
+				if (hs_edges[j].stepy < 0)
+					lo += hs_edges[j].stepy * (yend - y - 1);
+				else
+					hi += hs_edges[j].stepy * (yend - y - 1);
+				if (hi < 0)
+					break;
+				if (lo < 0)
+					inside = false;
+			}
+			if (j < hs_numedges)
+				continue;
+
+			dx = x - minx;
+			for (k=y ; k<yend ; k++)
+			{
+				s = rows[k-y][0] + dx * r_sstepx;
+				t = rows[k-y][1] + dx * r_tstepx;
+				light = rows[k-y][2] + dx * r_lstepx;
+				zi = rows[k-y][3] + dx * r_zistepx;
+
+				if (x + HS_TILE <= screenwidth && x + HS_TILE <= d_zwidth)
+					D_HalfSpaceDraw8 (x, k, e, inside, s, t, light, zi);
+				else
+					D_HalfSpaceDrawPixels (x, k, maxx - x < HS_TILE ?
+							maxx - x : HS_TILE, e, s, t, light, zi);
+
+				for (j=0 ; j<hs_numedges ; j++)
+					e[j] += hs_edges[j].stepy;
+			}
+		}
+	}
+}
+
+#endif	// idSIMD
+
+
 /*
 ================
 D_PolysetSetEdgeTable
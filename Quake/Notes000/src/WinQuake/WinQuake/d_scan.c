@@ -25,13 +25,55 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "r_local.h"
 #include "d_local.h"
 
-unsigned char	*r_turb_pbase, *r_turb_pdest;
-fixed16_t		r_turb_s, r_turb_t, r_turb_sstep, r_turb_tstep;
-int				*r_turb_turb;
-int				r_turb_spancount;
+THREADLOCAL unsigned char	*r_turb_pbase, *r_turb_pdest;
+THREADLOCAL fixed16_t		r_turb_s, r_turb_t, r_turb_sstep, r_turb_tstep;
+THREADLOCAL int				*r_turb_turb;
+THREADLOCAL int				r_turb_spancount;
 
 void D_DrawTurbulent8Span (void);
 
+byte	**d_warprows;		// [vid.height + AMP2*2]
+int		*d_warpcolumns;		// [vid.width + AMP2*2]
+int		d_warpwidth, d_warpheight;
+
+// what the warp tables were last built for
+static qboolean	d_warpvalid;
+static vrect_t	d_warpvrect, d_warpscrvrect;
+static pixel_t	*d_warpviewbuffer;
+static int		d_warpscreenwidth;
+
+
+/*
+=============
+D_WarpSizeBuffers
+=============
+*/
+void D_WarpSizeBuffers (void)
+{
+	if (d_warpwidth == vid.width && d_warpheight == vid.height)
+		return;
+
+	d_warprows = R_ModeAlloc (d_warprows,
+			(vid.height + AMP2*2) * sizeof(byte *), "warp rows");
+	d_warpcolumns = R_ModeAlloc (d_warpcolumns,
+			(vid.width + AMP2*2) * sizeof(int), "warp columns");
+	d_warpwidth = vid.width;
+	d_warpheight = vid.height;
+	d_warpvalid = false;
+}
+
+
+/*
+=============
+D_SameRect
+=============
+*/
+static qboolean D_SameRect (vrect_t *a, vrect_t *b)
+{
+	return a->x == b->x && a->y == b->y &&
+			a->width == b->width && a->height == b->height;
+}
+
 
 /*
 =============
@@ -49,26 +91,42 @@ void D_WarpScreen (void)
 	int		*turb;
 	int		*col;
 	byte	**row;
-	byte	*rowptr[MAXHEIGHT+(AMP2*2)];
-	int		column[MAXWIDTH+(AMP2*2)];
+	byte	**rowptr;
+	int		*column;
 	float	wratio, hratio;
 
+	rowptr = d_warprows;
+	column = d_warpcolumns;
+
 	w = r_refdef.vrect.width;
 	h = r_refdef.vrect.height;
 
-	wratio = w / (float)scr_vrect.width;
-	hratio = h / (float)scr_vrect.height;
-
-	for (v=0 ; v<scr_vrect.height+AMP2*2 ; v++)
+// the row and column tables only change with the view size
+	if (!d_warpvalid || d_warpviewbuffer != d_viewbuffer ||
+		d_warpscreenwidth != screenwidth ||
+		!D_SameRect (&d_warpvrect, &r_refdef.vrect) ||
+		!D_SameRect (&d_warpscrvrect, &scr_vrect))
 	{
-		rowptr[v] = d_viewbuffer + (r_refdef.vrect.y * screenwidth) +
-				 (screenwidth * (int)((float)v * hratio * h / (h + AMP2 * 2)));
-	}
+		wratio = w / (float)scr_vrect.width;
+		hratio = h / (float)scr_vrect.height;
 
-	for (u=0 ; u<scr_vrect.width+AMP2*2 ; u++)
-	{
-		column[u] = r_refdef.vrect.x +
-				(int)((float)u * wratio * w / (w + AMP2 * 2));
+		for (v=0 ; v<scr_vrect.height+AMP2*2 ; v++)
+		{
+			rowptr[v] = d_viewbuffer + (r_refdef.vrect.y * screenwidth) +
+					 (screenwidth * (int)((float)v * hratio * h / (h + AMP2 * 2)));
+		}
+
+		for (u=0 ; u<scr_vrect.width+AMP2*2 ; u++)
+		{
+			column[u] = r_refdef.vrect.x +
+					(int)((float)u * wratio * w / (w + AMP2 * 2));
+		}
+
+		d_warpvalid = true;
+		d_warpviewbuffer = d_viewbuffer;
+		d_warpscreenwidth = screenwidth;
+		d_warpvrect = r_refdef.vrect;
+		d_warpscrvrect = scr_vrect;
 	}
 
 	turb = intsintable + ((int)(cl.time*SPEED)&(CYCLE-1));
@@ -114,19 +172,158 @@ void D_DrawTurbulent8Span (void)
 #endif	// !id386
 
 
+#if idSIMD
+
 /*
 =============
-Turbulent8
+D_DrawTurbulent8SpanSIMD
+
+Works out the warp eight pixels at a time with the same integer math as
+D_DrawTurbulent8Span; only the sine table and texel reads stay scalar
 =============
 */
-void Turbulent8 (espan_t *pspan)
+static void D_DrawTurbulent8SpanSIMD (void)
+{
+	byte		*pdest, *pbase;
+	int			*turb;
+	fixed16_t	s, t, sstep, tstep;
+	int			i, count, sturb, tturb;
+	int			sindex[8], tindex[8], sturbs[8], tturbs[8];
+
+	pdest = r_turb_pdest;
+	pbase = r_turb_pbase;
+	turb = r_turb_turb;
+	s = r_turb_s;
+	t = r_turb_t;
+	sstep = r_turb_sstep;
+	tstep = r_turb_tstep;
+
+	for (count = r_turb_spancount ; count >= 8 ; count -= 8, pdest += 8)
+	{
+#if idNEON
+		static const int	steps[4] = {0, 1, 2, 3};
+		int32x4_t	vs0, vs1, vt0, vt1, vi, vmask;
+		uint16x8_t	vo;
+
+		vi = vld1q_s32 (steps);
+		vs0 = vmlaq_s32 (vdupq_n_s32 (s), vi, vdupq_n_s32 (sstep));
+		vt0 = vmlaq_s32 (vdupq_n_s32 (t), vi, vdupq_n_s32 (tstep));
+		vs1 = vaddq_s32 (vs0, vdupq_n_s32 ((unsigned)sstep * 4));
+		vt1 = vaddq_s32 (vt0, vdupq_n_s32 ((unsigned)tstep * 4));
+
+		vmask = vdupq_n_s32 (CYCLE-1);
+		vst1q_s32 (sindex, vandq_s32 (vshrq_n_s32 (vs0, 16), vmask));
+		vst1q_s32 (sindex + 4, vandq_s32 (vshrq_n_s32 (vs1, 16), vmask));
+		vst1q_s32 (tindex, vandq_s32 (vshrq_n_s32 (vt0, 16), vmask));
+		vst1q_s32 (tindex + 4, vandq_s32 (vshrq_n_s32 (vt1, 16), vmask));
+
+		for (i=0 ; i<8 ; i++)
+		{
+			sturbs[i] = turb[tindex[i]];
+			tturbs[i] = turb[sindex[i]];
+		}
+
+		vmask = vdupq_n_s32 (63);
+		vo = vorrq_u16 (
+				vshlq_n_u16 (vcombine_u16 (
+					vmovn_u32 (vreinterpretq_u32_s32 (vandq_s32 (vshrq_n_s32 (
+						vaddq_s32 (vt0, vld1q_s32 (tturbs)), 16), vmask))),
+					vmovn_u32 (vreinterpretq_u32_s32 (vandq_s32 (vshrq_n_s32 (
+						vaddq_s32 (vt1, vld1q_s32 (tturbs + 4)), 16), vmask)))), 6),
+				vcombine_u16 (
+					vmovn_u32 (vreinterpretq_u32_s32 (vandq_s32 (vshrq_n_s32 (
+						vaddq_s32 (vs0, vld1q_s32 (sturbs)), 16), vmask))),
+					vmovn_u32 (vreinterpretq_u32_s32 (vandq_s32 (vshrq_n_s32 (
+						vaddq_s32 (vs1, vld1q_s32 (sturbs + 4)), 16), vmask)))));
+
+		pdest[0] = pbase[vgetq_lane_u16 (vo, 0)];
+		pdest[1] = pbase[vgetq_lane_u16 (vo, 1)];
+		pdest[2] = pbase[vgetq_lane_u16 (vo, 2)];
+		pdest[3] = pbase[vgetq_lane_u16 (vo, 3)];
+		pdest[4] = pbase[vgetq_lane_u16 (vo, 4)];
+		pdest[5] = pbase[vgetq_lane_u16 (vo, 5)];
+		pdest[6] = pbase[vgetq_lane_u16 (vo, 6)];
+		pdest[7] = pbase[vgetq_lane_u16 (vo, 7)];
+#else
+		__m128i		vs0, vs1, vt0, vt1, vmask, vo;
+
+		vs0 = _mm_setr_epi32 (s, (unsigned)s + sstep,
+				(unsigned)s + 2*(unsigned)sstep, (unsigned)s + 3*(unsigned)sstep);
+		vt0 = _mm_setr_epi32 (t, (unsigned)t + tstep,
+				(unsigned)t + 2*(unsigned)tstep, (unsigned)t + 3*(unsigned)tstep);
+		vs1 = _mm_add_epi32 (vs0, _mm_set1_epi32 ((unsigned)sstep * 4));
+		vt1 = _mm_add_epi32 (vt0, _mm_set1_epi32 ((unsigned)tstep * 4));
+
+		vmask = _mm_set1_epi32 (CYCLE-1);
+		_mm_storeu_si128 ((__m128i *)sindex,
+				_mm_and_si128 (_mm_srai_epi32 (vs0, 16), vmask));
+		_mm_storeu_si128 ((__m128i *)(sindex + 4),
+				_mm_and_si128 (_mm_srai_epi32 (vs1, 16), vmask));
+		_mm_storeu_si128 ((__m128i *)tindex,
+				_mm_and_si128 (_mm_srai_epi32 (vt0, 16), vmask));
+		_mm_storeu_si128 ((__m128i *)(tindex + 4),
+				_mm_and_si128 (_mm_srai_epi32 (vt1, 16), vmask));
+
+		for (i=0 ; i<8 ; i++)
+		{
+			sturbs[i] = turb[tindex[i]];
+			tturbs[i] = turb[sindex[i]];
+		}
+
+		vmask = _mm_set1_epi32 (63);
+		vo = _mm_or_si128 (
+				_mm_slli_epi16 (_mm_packs_epi32 (
+					_mm_and_si128 (_mm_srai_epi32 (_mm_add_epi32 (vt0,
+						_mm_loadu_si128 ((__m128i *)tturbs)), 16), vmask),
+					_mm_and_si128 (_mm_srai_epi32 (_mm_add_epi32 (vt1,
+						_mm_loadu_si128 ((__m128i *)(tturbs + 4))), 16), vmask)), 6),
+				_mm_packs_epi32 (
+					_mm_and_si128 (_mm_srai_epi32 (_mm_add_epi32 (vs0,
+						_mm_loadu_si128 ((__m128i *)sturbs)), 16), vmask),
+					_mm_and_si128 (_mm_srai_epi32 (_mm_add_epi32 (vs1,
+						_mm_loadu_si128 ((__m128i *)(sturbs + 4))), 16), vmask)));
+
+		pdest[0] = pbase[_mm_extract_epi16 (vo, 0)];
+		pdest[1] = pbase[_mm_extract_epi16 (vo, 1)];
+		pdest[2] = pbase[_mm_extract_epi16 (vo, 2)];
+		pdest[3] = pbase[_mm_extract_epi16 (vo, 3)];
+		pdest[4] = pbase[_mm_extract_epi16 (vo, 4)];
+		pdest[5] = pbase[_mm_extract_epi16 (vo, 5)];
+		pdest[6] = pbase[_mm_extract_epi16 (vo, 6)];
+		pdest[7] = pbase[_mm_extract_epi16 (vo, 7)];
+#endif
+		s += sstep * 8;
+		t += tstep * 8;
+	}
+
+	for ( ; count > 0 ; count--)
+	{
+		sturb = ((s + turb[(t>>16)&(CYCLE-1)])>>16)&63;
+		tturb = ((t + turb[(s>>16)&(CYCLE-1)])>>16)&63;
+		*pdest++ = pbase[(tturb<<6) + sturb];
+		s += sstep;
+		t += tstep;
+	}
+	r_turb_pdest = pdest;
+}
+
+#endif	// idSIMD
+
+
+/*
+=============
+D_TurbulentSpans
+
+Steps s and t across the spans in 16 pixel segments, wrapped to the
+turbulence cycle, and hands each segment to drawspan
+=============
+*/
+static void D_TurbulentSpans (espan_t *pspan, void (*drawspan)(void))
 {
 	int				count;
 	fixed16_t		snext, tnext;
 	float			sdivz, tdivz, zi, z, du, dv, spancountminus1;
 	float			sdivz16stepu, tdivz16stepu, zi16stepu;
-	
-	r_turb_turb = sintable + ((int)(cl.time*SPEED)&(CYCLE-1));
 
 	r_turb_sstep = 0;	// keep compiler happy
 	r_turb_tstep = 0;	// ditto
@@ -236,7 +433,7 @@ void Turbulent8 (espan_t *pspan)
 			r_turb_s = r_turb_s & ((CYCLE<<16)-1);
 			r_turb_t = r_turb_t & ((CYCLE<<16)-1);
 
-			D_DrawTurbulent8Span ();
+			(*drawspan) ();
 
 			r_turb_s = snext;
 			r_turb_t = tnext;
@@ -247,6 +444,265 @@ void Turbulent8 (espan_t *pspan)
 }
 
 
+/*
+=============
+Turbulent8
+=============
+*/
+void Turbulent8 (espan_t *pspan)
+{
+	r_turb_turb = sintable + ((int)(cl.time*SPEED)&(CYCLE-1));
+
+#if idSIMD
+	if (d_simd.value)
+	{
+		D_TurbulentSpans (pspan, D_DrawTurbulent8SpanSIMD);
+		return;
+	}
+#endif
+	D_TurbulentSpans (pspan, D_DrawTurbulent8Span);
+}
+
+
+/*
+==============================================================================
+
+WARPED TEXTURE TILES
+
+The warp only depends on the texel a pixel lands in and on the phase of the
+cycle, which changes SPEED times a second, so each water texture is warped
+once per phase into a CYCLE*CYCLE tile that every turbulent surface using it
+then samples directly.  Texels are warped from their centers, so a pixel can
+land one texel away from where Turbulent8 puts it, so the tiles are only
+used with d_turbcache 1 and the default keeps warping every pixel, eight at
+a time with d_simd 1
+
+==============================================================================
+*/
+
+#define	MAX_TURBTILES	8		// distinct turbulent textures drawn per phase
+
+typedef struct
+{
+	texture_t	*texture;		// NULL is an empty tile
+	int			phase;
+	byte		pixels[CYCLE*CYCLE];
+} turbtile_t;
+
+cvar_t	d_turbcache = {"d_turbcache", "0"};
+
+static turbtile_t	d_turbtiles[MAX_TURBTILES];
+static int			d_turbrover;
+
+
+/*
+=============
+D_FlushTurbulentTiles
+
+Called when the textures the tiles were warped from go away
+=============
+*/
+void D_FlushTurbulentTiles (void)
+{
+	int		i;
+
+	for (i=0 ; i<MAX_TURBTILES ; i++)
+		d_turbtiles[i].texture = NULL;
+}
+
+
+/*
+=============
+D_TurbulentTile
+
+Returns the tile for texture at the current phase, warping it if it is not
+cached, or NULL when every tile is already in use for this phase.  Only
+called while surfaces are set up, never from the drawing threads, and a tile
+is never reused in the phase it was warped for, so one frame's spans always
+see the tiles they were handed
+=============
+*/
+byte *D_TurbulentTile (texture_t *texture)
+{
+	int			i, s, t, phase, sturb, tturb;
+	int			*turb;
+	byte		*pbase, *pdest;
+	turbtile_t	*tile;
+
+	phase = (int)(cl.time*SPEED)&(CYCLE-1);
+
+	for (i=0 ; i<MAX_TURBTILES ; i++)
+	{
+		tile = &d_turbtiles[i];
+		if (tile->texture == texture && tile->phase == phase)
+			return tile->pixels;
+	}
+
+	for (i=0 ; i<MAX_TURBTILES ; i++)
+	{
+		tile = &d_turbtiles[d_turbrover];
+		d_turbrover = (d_turbrover + 1) & (MAX_TURBTILES-1);
+		if (!tile->texture || tile->phase != phase)
+			break;
+	}
+	if (i == MAX_TURBTILES)
+		return NULL;
+
+	tile->texture = texture;
+	tile->phase = phase;
+
+	turb = sintable + phase;
+	pbase = (byte *)texture + texture->offsets[0];
+	pdest = tile->pixels;
+
+	for (t=0 ; t<CYCLE ; t++)
+	{
+		for (s=0 ; s<CYCLE ; s++)
+		{
+			sturb = (((s<<16) + 0x8000 + turb[t])>>16)&63;
+			tturb = (((t<<16) + 0x8000 + turb[s])>>16)&63;
+			*pdest++ = pbase[(tturb<<6) + sturb];
+		}
+	}
+
+	return tile->pixels;
+}
+
+
+/*
+=============
+D_DrawTurbulentTile8Span
+=============
+*/
+static void D_DrawTurbulentTile8Span (void)
+{
+	do
+	{
+		*r_turb_pdest++ = r_turb_pbase[((r_turb_t>>16)&(CYCLE-1))*CYCLE +
+				((r_turb_s>>16)&(CYCLE-1))];
+		r_turb_s += r_turb_sstep;
+		r_turb_t += r_turb_tstep;
+	} while (--r_turb_spancount > 0);
+}
+
+
+#if idSIMD
+
+/*
+=============
+D_DrawTurbulentTile8SpanSIMD
+
+Works out the tile offsets eight pixels at a time, the same as
+D_DrawTurbulentTile8Span
+=============
+*/
+static void D_DrawTurbulentTile8SpanSIMD (void)
+{
+	byte		*pdest, *pbase;
+	fixed16_t	s, t, sstep, tstep;
+	int			count;
+
+	pdest = r_turb_pdest;
+	pbase = r_turb_pbase;
+	s = r_turb_s;
+	t = r_turb_t;
+	sstep = r_turb_sstep;
+	tstep = r_turb_tstep;
+
+	for (count = r_turb_spancount ; count >= 8 ; count -= 8, pdest += 8)
+	{
+#if idNEON
+		static const int	steps[4] = {0, 1, 2, 3};
+		int32x4_t	vs0, vs1, vt0, vt1, vi, vmask;
+		uint16x8_t	vo;
+
+		vi = vld1q_s32 (steps);
+		vs0 = vmlaq_s32 (vdupq_n_s32 (s), vi, vdupq_n_s32 (sstep));
+		vt0 = vmlaq_s32 (vdupq_n_s32 (t), vi, vdupq_n_s32 (tstep));
+		vs1 = vaddq_s32 (vs0, vdupq_n_s32 ((unsigned)sstep * 4));
+		vt1 = vaddq_s32 (vt0, vdupq_n_s32 ((unsigned)tstep * 4));
+
+		vmask = vdupq_n_s32 (CYCLE-1);
+		vo = vorrq_u16 (
+				vshlq_n_u16 (vcombine_u16 (
+					vmovn_u32 (vreinterpretq_u32_s32 (vandq_s32 (vshrq_n_s32 (vt0, 16), vmask))),
+					vmovn_u32 (vreinterpretq_u32_s32 (vandq_s32 (vshrq_n_s32 (vt1, 16), vmask)))), 7),
+				vcombine_u16 (
+					vmovn_u32 (vreinterpretq_u32_s32 (vandq_s32 (vshrq_n_s32 (vs0, 16), vmask))),
+					vmovn_u32 (vreinterpretq_u32_s32 (vandq_s32 (vshrq_n_s32 (vs1, 16), vmask)))));
+
+		pdest[0] = pbase[vgetq_lane_u16 (vo, 0)];
+		pdest[1] = pbase[vgetq_lane_u16 (vo, 1)];
+		pdest[2] = pbase[vgetq_lane_u16 (vo, 2)];
+		pdest[3] = pbase[vgetq_lane_u16 (vo, 3)];
+		pdest[4] = pbase[vgetq_lane_u16 (vo, 4)];
+		pdest[5] = pbase[vgetq_lane_u16 (vo, 5)];
+		pdest[6] = pbase[vgetq_lane_u16 (vo, 6)];
+		pdest[7] = pbase[vgetq_lane_u16 (vo, 7)];
+#else
+		__m128i		vs0, vs1, vt0, vt1, vmask, vo;
+
+		vs0 = _mm_setr_epi32 (s, (unsigned)s + sstep,
+				(unsigned)s + 2*(unsigned)sstep, (unsigned)s + 3*(unsigned)sstep);
+		vt0 = _mm_setr_epi32 (t, (unsigned)t + tstep,
+				(unsigned)t + 2*(unsigned)tstep, (unsigned)t + 3*(unsigned)tstep);
+		vs1 = _mm_add_epi32 (vs0, _mm_set1_epi32 ((unsigned)sstep * 4));
+		vt1 = _mm_add_epi32 (vt0, _mm_set1_epi32 ((unsigned)tstep * 4));
+
+		vmask = _mm_set1_epi32 (CYCLE-1);
+		vo = _mm_or_si128 (
+				_mm_slli_epi16 (_mm_packs_epi32 (
+					_mm_and_si128 (_mm_srai_epi32 (vt0, 16), vmask),
+					_mm_and_si128 (_mm_srai_epi32 (vt1, 16), vmask)), 7),
+				_mm_packs_epi32 (
+					_mm_and_si128 (_mm_srai_epi32 (vs0, 16), vmask),
+					_mm_and_si128 (_mm_srai_epi32 (vs1, 16), vmask)));
+
+		pdest[0] = pbase[_mm_extract_epi16 (vo, 0)];
+		pdest[1] = pbase[_mm_extract_epi16 (vo, 1)];
+		pdest[2] = pbase[_mm_extract_epi16 (vo, 2)];
+		pdest[3] = pbase[_mm_extract_epi16 (vo, 3)];
+		pdest[4] = pbase[_mm_extract_epi16 (vo, 4)];
+		pdest[5] = pbase[_mm_extract_epi16 (vo, 5)];
+		pdest[6] = pbase[_mm_extract_epi16 (vo, 6)];
+		pdest[7] = pbase[_mm_extract_epi16 (vo, 7)];
+#endif
+		s += sstep * 8;
+		t += tstep * 8;
+	}
+
+	for ( ; count > 0 ; count--)
+	{
+		*pdest++ = pbase[((t>>16)&(CYCLE-1))*CYCLE + ((s>>16)&(CYCLE-1))];
+		s += sstep;
+		t += tstep;
+	}
+	r_turb_pdest = pdest;
+}
+
+#endif	// idSIMD
+
+
+/*
+=============
+TurbulentTile8
+
+Draws turbulent spans from a tile returned by D_TurbulentTile
+=============
+*/
+void TurbulentTile8 (espan_t *pspan)
+{
+#if idSIMD
+	if (d_simd.value)
+	{
+		D_TurbulentSpans (pspan, D_DrawTurbulentTile8SpanSIMD);
+		return;
+	}
+#endif
+	D_TurbulentSpans (pspan, D_DrawTurbulentTile8Span);
+}
+
+
 #if	!id386
 
 /*
@@ -385,6 +841,238 @@ void D_DrawSpans8 (espan_t *pspan)
 #endif
 
 
+#if idSIMD
+
+/*
+=============
+D_DrawRun8
+
+Draws eight pixels stepped from s and t, with the texel offsets
+(s >> 16) + (t >> 16) * width computed eight at a time in 16 bit lanes.
+s and t are clamped to the cached surface, which is at most 256 texels
+on a side, so every offset fits and matches the scalar math exactly
+=============
+*/
+#if idNEON
+
+static void D_DrawRun8 (byte *pdest, byte *pbase, fixed16_t s, fixed16_t t,
+	fixed16_t sstep, fixed16_t tstep, int width)
+{
+	int32x4_t	vs0, vs1, vt0, vt1;
+	uint16x8_t	vo;
+	int			lanes[4];
+
+	lanes[0] = s;
+	lanes[1] = (unsigned)s + sstep;
+	lanes[2] = (unsigned)s + 2*(unsigned)sstep;
+	lanes[3] = (unsigned)s + 3*(unsigned)sstep;
+	vs0 = vld1q_s32 (lanes);
+	lanes[0] = t;
+	lanes[1] = (unsigned)t + tstep;
+	lanes[2] = (unsigned)t + 2*(unsigned)tstep;
+	lanes[3] = (unsigned)t + 3*(unsigned)tstep;
+	vt0 = vld1q_s32 (lanes);
+	vs1 = vaddq_s32 (vs0, vdupq_n_s32 ((unsigned)sstep * 4));
+	vt1 = vaddq_s32 (vt0, vdupq_n_s32 ((unsigned)tstep * 4));
+
+	vo = vmlaq_u16 (
+			vcombine_u16 (vshrn_n_u32 (vreinterpretq_u32_s32 (vs0), 16),
+				vshrn_n_u32 (vreinterpretq_u32_s32 (vs1), 16)),
+			vcombine_u16 (vshrn_n_u32 (vreinterpretq_u32_s32 (vt0), 16),
+				vshrn_n_u32 (vreinterpretq_u32_s32 (vt1), 16)),
+			vdupq_n_u16 (width));
+
+	pdest[0] = pbase[vgetq_lane_u16 (vo, 0)];
+	pdest[1] = pbase[vgetq_lane_u16 (vo, 1)];
+	pdest[2] = pbase[vgetq_lane_u16 (vo, 2)];
+	pdest[3] = pbase[vgetq_lane_u16 (vo, 3)];
+	pdest[4] = pbase[vgetq_lane_u16 (vo, 4)];
+	pdest[5] = pbase[vgetq_lane_u16 (vo, 5)];
+	pdest[6] = pbase[vgetq_lane_u16 (vo, 6)];
+	pdest[7] = pbase[vgetq_lane_u16 (vo, 7)];
+}
+
+#else
+
+static void D_DrawRun8 (byte *pdest, byte *pbase, fixed16_t s, fixed16_t t,
+	fixed16_t sstep, fixed16_t tstep, int width)
+{
+	__m128i		vs0, vs1, vt0, vt1, vo;
+
+	vs0 = _mm_setr_epi32 (s, (unsigned)s + sstep,
+			(unsigned)s + 2*(unsigned)sstep, (unsigned)s + 3*(unsigned)sstep);
+	vt0 = _mm_setr_epi32 (t, (unsigned)t + tstep,
+			(unsigned)t + 2*(unsigned)tstep, (unsigned)t + 3*(unsigned)tstep);
+	vs1 = _mm_add_epi32 (vs0, _mm_set1_epi32 ((unsigned)sstep * 4));
+	vt1 = _mm_add_epi32 (vt0, _mm_set1_epi32 ((unsigned)tstep * 4));
+
+	vo = _mm_add_epi16 (
+			_mm_packs_epi32 (_mm_srai_epi32 (vs0, 16), _mm_srai_epi32 (vs1, 16)),
+			_mm_mullo_epi16 (
+				_mm_packs_epi32 (_mm_srai_epi32 (vt0, 16), _mm_srai_epi32 (vt1, 16)),
+				_mm_set1_epi16 ((short)width)));
+
+	pdest[0] = pbase[_mm_extract_epi16 (vo, 0)];
+	pdest[1] = pbase[_mm_extract_epi16 (vo, 1)];
+	pdest[2] = pbase[_mm_extract_epi16 (vo, 2)];
+	pdest[3] = pbase[_mm_extract_epi16 (vo, 3)];
+	pdest[4] = pbase[_mm_extract_epi16 (vo, 4)];
+	pdest[5] = pbase[_mm_extract_epi16 (vo, 5)];
+	pdest[6] = pbase[_mm_extract_epi16 (vo, 6)];
+	pdest[7] = pbase[_mm_extract_epi16 (vo, 7)];
+}
+
+#endif
+
+
+/*
+=============
+D_DrawSpans8SIMD
+
+D_DrawSpans8 with each full eight pixel run drawn by D_DrawRun8; the
+output is identical to the scalar drawer, which stays the reference
+=============
+*/
+void D_DrawSpans8SIMD (espan_t *pspan)
+{
+	int				count, spancount, width;
+	unsigned char	*pbase, *pdest;
+	fixed16_t		s, t, snext, tnext, sstep, tstep;
+	float			sdivz, tdivz, zi, z, du, dv, spancountminus1;
+	float			sdivz8stepu, tdivz8stepu, zi8stepu;
+
+	sstep = 0;	// keep compiler happy
+	tstep = 0;	// ditto
+
+	pbase = (unsigned char *)cacheblock;
+	width = cachewidth;
+
+	sdivz8stepu = d_sdivzstepu * 8;
+	tdivz8stepu = d_tdivzstepu * 8;
+	zi8stepu = d_zistepu * 8;
+
+	do
+	{
+		pdest = (unsigned char *)((byte *)d_viewbuffer +
+				(screenwidth * pspan->v) + pspan->u);
+
+		count = pspan->count;
+
+	// calculate the initial s/z, t/z, 1/z, s, and t and clamp
+		du = (float)pspan->u;
+		dv = (float)pspan->v;
+
+		sdivz = d_sdivzorigin + dv*d_sdivzstepv + du*d_sdivzstepu;
+		tdivz = d_tdivzorigin + dv*d_tdivzstepv + du*d_tdivzstepu;
+		zi = d_ziorigin + dv*d_zistepv + du*d_zistepu;
+		z = (float)0x10000 / zi;	// prescale to 16.16 fixed-point
+
+		s = (int)(sdivz * z) + sadjust;
+		if (s > bbextents)
+			s = bbextents;
+		else if (s < 0)
+			s = 0;
+
+		t = (int)(tdivz * z) + tadjust;
+		if (t > bbextentt)
+			t = bbextentt;
+		else if (t < 0)
+			t = 0;
+
+		do
+		{
+		// calculate s and t at the far end of the span
+			if (count >= 8)
+				spancount = 8;
+			else
+				spancount = count;
+
+			count -= spancount;
+
+			if (count)
+			{
+			// calculate s/z, t/z, zi->fixed s and t at far end of span,
+			// calculate s and t steps across span by shifting
+				sdivz += sdivz8stepu;
+				tdivz += tdivz8stepu;
+				zi += zi8stepu;
+				z = (float)0x10000 / zi;	// prescale to 16.16 fixed-point
+
+				snext = (int)(sdivz * z) + sadjust;
+				if (snext > bbextents)
+					snext = bbextents;
+				else if (snext < 8)
+					snext = 8;	// prevent round-off error on <0 steps from
+								//  from causing overstepping & running off the
+								//  edge of the texture
+
+				tnext = (int)(tdivz * z) + tadjust;
+				if (tnext > bbextentt)
+					tnext = bbextentt;
+				else if (tnext < 8)
+					tnext = 8;	// guard against round-off error on <0 steps
+
+				sstep = (snext - s) >> 3;
+				tstep = (tnext - t) >> 3;
+			}
+			else
+			{
+			// calculate s/z, t/z, zi->fixed s and t at last pixel in span (so
+			// can't step off polygon), clamp, calculate s and t steps across
+			// span by division, biasing steps low so we don't run off the
+			// texture
+				spancountminus1 = (float)(spancount - 1);
+				sdivz += d_sdivzstepu * spancountminus1;
+				tdivz += d_tdivzstepu * spancountminus1;
+				zi += d_zistepu * spancountminus1;
+				z = (float)0x10000 / zi;	// prescale to 16.16 fixed-point
+				snext = (int)(sdivz * z) + sadjust;
+				if (snext > bbextents)
+					snext = bbextents;
+				else if (snext < 8)
+					snext = 8;	// prevent round-off error on <0 steps from
+								//  from causing overstepping & running off the
+								//  edge of the texture
+
+				tnext = (int)(tdivz * z) + tadjust;
+				if (tnext > bbextentt)
+					tnext = bbextentt;
+				else if (tnext < 8)
+					tnext = 8;	// guard against round-off error on <0 steps
+
+				if (spancount > 1)
+				{
+					sstep = (snext - s) / (spancount - 1);
+					tstep = (tnext - t) / (spancount - 1);
+				}
+			}
+
+			if (spancount == 8)
+			{
+				D_DrawRun8 (pdest, pbase, s, t, sstep, tstep, width);
+				pdest += 8;
+			}
+			else
+			{
+				do
+				{
+					*pdest++ = *(pbase + (s >> 16) + (t >> 16) * width);
+					s += sstep;
+					t += tstep;
+				} while (--spancount > 0);
+			}
+
+			s = snext;
+			t = tnext;
+
+		} while (count > 0);
+
+	} while ((pspan = pspan->pnext) != NULL);
+}
+
+#endif	// idSIMD
+
+
 #if	!id386
 
 /*
@@ -27,6 +27,9 @@ static int		sprite_height;
 static int		minindex, maxindex;
 static sspan_t	*sprite_spans;
 
+sspan_t		*d_spritespans;		// [vid.height + 1]
+int			d_spriteheight;
+
 #if	!id386
 
 /*
@@ -381,6 +384,49 @@ void D_SpriteCalculateGradients (void)
 }
 
 
+/*
+=====================
+D_SpriteOccluded
+
+The sprite's 1/z is a plane in screen space, so its nearest point over the
+rectangle is at one of the corners
+=====================
+*/
+static qboolean D_SpriteOccluded (int x0, int y0, int x1, int y1)
+{
+	float	zi, zimax;
+
+	zimax = d_ziorigin + x0*d_zistepu + y0*d_zistepv;
+	zi = d_ziorigin + x1*d_zistepu + y0*d_zistepv;
+	if (zi > zimax)
+		zimax = zi;
+	zi = d_ziorigin + x0*d_zistepu + y1*d_zistepv;
+	if (zi > zimax)
+		zimax = zi;
+	zi = d_ziorigin + x1*d_zistepu + y1*d_zistepv;
+	if (zi > zimax)
+		zimax = zi;
+
+	return D_Occluded (x0, y0, x1, y1, (int)(zimax * 0x8000) + 1);
+}
+
+
+/*
+=====================
+D_SpriteSizeSpans
+=====================
+*/
+void D_SpriteSizeSpans (void)
+{
+	if (d_spriteheight == vid.height)
+		return;
+
+	d_spritespans = R_ModeAlloc (d_spritespans,
+			(vid.height + 1) * sizeof(sspan_t), "sprite spans");
+	d_spriteheight = vid.height;
+}
+
+
 /*
 =====================
 D_DrawSprite
@@ -389,11 +435,12 @@ D_DrawSprite
 void D_DrawSprite (void)
 {
 	int			i, nump;
-	float		ymin, ymax;
+	float		ymin, ymax, xmin, xmax;
 	emitpoint_t	*pverts;
-	sspan_t		spans[MAXHEIGHT+1];
 
-	sprite_spans = spans;
+	sprite_spans = d_spritespans;
+	xmin = 999999.9;
+	xmax = -999999.9;
 
 // find the top and bottom vertices, and make sure there's at least one scan to
 // draw
@@ -415,6 +462,11 @@ void D_DrawSprite (void)
 			maxindex = i;
 		}
 
+		if (pverts->u < xmin)
+			xmin = pverts->u;
+		if (pverts->u > xmax)
+			xmax = pverts->u;
+
 		pverts++;
 	}
 
@@ -435,6 +487,14 @@ void D_DrawSprite (void)
 	pverts[nump] = pverts[0];
 
 	D_SpriteCalculateGradients ();
+
+	if (r_occlusion.value && D_SpriteOccluded ((int)xmin - 1, (int)ymin - 1,
+		(int)xmax + 1, (int)ymax))
+	{
+		r_occluded++;
+		return;
+	}
+
 	D_SpriteScanLeftEdge ();
 	D_SpriteScanRightEdge ();
 	D_SpriteDrawSpans (sprite_spans);
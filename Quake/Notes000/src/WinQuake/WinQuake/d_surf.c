@@ -29,8 +29,49 @@ qboolean        r_cache_thrash;         // set if surface cache is thrashing
 int                                     sc_size;
 surfcache_t                     *sc_rover, *sc_base;
 
+int                                     d_drawflush;
+qboolean                        d_cacheconflict;
+
+// with d_threads set, D_DrawSurfaces defers the surface builds of a flush
+// and runs them on the workers before any spans are drawn
+typedef struct
+{
+	drawsurf_t		drawsurf;
+	surfcache_t		*cache;
+	surfcache_t		**owner;
+	int				cost;
+	int				thread;
+} surfbuild_t;
+
+static qboolean		d_deferbuilds;
+static surfbuild_t	*d_builds;
+static int			d_numbuilds, d_maxbuilds;
+
 #define GUARDSIZE       4
 
+// the cache starts in the block the video driver hands D_InitCaches and
+// grows into malloced memory, up to d_surfcachemax, while surfaces that
+// are still on screen keep getting evicted
+#define	SC_WINDOW		32		// frames between size decisions
+#define	SC_PROBE		64		// blocks D_SCAlloc looks past to spare recent ones
+
+cvar_t	d_surfcachemax = {"d_surfcachemax", "32768", true};	// in kb, 0 keeps the driver size
+
+int				d_scframe;
+
+static byte		*sc_drvbuffer;		// from the video driver
+static int		sc_drvsize;
+static byte		*sc_heapbuffer;		// ours when grown, else NULL
+static int		sc_resizes;
+
+typedef struct
+{
+	int		hits, misses, bytesbuilt, evictions, recentevictions;
+} scstats_t;
+
+static scstats_t	sc_frame, sc_lastframe, sc_window;
+static int			sc_windowframes;
+
 
 int     D_SurfaceCacheForRes (int width, int height)
 {
@@ -76,13 +117,11 @@ void D_ClearCacheGuard (void)
 
 /*
 ================
-D_InitCaches
-
+D_SCSetBuffer
 ================
 */
-void D_InitCaches (void *buffer, int size)
+static void D_SCSetBuffer (void *buffer, int size)
 {
-
 	if (!msg_suppress_1)
 		Con_Printf ("%ik surface cache\n", size/1024);
 
@@ -93,11 +132,173 @@ void D_InitCaches (void *buffer, int size)
 	sc_base->next = NULL;
 	sc_base->owner = NULL;
 	sc_base->size = sc_size;
+	sc_base->usedflush = 0;
+	sc_base->usedframe = 0;
 	
 	D_ClearCacheGuard ();
 }
 
 
+/*
+================
+D_InitCaches
+
+================
+*/
+void D_InitCaches (void *buffer, int size)
+{
+	if (sc_heapbuffer)
+	{
+		free (sc_heapbuffer);
+		sc_heapbuffer = NULL;
+	}
+
+	sc_drvbuffer = buffer;
+	sc_drvsize = size;
+
+	D_SCSetBuffer (buffer, size);
+}
+
+
+/*
+================
+D_SCResize
+
+Flushes the cache and moves it to a block of the new size, or back into
+the driver's block when that is big enough
+================
+*/
+static void D_SCResize (int size)
+{
+	byte	*buffer;
+
+	D_FlushCaches ();
+
+	if (size <= sc_drvsize)
+	{
+		buffer = sc_drvbuffer;
+		size = sc_drvsize;
+	}
+	else
+	{
+		buffer = malloc (size);
+		if (!buffer)
+		{
+			Con_DPrintf ("D_SCResize: couldn't allocate %ik\n", size/1024);
+			return;
+		}
+	}
+
+	if (sc_heapbuffer)
+		free (sc_heapbuffer);
+	sc_heapbuffer = (buffer == sc_drvbuffer) ? NULL : buffer;
+
+	D_SCSetBuffer (buffer, size);
+	sc_resizes++;
+}
+
+
+/*
+================
+D_SCAdapt
+
+Grows the cache when blocks that were on screen a frame ago had to be
+evicted during the last window, and shrinks it when the blocks used in
+the window fill well under a quarter of it
+================
+*/
+static void D_SCAdapt (void)
+{
+	surfcache_t	*c;
+	int			working, size, limit;
+
+	limit = (int)d_surfcachemax.value * 1024;
+	if (limit <= 0 || !sc_base)
+		return;
+	if (limit < sc_drvsize)
+		limit = sc_drvsize;
+
+	working = 0;
+	for (c = sc_base ; c ; c = c->next)
+		if (c->owner && c->usedframe > d_scframe - SC_WINDOW)
+			working += c->size;
+
+	size = sc_size + GUARDSIZE;
+	if (sc_window.recentevictions)
+	{
+		if (size >= limit)
+			return;
+		size = size*3/2;
+		if (size < working*2)
+			size = working*2;
+		if (size > limit)
+			size = limit;
+	}
+	else if (sc_heapbuffer && working*4 < sc_size)
+	{
+		size = working*2;
+		if (size < sc_drvsize)
+			size = sc_drvsize;
+	}
+	else
+		return;
+
+	D_SCResize ((size + 1023) & ~1023);
+}
+
+
+/*
+================
+D_SCNewFrame
+
+Called at the start of each frame, before anything is drawn
+================
+*/
+void D_SCNewFrame (void)
+{
+	d_scframe++;
+
+	sc_lastframe = sc_frame;
+	sc_window.hits += sc_frame.hits;
+	sc_window.misses += sc_frame.misses;
+	sc_window.bytesbuilt += sc_frame.bytesbuilt;
+	sc_window.evictions += sc_frame.evictions;
+	sc_window.recentevictions += sc_frame.recentevictions;
+	memset (&sc_frame, 0, sizeof(sc_frame));
+
+	if (++sc_windowframes < SC_WINDOW)
+		return;
+
+	D_SCAdapt ();
+	memset (&sc_window, 0, sizeof(sc_window));
+	sc_windowframes = 0;
+}
+
+
+/*
+================
+D_SCStats_f
+================
+*/
+void D_SCStats_f (void)
+{
+	Con_Printf ("surface cache %ik, driver %ik, max %ik, %i resizes\n",
+			(sc_size + GUARDSIZE)/1024, sc_drvsize/1024,
+			(int)d_surfcachemax.value, sc_resizes);
+	Con_Printf ("last frame: %i hits %i misses %ik built %i evictions (%i recent)\n",
+			sc_lastframe.hits, sc_lastframe.misses,
+			sc_lastframe.bytesbuilt/1024, sc_lastframe.evictions,
+			sc_lastframe.recentevictions);
+	if (sc_windowframes)
+		Con_Printf ("last %i frames, per frame: %i hits %i misses %ik built %i evictions (%i recent)\n",
+				sc_windowframes, sc_window.hits/sc_windowframes,
+				sc_window.misses/sc_windowframes,
+				sc_window.bytesbuilt/sc_windowframes/1024,
+				sc_window.evictions/sc_windowframes,
+				sc_window.recentevictions/sc_windowframes);
+}
+
+
 /*
 ==================
 D_FlushCaches
@@ -107,6 +308,8 @@ void D_FlushCaches (void)
 {
 	surfcache_t     *c;
 	
+	D_FlushTurbulentTiles ();
+
 	if (!sc_base)
 		return;
 
@@ -120,8 +323,63 @@ void D_FlushCaches (void)
 	sc_base->next = NULL;
 	sc_base->owner = NULL;
 	sc_base->size = sc_size;
+	sc_base->usedflush = 0;
+	sc_base->usedframe = 0;
 }
 
+/*
+=================
+D_SCEvict
+=================
+*/
+static void D_SCEvict (surfcache_t *c)
+{
+	if (c->owner)
+	{
+		*c->owner = NULL;
+		sc_frame.evictions++;
+		if (c->usedframe >= d_scframe - 1)
+			sc_frame.recentevictions++;
+	}
+	if (c->usedflush == d_drawflush)
+		d_cacheconflict = true;
+}
+
+
+/*
+=================
+D_SCProbe
+
+Looks a little way past start for a run of blocks big enough for size
+that were not drawn this frame or last, so those stay cached; returns
+start when there is none
+=================
+*/
+static surfcache_t *D_SCProbe (surfcache_t *start, int size)
+{
+	surfcache_t	*c, *run;
+	int			i, runsize;
+
+	run = start;
+	runsize = 0;
+	for (c = start, i = 0 ; c && i < SC_PROBE ; c = c->next, i++)
+	{
+		if (c->owner && c->usedframe >= d_scframe - 1)
+		{
+			run = c->next;
+			runsize = 0;
+			continue;
+		}
+
+		runsize += c->size;
+		if (runsize >= size)
+			return run;
+	}
+
+	return start;
+}
+
+
 /*
 =================
 D_SCAlloc
@@ -154,11 +412,12 @@ surfcache_t     *D_SCAlloc (int width, int size)
 		}
 		sc_rover = sc_base;
 	}
+
+	sc_rover = D_SCProbe (sc_rover, size);
 		
 // colect and free surfcache_t blocks until the rover block is large enough
 	new = sc_rover;
-	if (sc_rover->owner)
-		*sc_rover->owner = NULL;
+	D_SCEvict (sc_rover);
 	
 	while (new->size < size)
 	{
@@ -166,8 +425,7 @@ surfcache_t     *D_SCAlloc (int width, int size)
 		sc_rover = sc_rover->next;
 		if (!sc_rover)
 			Sys_Error ("D_SCAlloc: hit the end of memory");
-		if (sc_rover->owner)
-			*sc_rover->owner = NULL;
+		D_SCEvict (sc_rover);
 			
 		new->size += sc_rover->size;
 		new->next = sc_rover->next;
@@ -181,6 +439,8 @@ surfcache_t     *D_SCAlloc (int width, int size)
 		sc_rover->next = new->next;
 		sc_rover->width = 0;
 		sc_rover->owner = NULL;
+		sc_rover->usedflush = 0;
+		sc_rover->usedframe = 0;
 		new->next = sc_rover;
 		new->size = size;
 	}
@@ -193,6 +453,7 @@ surfcache_t     *D_SCAlloc (int width, int size)
 		new->height = (size - sizeof(*new) + sizeof(new->data)) / width;
 
 	new->owner = NULL;              // should be set properly after return
+	new->usedflush = 0;
 
 	if (d_roverwrapped)
 	{
@@ -256,6 +517,139 @@ int D_log2 (int num)
 
 //=============================================================================
 
+/*
+================
+D_DeferSurfaceBuild
+================
+*/
+static void D_DeferSurfaceBuild (surfcache_t *cache)
+{
+	surfbuild_t	*build;
+
+	if (d_numbuilds == d_maxbuilds)
+	{
+		d_maxbuilds = d_maxbuilds*2 + 256;
+		d_builds = realloc (d_builds, d_maxbuilds * sizeof(*d_builds));
+		if (!d_builds)
+			Sys_Error ("D_DeferSurfaceBuild: couldn't allocate %i builds",
+					d_maxbuilds);
+	}
+
+	build = &d_builds[d_numbuilds++];
+	build->drawsurf = r_drawsurf;
+	build->cache = cache;
+	build->owner = cache->owner;
+// texels to light, plus the lightmap samples to combine
+	build->cost = r_drawsurf.surfwidth * r_drawsurf.surfheight +
+			((r_drawsurf.surf->extents[0]>>4)+1) *
+			((r_drawsurf.surf->extents[1]>>4)+1) * 4;
+}
+
+
+/*
+================
+D_BeginSurfaceBuilds
+
+Until D_EndSurfaceBuilds or D_CancelSurfaceBuilds, D_CacheSurface sets up
+the cache blocks but leaves the texels unbuilt
+================
+*/
+void D_BeginSurfaceBuilds (void)
+{
+	d_numbuilds = 0;
+	d_deferbuilds = true;
+}
+
+
+/*
+================
+D_BuildSurfaces
+
+Worker for D_RunThreads
+================
+*/
+static void D_BuildSurfaces (int thread, int numthreads)
+{
+	surfbuild_t	*build;
+	int			i;
+
+	for (i=0, build=d_builds ; i<d_numbuilds ; i++, build++)
+	{
+		if (build->thread != thread)
+			continue;
+
+		r_drawsurf = build->drawsurf;
+		R_DrawSurface ();
+	}
+}
+
+
+/*
+================
+D_EndSurfaceBuilds
+
+Builds the deferred surfaces across the d_threads workers, each surface
+going to the least loaded thread
+================
+*/
+void D_EndSurfaceBuilds (void)
+{
+	surfbuild_t	*build;
+	int			i, j, best, numthreads;
+	int			load[MAX_DTHREADS];
+	double		prof_start;
+
+	d_deferbuilds = false;
+	if (!d_numbuilds)
+		return;
+
+	prof_start = Prof_Begin ();
+
+	numthreads = D_NumThreads ();
+	for (j=0 ; j<numthreads ; j++)
+		load[j] = 0;
+
+	for (i=0, build=d_builds ; i<d_numbuilds ; i++, build++)
+	{
+		best = 0;
+		for (j=1 ; j<numthreads ; j++)
+			if (load[j] < load[best])
+				best = j;
+		build->thread = best;
+		load[best] += build->cost;
+	}
+
+	D_RunThreads (D_BuildSurfaces);
+
+	Prof_End (PROF_SURFBUILD, prof_start);
+}
+
+
+/*
+================
+D_CancelSurfaceBuilds
+
+Drops the deferred builds, marking their blocks stale so the next
+D_CacheSurface on each surface builds it again
+================
+*/
+void D_CancelSurfaceBuilds (void)
+{
+	surfbuild_t	*build;
+	int			i;
+
+	d_deferbuilds = false;
+
+	for (i=0, build=d_builds ; i<d_numbuilds ; i++, build++)
+	{
+	// a block freed since then no longer belongs to the surface
+		if (*build->owner == build->cache)
+			build->cache->texture = NULL;
+	}
+	d_numbuilds = 0;
+}
+
+
 /*
 ================
 D_CacheSurface
@@ -264,6 +658,7 @@ D_CacheSurface
 surfcache_t *D_CacheSurface (msurface_t *surface, int miplevel)
 {
 	surfcache_t     *cache;
+	double			prof_start;
 
 //
 // if the surface is animating or flashing, flush the cache
@@ -285,7 +680,12 @@ surfcache_t *D_CacheSurface (msurface_t *surface, int miplevel)
 			&& cache->lightadj[1] == r_drawsurf.lightadj[1]
 			&& cache->lightadj[2] == r_drawsurf.lightadj[2]
 			&& cache->lightadj[3] == r_drawsurf.lightadj[3] )
+	{
+		cache->usedflush = d_drawflush;
+		cache->usedframe = d_scframe;
+		sc_frame.hits++;
 		return cache;
+	}
 
 //
 // determine shape of surface
@@ -307,6 +707,12 @@ surfcache_t *D_CacheSurface (msurface_t *surface, int miplevel)
 		cache->owner = &surface->cachespots[miplevel];
 		cache->mipscale = surfscale;
 	}
+	else if (cache->usedflush == d_drawflush)
+		d_cacheconflict = true;		// rebuilding a block already handed out
+	cache->usedflush = d_drawflush;
+	cache->usedframe = d_scframe;
+	sc_frame.misses++;
+	sc_frame.bytesbuilt += r_drawsurf.surfwidth * r_drawsurf.surfheight;
 	
 	if (surface->dlightframe == r_framecount)
 		cache->dlight = 1;
@@ -326,8 +732,21 @@ surfcache_t *D_CacheSurface (msurface_t *surface, int miplevel)
 //
 	r_drawsurf.surf = surface;
 
+// a surface can be built at two miplevels in one flush, but only the first
+// build may touch its static light, in case they run on different threads
+	r_drawsurf.cachelight = (surface->lightflush != d_drawflush);
+	surface->lightflush = d_drawflush;
+
 	c_surf++;
-	R_DrawSurface ();
+	c_surftexels += r_drawsurf.surfwidth * r_drawsurf.surfheight;
+	if (d_deferbuilds)
+		D_DeferSurfaceBuild (cache);
+	else
+	{
+		prof_start = Prof_Begin ();
+		R_DrawSurface ();
+		Prof_End (PROF_SURFCACHE, prof_start);
+	}
 
 	return surface->cachespots[miplevel];
 }
@@ -0,0 +1,165 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// d_thread.c: rasterizer worker threads
+
+#include <stdint.h>
+
+#include "quakedef.h"
+#include "d_local.h"
+
+cvar_t	d_threads = {"d_threads", "0", true};	// 0 or 1 rasterizes on the main thread only
+
+static int		d_numthreads = 1;				// including the main thread
+static void		*d_workers[MAX_DTHREADS];
+static void		*d_gosem[MAX_DTHREADS];
+static void		*d_donesem;
+static qboolean	d_workerquit;
+
+static void		(*d_threadfunc) (int thread, int numthreads);
+
+
+/*
+===============
+D_WorkerThread
+
+Runs d_threadfunc each time the main thread posts this worker's semaphore
+===============
+*/
+static void D_WorkerThread (void *arg)
+{
+	int		thread;
+
+	thread = (int)(intptr_t)arg;
+
+	while (1)
+	{
+		Sys_WaitSemaphore (d_gosem[thread]);
+		if (d_workerquit)
+			break;
+		d_threadfunc (thread, d_numthreads);
+		Sys_PostSemaphore (d_donesem);
+	}
+}
+
+
+/*
+===============
+D_StopThreads
+===============
+*/
+static void D_StopThreads (void)
+{
+	int		i;
+
+	d_workerquit = true;
+	for (i=1 ; i<d_numthreads ; i++)
+		Sys_PostSemaphore (d_gosem[i]);
+	for (i=1 ; i<d_numthreads ; i++)
+	{
+		Sys_WaitThread (d_workers[i]);
+		d_workers[i] = NULL;
+	}
+	d_workerquit = false;
+	d_numthreads = 1;
+}
+
+
+/*
+===============
+D_InitThreads
+===============
+*/
+void D_InitThreads (void)
+{
+	int		i;
+
+	Cvar_RegisterVariable (&d_threads);
+
+	d_donesem = Sys_CreateSemaphore (0);
+	for (i=1 ; i<MAX_DTHREADS ; i++)
+		d_gosem[i] = Sys_CreateSemaphore (0);
+}
+
+
+/*
+===============
+D_SetupThreads
+
+Starts or stops workers when d_threads has changed; called between frames,
+when no work is outstanding
+===============
+*/
+void D_SetupThreads (void)
+{
+	int		i, want;
+
+	want = (int)d_threads.value;
+	if (want < 1)
+		want = 1;
+	else if (want > MAX_DTHREADS)
+		want = MAX_DTHREADS;
+
+	if (want == d_numthreads)
+		return;
+
+	D_StopThreads ();
+
+	for (i=1 ; i<want ; i++)
+		d_workers[i] = Sys_CreateThread (D_WorkerThread, (void *)(intptr_t)i);
+	d_numthreads = want;
+}
+
+
+/*
+===============
+D_NumThreads
+===============
+*/
+int D_NumThreads (void)
+{
+	return d_numthreads;
+}
+
+
+/*
+===============
+D_RunThreads
+===============
+*/
+void D_RunThreads (void (*func) (int thread, int numthreads))
+{
+	int		i;
+
+	if (d_numthreads == 1)
+	{
+		func (0, 1);
+		return;
+	}
+
+	d_threadfunc = func;
+	for (i=1 ; i<d_numthreads ; i++)
+		Sys_PostSemaphore (d_gosem[i]);
+
+	func (0, d_numthreads);
+
+	for (i=1 ; i<d_numthreads ; i++)
+		Sys_WaitSemaphore (d_donesem);
+}
+
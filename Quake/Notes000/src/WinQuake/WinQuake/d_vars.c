@@ -33,14 +33,16 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // FIXME: make into one big structure, like cl or sv
 // FIXME: do separately for refresh engine and driver
 
-float	d_sdivzstepu, d_tdivzstepu, d_zistepu;
-float	d_sdivzstepv, d_tdivzstepv, d_zistepv;
-float	d_sdivzorigin, d_tdivzorigin, d_ziorigin;
+// the span drawers run on several threads at once, so the per-surface
+// gradients they read are kept per thread
+THREADLOCAL float	d_sdivzstepu, d_tdivzstepu, d_zistepu;
+THREADLOCAL float	d_sdivzstepv, d_tdivzstepv, d_zistepv;
+THREADLOCAL float	d_sdivzorigin, d_tdivzorigin, d_ziorigin;
 
-fixed16_t	sadjust, tadjust, bbextents, bbextentt;
+THREADLOCAL fixed16_t	sadjust, tadjust, bbextents, bbextentt;
 
-pixel_t			*cacheblock;
-int				cachewidth;
+THREADLOCAL pixel_t		*cacheblock;
+THREADLOCAL int			cachewidth;
 pixel_t			*d_viewbuffer;
 short			*d_pzbuffer;
 unsigned int	d_zrowbytes;
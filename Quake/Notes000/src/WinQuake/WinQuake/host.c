@@ -36,6 +36,8 @@ Memory is cleared / released when a server or client begins, not when they end.
 quakeparms_t host_parms;
 
 qboolean	host_initialized;		// true if into command execution
+qboolean	host_headless;			// set by the system layer before Host_Init
+int			host_exitcode;			// benchmark sets it for a test script
 
 double		host_frametime;
 double		host_time;
@@ -51,6 +53,9 @@ client_t	*host_client;			// current client
 
 jmp_buf 	host_abortserver;
 
+jmp_buf 	host_svthread_abort;		// Host_Error on the server thread
+char		host_svthread_error[1024];	// rethrown by the main thread
+
 byte		*host_basepal;
 byte		*host_colormap;
 
@@ -58,6 +63,8 @@ cvar_t	host_framerate = {"host_framerate","0"};	// set for slow motion
 cvar_t	host_speeds = {"host_speeds","0"};			// set for running times
 
 cvar_t	sys_ticrate = {"sys_ticrate","0.05"};
+cvar_t	sv_thread = {"sv_thread","0"};				// run the server on its own thread
+cvar_t	sv_tickrate = {"sv_tickrate","72"};			// server thread ticks per second
 cvar_t	serverprofile = {"serverprofile","0"};
 
 cvar_t	fraglimit = {"fraglimit","0",false,true};
@@ -81,6 +88,8 @@ cvar_t	pausable = {"pausable","1"};
 
 cvar_t	temp1 = {"temp1","0"};
 
+void Host_TickStats_f (void);
+
 
 /*
 ================
@@ -123,6 +132,14 @@ void Host_Error (char *error, ...)
 	va_list		argptr;
 	char		string[1024];
 	static	qboolean inerror = false;
+
+	if (!Sys_IsMainThread ())
+	{	// the main thread owns the client, so leave the shutdown to it
+		va_start (argptr,error);
+		vsprintf (host_svthread_error,error,argptr);
+		va_end (argptr);
+		longjmp (host_svthread_abort, 1);
+	}
 	
 	if (inerror)
 		Sys_Error ("Host_Error: recursively entered");
@@ -214,8 +231,12 @@ void Host_InitLocal (void)
 	Cvar_RegisterVariable (&host_speeds);
 
 	Cvar_RegisterVariable (&sys_ticrate);
+	Cvar_RegisterVariable (&sv_thread);
+	Cvar_RegisterVariable (&sv_tickrate);
 	Cvar_RegisterVariable (&serverprofile);
 
+	Cmd_AddCommand ("sv_tickstats", Host_TickStats_f);
+
 	Cvar_RegisterVariable (&fraglimit);
 	Cvar_RegisterVariable (&timelimit);
 	Cvar_RegisterVariable (&teamplay);
@@ -554,7 +575,7 @@ Host_ServerFrame
 void _Host_ServerFrame (void)
 {
 // run the world state	
-	pr_global_struct->frametime = host_frametime;
+	pr_global_struct->frametime = sv_frametime;
 
 // read client messages
 	SV_RunClients ();
@@ -565,13 +586,16 @@ void _Host_ServerFrame (void)
 		SV_Physics ();
 }
 
-void Host_ServerFrame (void)
+void Host_ServerFrame (double frametime)
 {
-	float	save_host_frametime;
-	float	temp_host_frametime;
+	float	temp_frametime;
+	double	prof_start;
+
+	prof_start = Prof_Begin ();
 
 // run the world state	
-	pr_global_struct->frametime = host_frametime;
+	sv_frametime = frametime;
+	pr_global_struct->frametime = sv_frametime;
 
 // set the time and clear the general datagram
 	SV_ClearDatagram ();
@@ -579,28 +603,37 @@ void Host_ServerFrame (void)
 // check for new clients
 	SV_CheckForNewClients ();
 
-	temp_host_frametime = save_host_frametime = host_frametime;
-	while(temp_host_frametime > (1.0/72.0))
+	temp_frametime = frametime;
+	while(temp_frametime > (1.0/72.0))
 	{
-		if (temp_host_frametime > 0.05)
-			host_frametime = 0.05;
+		if (temp_frametime > 0.05)
+			sv_frametime = 0.05;
 		else
-			host_frametime = temp_host_frametime;
-		temp_host_frametime -= host_frametime;
+			sv_frametime = temp_frametime;
+		temp_frametime -= sv_frametime;
 		_Host_ServerFrame ();
 	}
-	host_frametime = save_host_frametime;
+	sv_frametime = frametime;
 
 // send all messages to the clients
 	SV_SendClientMessages ();
+	NET_Flush ();
+
+	Prof_End (PROF_SERVERFRAME, prof_start);
+	Prof_Drain ();
 }
 
 #else
 
-void Host_ServerFrame (void)
+void Host_ServerFrame (double frametime)
 {
+	double	prof_start;
+
+	prof_start = Prof_Begin ();
+
 // run the world state	
-	pr_global_struct->frametime = host_frametime;
+	sv_frametime = frametime;
+	pr_global_struct->frametime = sv_frametime;
 
 // set the time and clear the general datagram
 	SV_ClearDatagram ();
@@ -618,11 +651,224 @@ void Host_ServerFrame (void)
 
 // send all messages to the clients
 	SV_SendClientMessages ();
+	NET_Flush ();
+
+	Prof_End (PROF_SERVERFRAME, prof_start);
+	Prof_Drain ();
 }
 
 #endif
 
 
+/*
+===============================================================================
+
+SERVER THREAD
+
+With sv_thread set the server runs on its own thread at a fixed sv_tickrate
+instead of once per client frame.  The main thread holds host_lock for
+everything except drawing, sound mixing and cd audio, so the only overlap is
+the server ticking while the client renders, and the two sides only pass
+messages through the loopback driver.
+
+===============================================================================
+*/
+
+typedef struct
+{
+	int		ticks;
+	int		intervals;
+	int		resyncs;
+	double	interval_sum, interval_sqsum;
+	double	interval_min, interval_max;
+	double	late_max;
+	double	frame_sum, frame_max;
+	double	wait_sum, wait_max;
+} tickstats_t;
+
+static void				*host_lock;
+static qboolean			host_locked;		// the main thread holds host_lock
+static void				*host_svthread;
+static volatile qboolean	host_svthread_quit;
+static tickstats_t		host_tickstats;		// only touched with host_lock held
+
+static double Host_TickLength (void)
+{
+	if (sv_tickrate.value < 10)
+		return 1.0 / 10;
+	if (sv_tickrate.value > 1000)
+		return 1.0 / 1000;
+	return 1.0 / sv_tickrate.value;
+}
+
+static void Host_LockServer (void)
+{
+	if (!host_svthread || host_locked)
+		return;
+	Sys_LockMutex (host_lock);
+	host_locked = true;
+}
+
+static void Host_UnlockServer (void)
+{
+	if (!host_locked)
+		return;
+	host_locked = false;
+	Sys_UnlockMutex (host_lock);
+}
+
+/*
+==================
+Host_ServerTick
+
+Runs one fixed length server frame with host_lock held.  host_frametime
+belongs to the client, which reads it while drawing without the lock
+==================
+*/
+static void Host_ServerTick (double tick)
+{
+	if (!setjmp (host_svthread_abort))
+		Host_ServerFrame (tick);
+}
+
+static void Host_ServerThread (void *arg)
+{
+	tickstats_t	*s = &host_tickstats;
+	double		tick, next, start, locked, done, last;
+
+	tick = Host_TickLength ();
+	next = Sys_FloatTime () + tick;
+	last = 0;
+
+	while (!host_svthread_quit)
+	{
+		Sys_ThreadSleep (next - Sys_FloatTime ());
+		start = Sys_FloatTime ();
+
+		Sys_LockMutex (host_lock);
+		locked = Sys_FloatTime ();
+
+		if (sv.active && !host_svthread_error[0])
+			Host_ServerTick (tick);
+		done = Sys_FloatTime ();
+
+		s->ticks++;
+		if (last)
+		{
+			s->intervals++;
+			s->interval_sum += start - last;
+			s->interval_sqsum += (start - last) * (start - last);
+			if (s->intervals == 1 || start - last < s->interval_min)
+				s->interval_min = start - last;
+			if (start - last > s->interval_max)
+				s->interval_max = start - last;
+		}
+		if (start - next > s->late_max)
+			s->late_max = start - next;
+		s->frame_sum += done - locked;
+		if (done - locked > s->frame_max)
+			s->frame_max = done - locked;
+		s->wait_sum += locked - start;
+		if (locked - start > s->wait_max)
+			s->wait_max = locked - start;
+		last = start;
+
+		tick = Host_TickLength ();
+		next += tick;
+		if (done - next > 0.25)
+		{	// fell a long way behind, probably a level load, so don't
+			// try to catch up with a burst of ticks
+			next = done + tick;
+			last = 0;
+			s->resyncs++;
+		}
+
+		Sys_UnlockMutex (host_lock);
+	}
+}
+
+/*
+==================
+Host_StopServerThread
+==================
+*/
+void Host_StopServerThread (void)
+{
+	if (!host_svthread || !Sys_IsMainThread ())
+		return;
+
+	host_svthread_quit = true;
+	Host_UnlockServer ();		// it may be waiting for the lock
+	Sys_WaitThread (host_svthread);
+	host_svthread = NULL;
+}
+
+/*
+==================
+Host_CheckServerThread
+
+Starts or stops the server thread to match sv_thread
+==================
+*/
+static void Host_CheckServerThread (void)
+{
+	if (!sv_thread.value)
+	{
+		Host_StopServerThread ();
+		return;
+	}
+	if (host_svthread)
+		return;
+
+	if (!host_lock)
+		host_lock = Sys_CreateMutex ();
+	memset (&host_tickstats, 0, sizeof(host_tickstats));
+	host_svthread_quit = false;
+	host_svthread = Sys_CreateThread (Host_ServerThread, NULL);
+}
+
+/*
+==================
+Host_TickStats_f
+
+sv_tickstats [reset]
+==================
+*/
+void Host_TickStats_f (void)
+{
+	tickstats_t	*s = &host_tickstats;
+	double		mean, jitter;
+
+	if (Cmd_Argc () > 1 && !Q_strcmp (Cmd_Argv (1), "reset"))
+	{
+		memset (s, 0, sizeof(*s));
+		return;
+	}
+
+	if (!host_svthread)
+		Con_Printf ("server thread is not running (sv_thread 0)\n");
+	if (!s->intervals)
+	{
+		Con_Printf ("no server ticks recorded\n");
+		return;
+	}
+
+	mean = s->interval_sum / s->intervals;
+	jitter = s->interval_sqsum / s->intervals - mean * mean;
+	jitter = jitter > 0 ? sqrt (jitter) : 0;
+
+	Con_Printf ("%i ticks, target %.3f ms (%g hz), %i resyncs\n",
+		s->ticks, Host_TickLength () * 1000, 1.0 / Host_TickLength (), s->resyncs);
+	Con_Printf ("interval: mean %.3f  jitter %.3f  min %.3f  max %.3f ms\n",
+		mean * 1000, jitter * 1000, s->interval_min * 1000, s->interval_max * 1000);
+	Con_Printf ("late:     max %.3f ms\n", s->late_max * 1000);
+	Con_Printf ("frame:    mean %.3f  max %.3f ms\n",
+		s->frame_sum / s->ticks * 1000, s->frame_max * 1000);
+	Con_Printf ("lock:     mean %.3f  max %.3f ms waiting\n",
+		s->wait_sum / s->ticks * 1000, s->wait_max * 1000);
+}
+
+
 /*
 ==================
 Host_Frame
@@ -636,16 +882,38 @@ void _Host_Frame (float time)
 	static double		time2 = 0;
 	static double		time3 = 0;
 	int			pass1, pass2, pass3;
+	double		svstart, svtime, rstart, rtime;
+	char		error[sizeof(host_svthread_error)];
 
 	if (setjmp (host_abortserver) )
+	{
+		Host_UnlockServer ();
 		return;			// something bad happened, or the server disconnected
+	}
 
 // keep the random time dependent
 	rand ();
-	
+
+	Host_CheckServerThread ();
+	Host_LockServer ();
+
 // decide the simulation time
 	if (!Host_FilterTime (time))
+	{
+		Host_UnlockServer ();
 		return;			// don't run too fast, or packets will flood out
+	}
+
+// print what the server thread had to say
+	Con_FlushQueue ();
+
+// the server thread hit a Host_Error
+	if (host_svthread_error[0])
+	{
+		Q_strcpy (error, host_svthread_error);
+		host_svthread_error[0] = 0;
+		Host_Error ("%s", error);
+	}
 		
 // get new key events
 	Sys_SendKeyEvents ();
@@ -671,8 +939,13 @@ void _Host_Frame (float time)
 // check for commands typed to the host
 	Host_GetConsoleCommands ();
 	
-	if (sv.active)
-		Host_ServerFrame ();
+	svtime = 0;
+	if (sv.active && !host_svthread)
+	{
+		svstart = Sys_FloatTime ();
+		Host_ServerFrame (host_frametime);
+		svtime = Sys_FloatTime () - svstart;
+	}
 
 //-------------------
 //
@@ -693,11 +966,19 @@ void _Host_Frame (float time)
 		CL_ReadFromServer ();
 	}
 
+	Prof_Drain ();
+	Prof_Frame ();
+
+// the server thread can run while we draw
+	Host_UnlockServer ();
+
 // update video
 	if (host_speeds.value)
 		time1 = Sys_FloatTime ();
 		
+	rstart = Sys_FloatTime ();
 	SCR_UpdateScreen ();
+	rtime = Sys_FloatTime () - rstart;
 
 	if (host_speeds.value)
 		time2 = Sys_FloatTime ();
@@ -722,6 +1003,8 @@ void _Host_Frame (float time)
 		Con_Printf ("%3i tot %3i server %3i gfx %3i snd\n",
 					pass1+pass2+pass3, pass1, pass2, pass3);
 	}
+
+	CL_BenchmarkFrame (svtime, rtime);
 	
 	host_framecount++;
 }
@@ -859,6 +1142,7 @@ void Host_Init (quakeparms_t *parms)
 	Host_InitVCR (parms);
 	COM_Init (parms->basedir);
 	Host_InitLocal ();
+	Prof_Init ();
 	W_LoadWadFile ("gfx.wad");
 	Key_Init ();
 	Con_Init ();	
@@ -940,6 +1224,8 @@ void Host_Shutdown(void)
 	}
 	isdown = true;
 
+	Host_StopServerThread ();
+
 // keep Con_Printf from trying to update the screen
 	scr_disabled_for_loading = true;
 
@@ -36,7 +36,7 @@ extern void M_Menu_Quit_f (void);
 
 void Host_Quit_f (void)
 {
-	if (key_dest != key_console && cls.state != ca_dedicated)
+	if (key_dest != key_console && cls.state != ca_dedicated && !host_headless)
 	{
 		M_Menu_Quit_f ();
 		return;
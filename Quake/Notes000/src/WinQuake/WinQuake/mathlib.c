@@ -561,6 +561,21 @@ int GreatestCommonDivisor (int i1, int i2)
 }
 
 
+/*
+===================
+CompareFloats
+
+Ascending order of floats, for qsort
+====================
+*/
+int CompareFloats (const void *a, const void *b)
+{
+	if (*(float *)a < *(float *)b)
+		return -1;
+	return *(float *)a > *(float *)b;
+}
+
+
 #if	!id386
 
 // TODO: move to nonintel.c
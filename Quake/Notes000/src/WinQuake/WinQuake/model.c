@@ -112,9 +112,8 @@ mleaf_t *Mod_PointInLeaf (vec3_t p, model_t *model)
 Mod_DecompressVis
 ===================
 */
-byte *Mod_DecompressVis (byte *in, model_t *model)
+static byte *Mod_DecompressVis (byte *in, model_t *model, byte *decompressed)
 {
-	static byte	decompressed[MAX_MAP_LEAFS/8];
 	int		c;
 	byte	*out;
 	int		row;
@@ -154,9 +153,26 @@ byte *Mod_DecompressVis (byte *in, model_t *model)
 
 byte *Mod_LeafPVS (mleaf_t *leaf, model_t *model)
 {
+	static byte	decompressed[MAX_MAP_LEAFS/8];
+
 	if (leaf == model->leafs)
 		return mod_novis;
-	return Mod_DecompressVis (leaf->compressed_vis, model);
+	return Mod_DecompressVis (leaf->compressed_vis, model, decompressed);
+}
+
+/*
+==================
+Mod_LeafPVSBuffer
+
+Like Mod_LeafPVS, but always fills in the caller's buffer, so the server
+thread and the renderer aren't decompressing into the same place
+==================
+*/
+byte *Mod_LeafPVSBuffer (mleaf_t *leaf, model_t *model, byte *buffer)
+{
+	if (leaf == model->leafs)
+		return Mod_DecompressVis (NULL, model, buffer);
+	return Mod_DecompressVis (leaf->compressed_vis, model, buffer);
 }
 
 /*
@@ -824,6 +840,10 @@ void Mod_LoadFaces (lump_t *l)
 			}
 			continue;
 		}
+
+		if (out->samples)
+			out->staticlight = Hunk_AllocName (((out->extents[0]>>4)+1) *
+					((out->extents[1]>>4)+1) * sizeof(unsigned), loadname);
 	}
 }
 
@@ -930,6 +950,7 @@ void Mod_LoadLeafs (lump_t *l)
 		else
 			out->compressed_vis = loadmodel->visdata + p;
 		out->efrags = NULL;
+		out->numefrags = 0;
 		
 		for (j=0 ; j<4 ; j++)
 			out->ambient_sound_level[j] = in->ambient_level[j];
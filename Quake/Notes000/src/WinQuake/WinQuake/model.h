@@ -123,6 +123,13 @@ typedef struct msurface_s
 // lighting info
 	byte		styles[MAXLIGHTMAPS];
 	byte		*samples;		// [numstyles*surfsize]
+
+// ambient plus styled lightmaps, kept between surface cache rebuilds
+	unsigned	*staticlight;	// [surfsize], NULL if unlit
+	int			staticlightadj[MAXLIGHTMAPS];	// styles it was summed with
+	int			staticambient;
+	qboolean	staticvalid;
+	int			lightflush;		// d_drawflush of the build allowed to use it
 } msurface_t;
 
 typedef struct mnode_s
@@ -157,7 +164,8 @@ typedef struct mleaf_s
 
 // leaf specific
 	byte		*compressed_vis;
-	efrag_t		*efrags;
+	struct entity_s	**efrags;	// entities touching the leaf, in r_efragents
+	int			numefrags;
 
 	msurface_t	**firstmarksurface;
 	int			nummarksurfaces;
@@ -378,5 +386,6 @@ void	Mod_TouchModel (char *name);
 
 mleaf_t *Mod_PointInLeaf (float *p, model_t *model);
 byte	*Mod_LeafPVS (mleaf_t *leaf, model_t *model);
+byte	*Mod_LeafPVSBuffer (mleaf_t *leaf, model_t *model, byte *buffer);
 
 #endif	// __MODEL__
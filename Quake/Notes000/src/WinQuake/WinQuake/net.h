@@ -119,6 +119,8 @@ struct qsockaddr
 typedef struct qsocket_s
 {
 	struct qsocket_s	*next;
+	struct qsocket_s	*hashnext;
+	int				hashbucket;		// -1 if not in the address hash
 	double			connecttime;
 	double			lastMessageTime;
 	double			lastSendTime;
@@ -175,6 +177,9 @@ typedef struct
 	int			(*AddrCompare) (struct qsockaddr *addr1, struct qsockaddr *addr2);
 	int			(*GetSocketPort) (struct qsockaddr *addr);
 	int			(*SetSocketPort) (struct qsockaddr *addr, int port);
+	void		(*Flush) (void);		// optional, for drivers that batch their sends
+	unsigned	(*HostHash) (struct qsockaddr *addr);	// optional, the host part
+										// AddrCompare looks at, port excluded
 } net_landriver_t;
 
 #define	MAX_NET_DRIVERS		8
@@ -218,6 +223,8 @@ extern int		unreliableMessagesReceived;
 
 qsocket_t *NET_NewQSocket (void);
 void NET_FreeQSocket(qsocket_t *);
+void NET_HashQSocket (qsocket_t *sock);
+qsocket_t *NET_FindQSocket (int driver, int landriver, struct qsockaddr *addr);
 double SetNetTime(void);
 
 
@@ -309,6 +316,10 @@ void		NET_Close (struct qsocket_s *sock);
 
 void NET_Poll(void);
 
+void NET_Flush (void);
+// Pushes out any datagrams the lan drivers are holding back to send in a
+// batch.  Called once the server has sent its messages for the frame.
+
 
 typedef struct _PollProcedure
 {
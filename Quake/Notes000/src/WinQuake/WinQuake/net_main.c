@@ -99,6 +99,194 @@ double SetNetTime(void)
 }
 
 
+/*
+=============================================================================
+
+Connected qsockets are hashed on the host part of their remote address, so
+the datagram driver can find the owner of an incoming packet without walking
+net_activeSockets.  Every connection from one host shares a chain.
+
+=============================================================================
+*/
+
+#define	NET_HASHSIZE	1024		// must be a power of two
+
+static qsocket_t	*net_hash[NET_HASHSIZE];
+
+static int NET_HashAddr (int landriver, struct qsockaddr *addr)
+{
+	unsigned	h, k;
+	int			i;
+
+// only what AddrCompare checks can go in, the rest of a qsockaddr is padding
+// that two equal addresses needn't share
+	k = addr->sa_family;
+	if (net_landrivers[landriver].HostHash)
+		k ^= net_landrivers[landriver].HostHash (addr);
+
+	h = 2166136261u;
+	for (i = 0; i < 4; i++, k >>= 8)
+		h = (h ^ (k & 255)) * 16777619;
+	return h & (NET_HASHSIZE - 1);
+}
+
+static void NET_HashInsert (qsocket_t **table, qsocket_t *sock)
+{
+	sock->hashbucket = NET_HashAddr (sock->landriver, &sock->addr);
+	sock->hashnext = table[sock->hashbucket];
+	table[sock->hashbucket] = sock;
+}
+
+static void NET_HashRemove (qsocket_t **table, qsocket_t *sock)
+{
+	qsocket_t	**link;
+
+	if (sock->hashbucket == -1)
+		return;
+
+	for (link = &table[sock->hashbucket]; *link; link = &(*link)->hashnext)
+		if (*link == sock)
+		{
+			*link = sock->hashnext;
+			break;
+		}
+	sock->hashnext = NULL;
+	sock->hashbucket = -1;
+}
+
+static qsocket_t *NET_HashFind (qsocket_t **table, int driver, int landriver, struct qsockaddr *addr)
+{
+	qsocket_t	*s;
+	qsocket_t	*samehost;
+	int			ret;
+
+	samehost = NULL;
+	for (s = table[NET_HashAddr (landriver, addr)]; s; s = s->hashnext)
+	{
+		if (s->driver != driver || s->landriver != landriver)
+			continue;
+		ret = net_landrivers[landriver].AddrCompare (addr, &s->addr);
+		if (ret == 0)
+			return s;
+		if (ret > 0 && !samehost)
+			samehost = s;
+	}
+	return samehost;
+}
+
+/*
+===================
+NET_HashQSocket
+
+Called by drivers once sock->addr and sock->landriver have been filled in
+===================
+*/
+void NET_HashQSocket (qsocket_t *sock)
+{
+	NET_HashRemove (net_hash, sock);
+	NET_HashInsert (net_hash, sock);
+}
+
+/*
+===================
+NET_FindQSocket
+
+Returns the connection with exactly this address, or failing that one from
+the same host on another port, or NULL
+===================
+*/
+qsocket_t *NET_FindQSocket (int driver, int landriver, struct qsockaddr *addr)
+{
+	return NET_HashFind (net_hash, driver, landriver, addr);
+}
+
+/*
+===================
+NET_HashBench_f
+
+Times finding the owner of an address among thousands of fake connections,
+both by walking a list the way the datagram driver used to and through the
+address hash
+===================
+*/
+static void NET_HashBench_f (void)
+{
+	int			i, n, h, lookups;
+	int			walkhits, hashhits;
+	qsocket_t	*socks, *list, *s;
+	qsocket_t	**table;
+	struct qsockaddr	*addr;
+	double		start, walktime, hashtime;
+
+	if (!net_landrivers[0].initialized)
+	{
+		Con_Printf ("net_hashbench needs TCP/IP\n");
+		return;
+	}
+
+	n = 4096;
+	if (Cmd_Argc () > 1)
+		n = Q_atoi (Cmd_Argv (1));
+	if (n < 1)
+		n = 1;
+	lookups = 10000;
+
+	socks = calloc (n, sizeof(qsocket_t));
+	table = calloc (NET_HASHSIZE, sizeof(qsocket_t *));
+	if (!socks || !table)
+	{
+		Con_Printf ("net_hashbench: not enough memory for %i connections\n", n);
+		free (socks);
+		free (table);
+		return;
+	}
+
+	// a few connections to a host, like players behind a shared address
+	list = NULL;
+	for (i = 0; i < n; i++)
+	{
+		s = &socks[i];
+		h = i >> 2;
+		s->driver = 1;
+		s->landriver = 0;
+		net_landrivers[0].StringToAddr (va("10.%i.%i.%i:%i", (h >> 16) & 255, (h >> 8) & 255, h & 255, 27000 + (i & 3)), &s->addr);
+		s->next = list;
+		list = s;
+		NET_HashInsert (table, s);
+	}
+
+	walkhits = 0;
+	start = Sys_FloatTime ();
+	for (i = 0; i < lookups; i++)
+	{
+		addr = &socks[(i * 7919) % n].addr;
+		for (s = list; s; s = s->next)
+			if (net_landrivers[0].AddrCompare (addr, &s->addr) == 0)
+				break;
+		if (s)
+			walkhits++;
+	}
+	walktime = Sys_FloatTime () - start;
+
+	hashhits = 0;
+	start = Sys_FloatTime ();
+	for (i = 0; i < lookups; i++)
+	{
+		addr = &socks[(i * 7919) % n].addr;
+		if (NET_HashFind (table, 1, 0, addr))
+			hashhits++;
+	}
+	hashtime = Sys_FloatTime () - start;
+
+	Con_Printf ("%i connections, %i lookups\n", n, lookups);
+	Con_Printf ("list walk: %8.3f usec per lookup (%i found)\n", walktime * 1000000.0 / lookups, walkhits);
+	Con_Printf ("hash     : %8.3f usec per lookup (%i found)\n", hashtime * 1000000.0 / lookups, hashhits);
+
+	free (socks);
+	free (table);
+}
+
+
 /*
 ===================
 NET_NewQSocket
@@ -125,6 +313,8 @@ qsocket_t *NET_NewQSocket (void)
 	sock->next = net_activeSockets;
 	net_activeSockets = sock;
 
+	sock->hashnext = NULL;
+	sock->hashbucket = -1;
 	sock->disconnected = false;
 	sock->connecttime = net_time;
 	Q_strcpy (sock->address,"UNSET ADDRESS");
@@ -164,6 +354,7 @@ void NET_FreeQSocket(qsocket_t *sock)
 		if (!s)
 			Sys_Error ("NET_FreeQSocket: not active\n");
 	}
+	NET_HashRemove (net_hash, sock);
 
 	// add it to free list
 	sock->next = net_freeSockets;
@@ -845,6 +1036,7 @@ void NET_Init (void)
 		s->next = net_freeSockets;
 		net_freeSockets = s;
 		s->disconnected = true;
+		s->hashbucket = -1;
 	}
 
 	// allocate space for network message buffer
@@ -868,6 +1060,7 @@ void NET_Init (void)
 	Cmd_AddCommand ("listen", NET_Listen_f);
 	Cmd_AddCommand ("maxplayers", MaxPlayers_f);
 	Cmd_AddCommand ("port", NET_Port_f);
+	Cmd_AddCommand ("net_hashbench", NET_HashBench_f);
 
 	// initialize all the drivers
 	for (net_driverlevel=0 ; net_driverlevel<net_numdrivers ; net_driverlevel++)
@@ -928,6 +1121,9 @@ void NET_Poll(void)
 {
 	PollProcedure *pp;
 	qboolean	useModem;
+	double		prof_start;
+
+	prof_start = Prof_Begin ();
 
 	if (!configRestored)
 	{
@@ -952,6 +1148,23 @@ void NET_Poll(void)
 		pollProcedureList = pp->next;
 		pp->procedure(pp->arg);
 	}
+
+	Prof_End (PROF_NETPOLL, prof_start);
+}
+
+
+/*
+====================
+NET_Flush
+====================
+*/
+void NET_Flush (void)
+{
+	int		i;
+
+	for (i = 0; i < net_numlandrivers; i++)
+		if (net_landrivers[i].initialized && net_landrivers[i].Flush)
+			net_landrivers[i].Flush ();
 }
 
 
@@ -0,0 +1,950 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// net_udp.c -- BSD sockets UDP driver for Linux
+
+#define _GNU_SOURCE		// recvmmsg / sendmmsg
+
+#include "quakedef.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "net_udp.h"
+
+extern cvar_t hostname;
+
+#ifndef MAXHOSTNAMELEN
+#define MAXHOSTNAMELEN		256
+#endif
+
+static int net_acceptsocket = -1;		// socket for fielding new connections
+static int net_controlsocket;
+static int net_broadcastsocket = 0;
+static struct qsockaddr broadcastaddr;
+
+static unsigned long myAddr;
+
+/*
+=============================================================================
+
+A dedicated server fields every client through the accept socket instead of
+opening a socket per connection.  Each connection gets a virtual socket that
+is hashed on the client address; datagrams are pulled off the accept socket
+UDP_MAXBATCH at a time with recvmmsg and queued on the virtual socket they
+belong to.  Outgoing datagrams are gathered up and handed to sendmmsg when
+UDP_Flush is called at the end of the server frame, or as soon as the
+driver is asked to read again.
+
+Virtual socket numbers start at UDP_VSOCKETBASE so they never collide with
+a real descriptor.  Clients and listen servers use plain sockets.
+
+=============================================================================
+*/
+
+#define	UDP_MAXBATCH		64			// datagrams per recvmmsg / sendmmsg call
+#define	UDP_MAXPACKETS		1024		// receive buffers shared by all virtual sockets
+#define	UDP_MAXQUEUED		128			// oldest datagrams are dropped past this
+#define	UDP_MAXVSOCKETS		256
+#define	UDP_HASHBITS		9
+#define	UDP_HASHSIZE		(1<<UDP_HASHBITS)
+#define	UDP_VSOCKETBASE		0x10000
+#define	UDP_DRAININTERVAL	0.001		// don't poll an empty socket more often than this
+
+typedef struct udppacket_s
+{
+	struct udppacket_s	*next;
+	int					length;
+	struct qsockaddr	addr;
+	byte				data[NET_DATAGRAMSIZE];
+} udppacket_t;
+
+typedef struct udpvsock_s
+{
+	qboolean			inuse;
+	qboolean			connected;
+	struct qsockaddr	addr;
+	struct udpvsock_s	*hashnext;
+	udppacket_t			*head;
+	udppacket_t			*tail;
+	int					queued;
+} udpvsock_t;
+
+static qboolean		udp_mux;
+static qboolean		udp_listening;
+static int			udp_acceptport;
+
+static udpvsock_t	udp_vsockets[UDP_MAXVSOCKETS];
+static udpvsock_t	*udp_hash[UDP_HASHSIZE];
+static udpvsock_t	udp_control;		// datagrams for the accept socket itself
+static int			udp_numvsockets;
+
+static udppacket_t	udp_packets[UDP_MAXPACKETS];
+static udppacket_t	*udp_freepackets;
+static double		udp_emptytime;
+
+static struct mmsghdr	udp_recvmsgs[UDP_MAXBATCH];
+static struct iovec		udp_recviov[UDP_MAXBATCH];
+static udppacket_t		*udp_recvpackets[UDP_MAXBATCH];
+
+static struct
+{
+	int					length;
+	struct qsockaddr	addr;
+	byte				data[NET_DATAGRAMSIZE];
+} udp_sendq[UDP_MAXBATCH];
+static struct mmsghdr	udp_sendmsgs[UDP_MAXBATCH];
+static struct iovec		udp_sendiov[UDP_MAXBATCH];
+static int				udp_numsend;
+
+/* statistic counters */
+static int	udp_recvcalls;
+static int	udp_sendcalls;
+static int	udp_packetsreceived;
+static int	udp_packetssent;
+static int	udp_packetsdropped;
+
+//=============================================================================
+
+static unsigned UDP_HashAddr (struct qsockaddr *addr)
+{
+	unsigned	h;
+
+	h = ((struct sockaddr_in *)addr)->sin_addr.s_addr;
+	h ^= ((struct sockaddr_in *)addr)->sin_port * 0x10001;
+	h *= 0x9e3779b1;
+	return h >> (32 - UDP_HASHBITS);
+}
+
+static udpvsock_t *UDP_HashFind (struct qsockaddr *addr)
+{
+	udpvsock_t	*vs;
+
+	for (vs = udp_hash[UDP_HashAddr (addr)]; vs; vs = vs->hashnext)
+		if (UDP_AddrCompare (addr, &vs->addr) == 0)
+			return vs;
+	return NULL;
+}
+
+static void UDP_HashRemove (udpvsock_t *vs)
+{
+	udpvsock_t	**link;
+
+	for (link = &udp_hash[UDP_HashAddr (&vs->addr)]; *link; link = &(*link)->hashnext)
+		if (*link == vs)
+		{
+			*link = vs->hashnext;
+			break;
+		}
+	vs->hashnext = NULL;
+}
+
+static void UDP_FreePacket (udppacket_t *p)
+{
+	p->next = udp_freepackets;
+	udp_freepackets = p;
+}
+
+static void UDP_ClearQueue (udpvsock_t *vs)
+{
+	udppacket_t	*p;
+
+	while (vs->head)
+	{
+		p = vs->head;
+		vs->head = p->next;
+		UDP_FreePacket (p);
+	}
+	vs->tail = NULL;
+	vs->queued = 0;
+}
+
+static void UDP_Enqueue (udpvsock_t *vs, udppacket_t *p)
+{
+	udppacket_t	*old;
+
+	if (vs->queued == UDP_MAXQUEUED)
+	{
+		old = vs->head;
+		vs->head = old->next;
+		if (!vs->head)
+			vs->tail = NULL;
+		vs->queued--;
+		UDP_FreePacket (old);
+		udp_packetsdropped++;
+	}
+
+	p->next = NULL;
+	if (vs->tail)
+		vs->tail->next = p;
+	else
+		vs->head = p;
+	vs->tail = p;
+	vs->queued++;
+}
+
+/*
+============
+UDP_Route
+
+Connection requests always go to the accept socket, even when they come from
+an address that is already connected; that is how a client retrying after a
+lost accept reply, or coming back from a crash, gets through.  Anything else
+from an address with no virtual socket is left over from a client that has
+gone, and is dropped so it can't crowd connection requests out of the
+control queue.
+============
+*/
+static void UDP_Route (udppacket_t *p)
+{
+	udpvsock_t	*vs;
+
+	udp_packetsreceived++;
+
+	if (p->length >= 4 && (p->data[0] & 0x80))	// NETFLAG_CTL, big endian
+		vs = &udp_control;
+	else
+		vs = UDP_HashFind (&p->addr);
+	if (!vs)
+	{
+		UDP_FreePacket (p);
+		udp_packetsdropped++;
+		return;
+	}
+	UDP_Enqueue (vs, p);
+}
+
+/*
+============
+UDP_Drain
+
+Pulls everything that is waiting on the accept socket into the virtual
+socket queues
+============
+*/
+static void UDP_Drain (void)
+{
+	int			i, n, ret;
+	udppacket_t	*p;
+
+	if (net_acceptsocket == -1)
+		return;
+	if (net_time - udp_emptytime < UDP_DRAININTERVAL && net_time >= udp_emptytime)
+		return;
+
+	while (1)
+	{
+		for (n = 0; n < UDP_MAXBATCH && udp_freepackets; n++)
+		{
+			p = udp_freepackets;
+			udp_freepackets = p->next;
+			udp_recvpackets[n] = p;
+
+			udp_recviov[n].iov_base = p->data;
+			udp_recviov[n].iov_len = NET_DATAGRAMSIZE;
+			Q_memset (&udp_recvmsgs[n], 0, sizeof(udp_recvmsgs[n]));
+			udp_recvmsgs[n].msg_hdr.msg_name = &p->addr;
+			udp_recvmsgs[n].msg_hdr.msg_namelen = sizeof(struct qsockaddr);
+			udp_recvmsgs[n].msg_hdr.msg_iov = &udp_recviov[n];
+			udp_recvmsgs[n].msg_hdr.msg_iovlen = 1;
+		}
+		if (!n)
+			return;		// every buffer is queued, let the readers catch up
+
+		ret = recvmmsg (net_acceptsocket, udp_recvmsgs, n, MSG_DONTWAIT, NULL);
+		udp_recvcalls++;
+		if (ret < 0)
+			ret = 0;
+
+		for (i = 0; i < ret; i++)
+		{
+			p = udp_recvpackets[i];
+			p->length = udp_recvmsgs[i].msg_len;
+			UDP_Route (p);
+		}
+		for ( ; i < n; i++)
+			UDP_FreePacket (udp_recvpackets[i]);
+
+		if (ret < n)
+		{
+			udp_emptytime = net_time;
+			return;
+		}
+	}
+}
+
+static int UDP_ReadQueue (udpvsock_t *vs, byte *buf, int len, struct qsockaddr *addr)
+{
+	udppacket_t	*p;
+
+	if (udp_numsend)
+		UDP_Flush ();
+
+	if (!vs->head)
+		UDP_Drain ();
+	p = vs->head;
+	if (!p)
+		return 0;
+
+	vs->head = p->next;
+	if (!vs->head)
+		vs->tail = NULL;
+	vs->queued--;
+
+	if (len > p->length)
+		len = p->length;
+	Q_memcpy (buf, p->data, len);
+	*addr = p->addr;
+	UDP_FreePacket (p);
+
+	return len;
+}
+
+static int UDP_OpenVirtualSocket (void)
+{
+	int			i;
+	udpvsock_t	*vs;
+
+	for (i = 0; i < UDP_MAXVSOCKETS; i++)
+		if (!udp_vsockets[i].inuse)
+			break;
+	if (i == UDP_MAXVSOCKETS)
+	{
+		Con_Printf ("UDP_OpenSocket: out of virtual sockets\n");
+		return -1;
+	}
+
+	vs = &udp_vsockets[i];
+	Q_memset (vs, 0, sizeof(*vs));
+	vs->inuse = true;
+	udp_numvsockets++;
+
+	return UDP_VSOCKETBASE + i;
+}
+
+static void UDP_CloseVirtualSocket (udpvsock_t *vs)
+{
+	if (!vs->inuse)
+		return;
+
+	if (vs->connected)
+		UDP_HashRemove (vs);
+	UDP_ClearQueue (vs);
+	vs->inuse = false;
+	vs->connected = false;
+	udp_numvsockets--;
+}
+
+static udpvsock_t *UDP_VirtualSocket (int socket)
+{
+	if (socket < UDP_VSOCKETBASE || socket >= UDP_VSOCKETBASE + UDP_MAXVSOCKETS)
+		return NULL;
+	return &udp_vsockets[socket - UDP_VSOCKETBASE];
+}
+
+static void UDP_CloseAcceptSocket (void)
+{
+	UDP_Flush ();
+	UDP_ClearQueue (&udp_control);
+	close (net_acceptsocket);
+	net_acceptsocket = -1;
+}
+
+static void UDP_Stats_f (void)
+{
+	Con_Printf("recvmmsg calls             = %i\n", udp_recvcalls);
+	Con_Printf("sendmmsg calls             = %i\n", udp_sendcalls);
+	Con_Printf("packets received           = %i\n", udp_packetsreceived);
+	Con_Printf("packets sent               = %i\n", udp_packetssent);
+	Con_Printf("packets dropped            = %i\n", udp_packetsdropped);
+	Con_Printf("virtual sockets            = %i\n", udp_numvsockets);
+}
+
+//=============================================================================
+
+void UDP_GetLocalAddress (void)
+{
+	struct hostent	*local;
+	char			buff[MAXHOSTNAMELEN];
+	unsigned long	addr;
+
+	if (myAddr != INADDR_ANY)
+		return;
+
+	if (gethostname(buff, MAXHOSTNAMELEN) == -1)
+		return;
+
+	local = gethostbyname(buff);
+	if (local == NULL)
+		return;
+
+	myAddr = *(int *)local->h_addr_list[0];
+
+	addr = ntohl(myAddr);
+	sprintf(my_tcpip_address, "%d.%d.%d.%d", (int)((addr >> 24) & 0xff), (int)((addr >> 16) & 0xff), (int)((addr >> 8) & 0xff), (int)(addr & 0xff));
+}
+
+
+int UDP_Init (void)
+{
+	int		i;
+	char	buff[MAXHOSTNAMELEN];
+	char	*p;
+
+	if (COM_CheckParm ("-noudp"))
+		return -1;
+
+	// determine my name
+	if (gethostname(buff, MAXHOSTNAMELEN) == -1)
+	{
+		Con_DPrintf ("UDP Initialization failed.\n");
+		return -1;
+	}
+	buff[MAXHOSTNAMELEN - 1] = 0;
+
+	// if the quake hostname isn't set, set it to the machine name
+	if (Q_strcmp(hostname.string, "UNNAMED") == 0)
+	{
+		// see if it's a text IP address (well, close enough)
+		for (p = buff; *p; p++)
+			if ((*p < '0' || *p > '9') && *p != '.')
+				break;
+
+		// if it is a real name, strip off the domain; we only want the host
+		if (*p)
+		{
+			for (i = 0; i < 15; i++)
+				if (buff[i] == '.')
+					break;
+			buff[i] = 0;
+		}
+		Cvar_Set ("hostname", buff);
+	}
+
+	i = COM_CheckParm ("-ip");
+	if (i)
+	{
+		if (i < com_argc-1)
+		{
+			myAddr = inet_addr(com_argv[i+1]);
+			if (myAddr == INADDR_NONE)
+				Sys_Error ("%s is not a valid IP address", com_argv[i+1]);
+			strcpy(my_tcpip_address, com_argv[i+1]);
+		}
+		else
+		{
+			Sys_Error ("NET_Init: you must specify an IP address after -ip");
+		}
+	}
+	else
+	{
+		myAddr = INADDR_ANY;
+		strcpy(my_tcpip_address, "INADDR_ANY");
+	}
+
+	if ((net_controlsocket = UDP_OpenSocket (0)) == -1)
+	{
+		Con_Printf("UDP_Init: Unable to open control socket\n");
+		return -1;
+	}
+
+	((struct sockaddr_in *)&broadcastaddr)->sin_family = AF_INET;
+	((struct sockaddr_in *)&broadcastaddr)->sin_addr.s_addr = INADDR_BROADCAST;
+	((struct sockaddr_in *)&broadcastaddr)->sin_port = htons((unsigned short)net_hostport);
+
+	// only a dedicated server multiplexes its clients over the accept socket
+	udp_mux = (cls.state == ca_dedicated && !COM_CheckParm ("-noudpmux"));
+	udp_freepackets = NULL;
+	for (i = 0; i < UDP_MAXPACKETS; i++)
+		UDP_FreePacket (&udp_packets[i]);
+	udp_emptytime = -1;
+
+	Cmd_AddCommand ("udp_stats", UDP_Stats_f);
+
+	Con_Printf("UDP Initialized\n");
+	tcpipAvailable = true;
+
+	return net_controlsocket;
+}
+
+//=============================================================================
+
+void UDP_Shutdown (void)
+{
+	int		i;
+
+	UDP_Flush ();
+	for (i = 0; i < UDP_MAXVSOCKETS; i++)
+		UDP_CloseVirtualSocket (&udp_vsockets[i]);
+	UDP_Listen (false);
+	UDP_CloseSocket (net_controlsocket);
+}
+
+//=============================================================================
+
+void UDP_Listen (qboolean state)
+{
+	// enable listening
+	if (state)
+	{
+		udp_listening = true;
+		if (net_acceptsocket != -1)
+		{
+			if (udp_acceptport == net_hostport)
+				return;
+			// connected clients send and receive on the accept socket
+			if (udp_numvsockets)
+			{
+				Con_Printf ("UDP: clients are connected, still listening on port %i\n",
+					udp_acceptport);
+				return;
+			}
+			UDP_CloseAcceptSocket ();
+		}
+		UDP_GetLocalAddress();
+		if ((net_acceptsocket = UDP_OpenSocket (net_hostport)) == -1)
+			Sys_Error ("UDP_Listen: Unable to open accept socket\n");
+		udp_acceptport = net_hostport;
+		return;
+	}
+
+	// disable listening
+	udp_listening = false;
+	if (net_acceptsocket == -1)
+		return;
+	// connected clients keep using the accept socket until they leave
+	if (udp_numvsockets)
+		return;
+	UDP_CloseAcceptSocket ();
+}
+
+//=============================================================================
+
+int UDP_OpenSocket (int port)
+{
+	int newsocket;
+	struct sockaddr_in address;
+	int _true = 1;
+
+	if (udp_mux && port == 0 && net_acceptsocket != -1)
+		return UDP_OpenVirtualSocket ();
+
+	if ((newsocket = socket (PF_INET, SOCK_DGRAM, IPPROTO_UDP)) == -1)
+		return -1;
+
+	if (ioctl (newsocket, FIONBIO, (char *)&_true) == -1)
+		goto ErrorReturn;
+
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = myAddr;
+	address.sin_port = htons((unsigned short)port);
+	if( bind (newsocket, (void *)&address, sizeof(address)) == 0)
+		return newsocket;
+
+	Sys_Error ("Unable to bind to %s", UDP_AddrToString((struct qsockaddr *)&address));
+ErrorReturn:
+	close (newsocket);
+	return -1;
+}
+
+//=============================================================================
+
+int UDP_CloseSocket (int socket)
+{
+	udpvsock_t	*vs;
+
+	vs = UDP_VirtualSocket (socket);
+	if (vs)
+	{
+		UDP_Flush ();
+		UDP_CloseVirtualSocket (vs);
+		if (!udp_numvsockets && !udp_listening && net_acceptsocket != -1)
+			UDP_CloseAcceptSocket ();
+		return 0;
+	}
+
+	if (socket == net_broadcastsocket)
+		net_broadcastsocket = 0;
+	return close (socket);
+}
+
+
+//=============================================================================
+/*
+============
+PartialIPAddress
+
+this lets you type only as much of the net address as required, using
+the local network components to fill in the rest
+============
+*/
+static int PartialIPAddress (char *in, struct qsockaddr *hostaddr)
+{
+	char buff[256];
+	char *b;
+	int addr;
+	int num;
+	int mask;
+	int run;
+	int port;
+	
+	buff[0] = '.';
+	b = buff;
+	strcpy(buff+1, in);
+	if (buff[1] == '.')
+		b++;
+
+	addr = 0;
+	mask=-1;
+	while (*b == '.')
+	{
+		b++;
+		num = 0;
+		run = 0;
+		while (!( *b < '0' || *b > '9'))
+		{
+		  num = num*10 + *b++ - '0';
+		  if (++run > 3)
+		  	return -1;
+		}
+		if ((*b < '0' || *b > '9') && *b != '.' && *b != ':' && *b != 0)
+			return -1;
+		if (num < 0 || num > 255)
+			return -1;
+		mask<<=8;
+		addr = (addr<<8) + num;
+	}
+	
+	if (*b++ == ':')
+		port = Q_atoi(b);
+	else
+		port = net_hostport;
+
+	hostaddr->sa_family = AF_INET;
+	((struct sockaddr_in *)hostaddr)->sin_port = htons((short)port);	
+	((struct sockaddr_in *)hostaddr)->sin_addr.s_addr = (myAddr & htonl(mask)) | htonl(addr);
+	
+	return 0;
+}
+//=============================================================================
+
+int UDP_Connect (int socket, struct qsockaddr *addr)
+{
+	udpvsock_t	*vs;
+	unsigned	h;
+
+	vs = UDP_VirtualSocket (socket);
+	if (!vs)
+		return 0;
+
+	if (vs->connected)
+		UDP_HashRemove (vs);
+	vs->addr = *addr;
+	vs->connected = true;
+	h = UDP_HashAddr (addr);
+	vs->hashnext = udp_hash[h];
+	udp_hash[h] = vs;
+
+	return 0;
+}
+
+//=============================================================================
+
+int UDP_CheckNewConnections (void)
+{
+	char buf[4096];
+
+	if (net_acceptsocket == -1 || !udp_listening)
+		return -1;
+
+	if (udp_mux)
+	{
+		if (!udp_control.head)
+			UDP_Drain ();
+		if (udp_control.head)
+			return net_acceptsocket;
+		return -1;
+	}
+
+	if (recvfrom (net_acceptsocket, buf, sizeof(buf), MSG_PEEK, NULL, NULL) > 0)
+	{
+		return net_acceptsocket;
+	}
+	return -1;
+}
+
+//=============================================================================
+
+int UDP_Read (int socket, byte *buf, int len, struct qsockaddr *addr)
+{
+	socklen_t addrlen = sizeof (struct qsockaddr);
+	udpvsock_t	*vs;
+	int ret;
+
+	vs = UDP_VirtualSocket (socket);
+	if (vs)
+		return UDP_ReadQueue (vs, buf, len, addr);
+	if (udp_mux && socket == net_acceptsocket)
+		return UDP_ReadQueue (&udp_control, buf, len, addr);
+
+	ret = recvfrom (socket, buf, len, 0, (struct sockaddr *)addr, &addrlen);
+	if (ret == -1 && (errno == EWOULDBLOCK || errno == ECONNREFUSED))
+		return 0;
+	return ret;
+}
+
+//=============================================================================
+
+int UDP_MakeSocketBroadcastCapable (int socket)
+{
+	int	i = 1;
+
+	// make this socket broadcast capable
+	if (setsockopt(socket, SOL_SOCKET, SO_BROADCAST, (char *)&i, sizeof(i)) < 0)
+		return -1;
+	net_broadcastsocket = socket;
+
+	return 0;
+}
+
+//=============================================================================
+
+int UDP_Broadcast (int socket, byte *buf, int len)
+{
+	int ret;
+
+	if (socket != net_broadcastsocket)
+	{
+		if (net_broadcastsocket != 0)
+			Sys_Error("Attempted to use multiple broadcasts sockets\n");
+		UDP_GetLocalAddress();
+		ret = UDP_MakeSocketBroadcastCapable (socket);
+		if (ret == -1)
+		{
+			Con_Printf("Unable to make socket broadcast capable\n");
+			return ret;
+		}
+	}
+
+	return UDP_Write (socket, buf, len, &broadcastaddr);
+}
+
+//=============================================================================
+
+int UDP_Write (int socket, byte *buf, int len, struct qsockaddr *addr)
+{
+	int ret;
+
+	if ((UDP_VirtualSocket (socket) || (udp_mux && socket == net_acceptsocket))
+		&& len <= NET_DATAGRAMSIZE)
+	{
+		udp_sendq[udp_numsend].length = len;
+		udp_sendq[udp_numsend].addr = *addr;
+		Q_memcpy (udp_sendq[udp_numsend].data, buf, len);
+		if (++udp_numsend == UDP_MAXBATCH)
+			UDP_Flush ();
+		return len;
+	}
+
+	if (UDP_VirtualSocket (socket))
+		socket = net_acceptsocket;
+
+	ret = sendto (socket, buf, len, 0, (struct sockaddr *)addr, sizeof(struct qsockaddr));
+	if (ret == -1 && errno == EWOULDBLOCK)
+		return 0;
+	return ret;
+}
+
+/*
+============
+UDP_Flush
+
+Sends everything queued by UDP_Write.  A datagram the kernel won't take is
+dropped, exactly as if it had been lost on the wire.
+============
+*/
+void UDP_Flush (void)
+{
+	int		i, sent, ret;
+
+	if (!udp_numsend)
+		return;
+
+	if (net_acceptsocket == -1)
+	{
+		udp_packetsdropped += udp_numsend;
+		udp_numsend = 0;
+		return;
+	}
+
+	for (i = 0; i < udp_numsend; i++)
+	{
+		udp_sendiov[i].iov_base = udp_sendq[i].data;
+		udp_sendiov[i].iov_len = udp_sendq[i].length;
+		Q_memset (&udp_sendmsgs[i], 0, sizeof(udp_sendmsgs[i]));
+		udp_sendmsgs[i].msg_hdr.msg_name = &udp_sendq[i].addr;
+		udp_sendmsgs[i].msg_hdr.msg_namelen = sizeof(struct qsockaddr);
+		udp_sendmsgs[i].msg_hdr.msg_iov = &udp_sendiov[i];
+		udp_sendmsgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	for (sent = 0; sent < udp_numsend; sent += ret)
+	{
+		ret = sendmmsg (net_acceptsocket, udp_sendmsgs + sent, udp_numsend - sent, 0);
+		udp_sendcalls++;
+		if (ret <= 0)
+		{
+			udp_packetsdropped++;
+			ret = 1;
+			continue;
+		}
+		udp_packetssent += ret;
+	}
+
+	udp_numsend = 0;
+}
+
+//=============================================================================
+
+char *UDP_AddrToString (struct qsockaddr *addr)
+{
+	static char buffer[22];
+	int haddr;
+
+	haddr = ntohl(((struct sockaddr_in *)addr)->sin_addr.s_addr);
+	sprintf(buffer, "%d.%d.%d.%d:%d", (haddr >> 24) & 0xff, (haddr >> 16) & 0xff, (haddr >> 8) & 0xff, haddr & 0xff, ntohs(((struct sockaddr_in *)addr)->sin_port));
+	return buffer;
+}
+
+//=============================================================================
+
+int UDP_StringToAddr (char *string, struct qsockaddr *addr)
+{
+	int ha1, ha2, ha3, ha4, hp;
+	int ipaddr;
+
+	sscanf(string, "%d.%d.%d.%d:%d", &ha1, &ha2, &ha3, &ha4, &hp);
+	ipaddr = (ha1 << 24) | (ha2 << 16) | (ha3 << 8) | ha4;
+
+	addr->sa_family = AF_INET;
+	((struct sockaddr_in *)addr)->sin_addr.s_addr = htonl(ipaddr);
+	((struct sockaddr_in *)addr)->sin_port = htons((unsigned short)hp);
+	return 0;
+}
+
+//=============================================================================
+
+int UDP_GetSocketAddr (int socket, struct qsockaddr *addr)
+{
+	socklen_t addrlen = sizeof(struct qsockaddr);
+	unsigned int a;
+
+	if (UDP_VirtualSocket (socket))
+		socket = net_acceptsocket;
+
+	Q_memset(addr, 0, sizeof(struct qsockaddr));
+	getsockname(socket, (struct sockaddr *)addr, &addrlen);
+	a = ((struct sockaddr_in *)addr)->sin_addr.s_addr;
+	if (a == 0 || a == inet_addr("127.0.0.1"))
+		((struct sockaddr_in *)addr)->sin_addr.s_addr = myAddr;
+
+	return 0;
+}
+
+//=============================================================================
+
+int UDP_GetNameFromAddr (struct qsockaddr *addr, char *name)
+{
+	struct hostent *hostentry;
+
+	hostentry = gethostbyaddr ((char *)&((struct sockaddr_in *)addr)->sin_addr, sizeof(struct in_addr), AF_INET);
+	if (hostentry)
+	{
+		Q_strncpy (name, (char *)hostentry->h_name, NET_NAMELEN - 1);
+		return 0;
+	}
+
+	Q_strcpy (name, UDP_AddrToString (addr));
+	return 0;
+}
+
+//=============================================================================
+
+int UDP_GetAddrFromName(char *name, struct qsockaddr *addr)
+{
+	struct hostent *hostentry;
+
+	if (name[0] >= '0' && name[0] <= '9')
+		return PartialIPAddress (name, addr);
+	
+	hostentry = gethostbyname (name);
+	if (!hostentry)
+		return -1;
+
+	addr->sa_family = AF_INET;
+	((struct sockaddr_in *)addr)->sin_port = htons((unsigned short)net_hostport);	
+	((struct sockaddr_in *)addr)->sin_addr.s_addr = *(int *)hostentry->h_addr_list[0];
+
+	return 0;
+}
+
+//=============================================================================
+
+int UDP_AddrCompare (struct qsockaddr *addr1, struct qsockaddr *addr2)
+{
+	if (addr1->sa_family != addr2->sa_family)
+		return -1;
+
+	if (((struct sockaddr_in *)addr1)->sin_addr.s_addr != ((struct sockaddr_in *)addr2)->sin_addr.s_addr)
+		return -1;
+
+	if (((struct sockaddr_in *)addr1)->sin_port != ((struct sockaddr_in *)addr2)->sin_port)
+		return 1;
+
+	return 0;
+}
+
+//=============================================================================
+
+int UDP_GetSocketPort (struct qsockaddr *addr)
+{
+	return ntohs(((struct sockaddr_in *)addr)->sin_port);
+}
+
+
+int UDP_SetSocketPort (struct qsockaddr *addr, int port)
+{
+	((struct sockaddr_in *)addr)->sin_port = htons((unsigned short)port);
+	return 0;
+}
+
+//=============================================================================
+
+unsigned UDP_HostHash (struct qsockaddr *addr)
+{
+	return ((struct sockaddr_in *)addr)->sin_addr.s_addr;
+}
+
+//=============================================================================
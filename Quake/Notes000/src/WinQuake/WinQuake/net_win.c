@@ -89,7 +89,9 @@ net_landriver_t	net_landrivers[MAX_NET_DRIVERS] =
 	WINS_GetAddrFromName,
 	WINS_AddrCompare,
 	WINS_GetSocketPort,
-	WINS_SetSocketPort
+	WINS_SetSocketPort,
+	NULL,
+	WINS_HostHash
 	},
 	{
 	"Winsock IPX",
@@ -112,7 +114,9 @@ net_landriver_t	net_landrivers[MAX_NET_DRIVERS] =
 	WIPX_GetAddrFromName,
 	WIPX_AddrCompare,
 	WIPX_GetSocketPort,
-	WIPX_SetSocketPort
+	WIPX_SetSocketPort,
+	NULL,
+	WIPX_HostHash
 	}
 
 };
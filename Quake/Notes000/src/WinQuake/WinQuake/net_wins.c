@@ -573,3 +573,10 @@ int WINS_SetSocketPort (struct qsockaddr *addr, int port)
 }
 
 //=============================================================================
+
+unsigned WINS_HostHash (struct qsockaddr *addr)
+{
+	return ((struct sockaddr_in *)addr)->sin_addr.s_addr;
+}
+
+//=============================================================================
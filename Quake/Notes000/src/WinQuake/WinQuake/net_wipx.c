@@ -430,3 +430,19 @@ int WIPX_SetSocketPort (struct qsockaddr *addr, int port)
 }
 
 //=============================================================================
+
+// the network number isn't hashed, AddrCompare lets a zero one match any
+unsigned WIPX_HostHash (struct qsockaddr *addr)
+{
+	byte		*node;
+	unsigned	h;
+	int			i;
+
+	node = (byte *)((struct sockaddr_ipx *)addr)->sa_nodenum;
+	h = 0;
+	for (i = 0; i < 6; i++)
+		h = h * 31 + node[i];
+	return h;
+}
+
+//=============================================================================
@@ -37,3 +37,4 @@ int  WIPX_GetAddrFromName (char *name, struct qsockaddr *addr);
 int  WIPX_AddrCompare (struct qsockaddr *addr1, struct qsockaddr *addr2);
 int  WIPX_GetSocketPort (struct qsockaddr *addr);
 int  WIPX_SetSocketPort (struct qsockaddr *addr, int port);
+unsigned WIPX_HostHash (struct qsockaddr *addr);
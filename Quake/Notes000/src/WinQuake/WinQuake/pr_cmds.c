@@ -686,7 +686,6 @@ byte	checkpvs[MAX_MAP_LEAFS/8];
 int PF_newcheckclient (int check)
 {
 	int		i;
-	byte	*pvs;
 	edict_t	*ent;
 	mleaf_t	*leaf;
 	vec3_t	org;
@@ -727,8 +726,7 @@ int PF_newcheckclient (int check)
 // get the PVS for the entity
 	VectorAdd (ent->v.origin, ent->v.view_ofs, org);
 	leaf = Mod_PointInLeaf (org, sv.worldmodel);
-	pvs = Mod_LeafPVS (leaf, sv.worldmodel);
-	memcpy (checkpvs, pvs, (sv.worldmodel->numleafs+7)>>3 );
+	Mod_LeafPVSBuffer (leaf, sv.worldmodel, checkpvs);
 
 	return i;
 }
@@ -920,7 +918,7 @@ void PF_dprint (void)
 	Con_DPrintf ("%s",PF_VarString(0));
 }
 
-char	pr_string_temp[128];
+char	*pr_string_temp;		// hunk allocated so it is addressable from pr_strings
 
 void PF_ftos (void)
 {
@@ -1798,7 +1796,7 @@ void PF_WaterMove (void)
 	if (! (flags & FL_WATERJUMP) )
 	{
 //		self.velocity = self.velocity - 0.8*self.waterlevel*frametime*self.velocity;
-		VectorMA (self->v.velocity, -0.8 * self->v.waterlevel * host_frametime, self->v.velocity, self->v.velocity);
+		VectorMA (self->v.velocity, -0.8 * self->v.waterlevel * sv_frametime, self->v.velocity, self->v.velocity);
 	}
 
 	G_FLOAT(OFS_RETURN) = damage;
@@ -1082,6 +1082,8 @@ void PR_Init (void)
 	Cvar_RegisterVariable (&saved2);
 	Cvar_RegisterVariable (&saved3);
 	Cvar_RegisterVariable (&saved4);
+
+	pr_string_temp = Hunk_AllocName (PR_STRING_TEMP, "pr_temp");
 }
 
 
@@ -369,6 +369,9 @@ void PR_ExecuteProgram (func_t fnum)
 	edict_t	*ed;
 	int		exitdepth;
 	eval_t	*ptr;
+	double	prof_start;
+
+	prof_start = Prof_Begin ();
 
 	if (!fnum || fnum >= progs->numfunctions)
 	{
@@ -643,7 +646,10 @@ while (1)
 	
 		s = PR_LeaveFunction ();
 		if (pr_depth == exitdepth)
+		{
+			Prof_End (PROF_EXECUTEPROGRAM, prof_start);
 			return;		// all done
+		}
 		break;
 		
 	case OP_STATE:
@@ -0,0 +1,693 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// prof.c -- named timing scopes with latency histograms
+//
+// Each scope pushes its durations into a ring, and Prof_Drain folds them into
+// a log-linear histogram (sixteen sub-buckets per power of two nanoseconds,
+// so any percentile is within about 6%).  The timing path only stores into
+// the ring and bumps its head; only the drain moves the tail, so there is no
+// lock to take however often SV_Move gets called, only acquire and release
+// ordering on the head and tail.
+//
+// Prof_Frame also adds up each scope's time for the host frame into a
+// rolling window of the last PROF_WINDOW frames, for the percentiles that
+// prof_overlay draws, and prof_trace keeps every timed call of a few frames
+// to write out in the Chrome trace event format (chrome://tracing or
+// ui.perfetto.dev).  Trace events are only written by the thread that owns
+// the scope, and only read by Prof_Frame with the host lock held.
+
+#include "quakedef.h"
+
+#define	PROF_RINGSIZE		16384		// must be a power of two
+#define	PROF_SUBBITS		4
+#define	PROF_SUBBUCKETS		(1<<PROF_SUBBITS)
+#define	PROF_BUCKETS		((32 - PROF_SUBBITS + 1) * PROF_SUBBUCKETS)
+#define	PROF_WINDOW			128			// frames in the rolling percentiles
+#define	PROF_TRACEEVENTS	65536		// per scope, for one prof_trace
+
+// a slot has to be written before the head that publishes it, and read before
+// the tail that frees it, which volatile alone doesn't order on a weakly
+// ordered cpu like AArch64
+#ifdef _MSC_VER
+#include <intrin.h>
+#define	PROF_LOADACQUIRE(p)		((unsigned)_InterlockedOr ((volatile long *)(p), 0))
+#define	PROF_STORERELEASE(p,v)	_InterlockedExchange ((volatile long *)(p), (long)(v))
+#else
+#define	PROF_LOADACQUIRE(p)		__atomic_load_n ((p), __ATOMIC_ACQUIRE)
+#define	PROF_STORERELEASE(p,v)	__atomic_store_n ((p), (v), __ATOMIC_RELEASE)
+#endif
+
+typedef struct
+{
+	double				start;
+	unsigned			ns;
+	int					thread;			// 1 main, 2 server
+} proftraceevent_t;
+
+typedef struct
+{
+	char				*name;
+
+	unsigned			ring[PROF_RINGSIZE];	// nanoseconds
+	volatile unsigned	head;			// only moved by Prof_End
+	volatile unsigned	tail;			// only moved by Prof_Drain
+	unsigned			dropped;		// ring was full
+
+	unsigned			counts[PROF_BUCKETS];
+	unsigned			total;
+	double				sum;			// nanoseconds
+	unsigned			max;
+
+	double				framesum;		// nanoseconds drained this frame
+	float				window[PROF_WINDOW];	// ms per frame
+
+	proftraceevent_t	*trace;
+	volatile unsigned	numtrace;
+	unsigned			tracedropped;
+} profstat_t;
+
+static profstat_t	prof_stats[NUM_PROF_SCOPES];
+
+static char	*prof_names[NUM_PROF_SCOPES] =
+{
+	"Host_ServerFrame",
+	"SV_Physics",
+	"SV_SendClientMessages",
+	"PR_ExecuteProgram",
+	"SV_Move",
+	"NET_Poll",
+	"D_EndSurfaceBuilds",
+	"R_RenderView",
+	"R_MarkLeaves",
+	"R_RenderWorld",
+	"R_DrawBEntitiesOnList",
+	"R_ScanEdges",
+	"R_DrawSurface",
+	"D_DrawSurfaces",
+	"R_DrawEntitiesOnList",
+	"R_DrawParticles",
+	"V_UpdatePalette"
+};
+
+cvar_t	prof = {"prof","0"};
+cvar_t	prof_overlay = {"prof_overlay","0"};
+
+static float	prof_framewindow[PROF_WINDOW];	// ms between Prof_Frame calls
+static int		prof_windowpos, prof_windowfill;
+static double	prof_lastframe;
+
+static qboolean	prof_tracing;
+static int		prof_traceframes;		// left to record
+static double	prof_tracestart;
+static double	*prof_traceframetimes;
+static int		prof_numtraceframes;
+static char		prof_tracename[MAX_OSPATH];
+
+
+/*
+================
+Prof_Begin
+================
+*/
+double Prof_Begin (void)
+{
+	if (!prof.value && !prof_tracing)
+		return 0;
+	return Sys_FloatTime ();
+}
+
+/*
+================
+Prof_End
+================
+*/
+void Prof_End (profscope_t scope, double start)
+{
+	profstat_t			*s;
+	proftraceevent_t	*ev;
+	double				ns;
+	unsigned			head, n;
+
+	if (!start)
+		return;
+
+	ns = (Sys_FloatTime () - start) * 1000000000.0;
+	if (ns < 0)
+		ns = 0;
+	else if (ns > 0xffffffff)
+		ns = 0xffffffff;
+
+	s = &prof_stats[scope];
+
+	if (prof_tracing && start >= prof_tracestart)
+	{
+		n = s->numtrace;
+		if (n < PROF_TRACEEVENTS)
+		{
+			ev = &s->trace[n];
+			ev->start = start;
+			ev->ns = (unsigned)ns;
+			ev->thread = Sys_IsMainThread () ? 1 : 2;
+			s->numtrace = n + 1;
+		}
+		else
+			s->tracedropped++;
+	}
+
+	if (!prof.value)
+		return;
+
+	head = s->head;
+	if (head - PROF_LOADACQUIRE (&s->tail) >= PROF_RINGSIZE)
+	{
+		s->dropped++;
+		return;
+	}
+	s->ring[head & (PROF_RINGSIZE-1)] = (unsigned)ns;
+	PROF_STORERELEASE (&s->head, head + 1);
+}
+
+/*
+================
+Prof_Bucket
+
+Histogram bucket for a duration in nanoseconds
+================
+*/
+static int Prof_Bucket (unsigned ns)
+{
+	int		e;
+
+	if (ns < PROF_SUBBUCKETS)
+		return ns;
+
+	for (e = PROF_SUBBITS ; ns >> (e+1) ; e++)
+		;		// e is the top set bit
+	return (e - PROF_SUBBITS + 1) * PROF_SUBBUCKETS
+		+ ((ns >> (e - PROF_SUBBITS)) & (PROF_SUBBUCKETS - 1));
+}
+
+/*
+================
+Prof_BucketValue
+
+The largest duration that lands in a bucket
+================
+*/
+static unsigned Prof_BucketValue (int b)
+{
+	int		shift, sub;
+
+	if (b < PROF_SUBBUCKETS)
+		return b;
+
+	shift = b / PROF_SUBBUCKETS - 1;
+	sub = b % PROF_SUBBUCKETS;
+	return ((PROF_SUBBUCKETS + sub) << shift) + ((1 << shift) - 1);
+}
+
+/*
+================
+Prof_Drain
+================
+*/
+void Prof_Drain (void)
+{
+	profstat_t	*s;
+	unsigned	head, tail, ns;
+	int			i;
+
+	for (i=0, s=prof_stats ; i<NUM_PROF_SCOPES ; i++, s++)
+	{
+		head = PROF_LOADACQUIRE (&s->head);
+		for (tail = s->tail ; tail != head ; tail++)
+		{
+			ns = s->ring[tail & (PROF_RINGSIZE-1)];
+			s->counts[Prof_Bucket (ns)]++;
+			s->total++;
+			s->sum += ns;
+			s->framesum += ns;
+			if (ns > s->max)
+				s->max = ns;
+		}
+		PROF_STORERELEASE (&s->tail, tail);
+	}
+}
+
+/*
+================
+Prof_Percentile
+
+In microseconds
+================
+*/
+static double Prof_Percentile (profstat_t *s, double p)
+{
+	unsigned	rank, seen, v;
+	int			b;
+
+	rank = (unsigned)(p * s->total + 0.5);
+	if (rank < 1)
+		rank = 1;
+
+	seen = 0;
+	for (b=0 ; b<PROF_BUCKETS ; b++)
+	{
+		seen += s->counts[b];
+		if (seen >= rank)
+			break;
+	}
+	v = Prof_BucketValue (b);
+	if (v > s->max)
+		v = s->max;
+	return v / 1000.0;
+}
+
+/*
+================
+Prof_WindowStats
+
+Mean, median, 99th percentile and worst of a rolling window, in ms
+================
+*/
+static void Prof_WindowStats (float *window, float stats[4])
+{
+	float	sorted[PROF_WINDOW], sum;
+	int		i, n;
+
+	n = prof_windowfill;
+	if (!n)
+	{
+		stats[0] = stats[1] = stats[2] = stats[3] = 0;
+		return;
+	}
+
+	sum = 0;
+	for (i=0 ; i<n ; i++)
+	{
+		sorted[i] = window[i];
+		sum += window[i];
+	}
+	qsort (sorted, n, sizeof(float), CompareFloats);
+
+	stats[0] = sum / n;
+	stats[1] = sorted[(n - 1) / 2];
+	stats[2] = sorted[(int)((n - 1) * 0.99 + 0.5)];
+	stats[3] = sorted[n - 1];
+}
+
+/*
+================
+Prof_Print
+================
+*/
+static void Prof_Print (FILE *f, char *line)
+{
+	if (f)
+		fputs (line, f);
+	else
+		Con_Printf ("%s", line);
+}
+
+/*
+================
+Prof_Report
+
+Writes to f, or the console if f is NULL
+================
+*/
+static void Prof_Report (FILE *f, qboolean histograms)
+{
+	profstat_t	*s;
+	char		line[256];
+	float		stats[4];
+	int			i, b;
+
+	Prof_Drain ();
+
+	sprintf (line, "%-22s %8s %9s %9s %9s %9s %9s %6s\n",
+		"scope", "count", "mean us", "p50", "p99", "p99.9", "max", "drop");
+	Prof_Print (f, line);
+
+	for (i=0, s=prof_stats ; i<NUM_PROF_SCOPES ; i++, s++)
+	{
+		if (!s->total)
+			sprintf (line, "%-22s %8i\n", s->name, 0);
+		else
+			sprintf (line, "%-22s %8u %9.2f %9.2f %9.2f %9.2f %9.2f %6u\n",
+				s->name, s->total, s->sum / s->total / 1000.0,
+				Prof_Percentile (s, 0.5), Prof_Percentile (s, 0.99),
+				Prof_Percentile (s, 0.999), s->max / 1000.0, s->dropped);
+		Prof_Print (f, line);
+	}
+
+	if (prof_windowfill)
+	{
+		sprintf (line, "\nlast %i frames, ms per frame\n"
+			"%-22s %9s %9s %9s %9s\n", prof_windowfill,
+			"scope", "mean", "p50", "p99", "max");
+		Prof_Print (f, line);
+
+		Prof_WindowStats (prof_framewindow, stats);
+		sprintf (line, "%-22s %9.3f %9.3f %9.3f %9.3f\n", "host frame",
+			stats[0], stats[1], stats[2], stats[3]);
+		Prof_Print (f, line);
+
+		for (i=0, s=prof_stats ; i<NUM_PROF_SCOPES ; i++, s++)
+		{
+			if (!s->total)
+				continue;
+			Prof_WindowStats (s->window, stats);
+			sprintf (line, "%-22s %9.3f %9.3f %9.3f %9.3f\n", s->name,
+				stats[0], stats[1], stats[2], stats[3]);
+			Prof_Print (f, line);
+		}
+	}
+
+	if (!f || !histograms)
+		return;
+
+	for (i=0, s=prof_stats ; i<NUM_PROF_SCOPES ; i++, s++)
+	{
+		if (!s->total)
+			continue;
+		fprintf (f, "\n%s histogram (us upper bound, count)\n", s->name);
+		for (b=0 ; b<PROF_BUCKETS ; b++)
+			if (s->counts[b])
+				fprintf (f, "%12.3f %10u\n", Prof_BucketValue (b) / 1000.0, s->counts[b]);
+	}
+}
+
+/*
+================
+Prof_Report_f
+================
+*/
+static void Prof_Report_f (void)
+{
+	if (!prof.value)
+		Con_Printf ("profiling is off, set prof 1\n");
+	Prof_Report (NULL, false);
+}
+
+/*
+================
+Prof_Dump_f
+
+prof_dump [filename]
+================
+*/
+static void Prof_Dump_f (void)
+{
+	char	name[MAX_OSPATH];
+	FILE	*f;
+
+	if (Cmd_Argc () > 1)
+		snprintf (name, sizeof(name), "%s/%s", com_gamedir, Cmd_Argv (1));
+	else
+		snprintf (name, sizeof(name), "%s/prof.txt", com_gamedir);
+
+	f = fopen (name, "w");
+	if (!f)
+	{
+		Con_Printf ("couldn't open %s\n", name);
+		return;
+	}
+	Prof_Report (f, true);
+	fclose (f);
+	Con_Printf ("wrote %s\n", name);
+}
+
+/*
+================
+Prof_Reset_f
+================
+*/
+static void Prof_Reset_f (void)
+{
+	profstat_t	*s;
+	int			i;
+
+	for (i=0, s=prof_stats ; i<NUM_PROF_SCOPES ; i++, s++)
+	{
+		PROF_STORERELEASE (&s->tail, PROF_LOADACQUIRE (&s->head));
+		s->dropped = 0;
+		memset (s->counts, 0, sizeof(s->counts));
+		s->total = 0;
+		s->sum = 0;
+		s->max = 0;
+		s->framesum = 0;
+	}
+	prof_windowpos = prof_windowfill = 0;
+	prof_lastframe = 0;
+}
+
+/*
+================
+Prof_StopTrace
+================
+*/
+static void Prof_StopTrace (void)
+{
+	profstat_t	*s;
+	int			i;
+
+	prof_tracing = false;
+	prof_traceframes = 0;
+	for (i=0, s=prof_stats ; i<NUM_PROF_SCOPES ; i++, s++)
+	{
+		free (s->trace);
+		s->trace = NULL;
+		s->numtrace = 0;
+		s->tracedropped = 0;
+	}
+	free (prof_traceframetimes);
+	prof_traceframetimes = NULL;
+	prof_numtraceframes = 0;
+}
+
+/*
+================
+Prof_WriteTrace
+
+Chrome trace event format, with every timed call as a complete event and
+every host frame as an instant event; timestamps are in microseconds
+================
+*/
+static void Prof_WriteTrace (void)
+{
+	profstat_t			*s;
+	proftraceevent_t	*ev;
+	FILE				*f;
+	int					i, events, dropped;
+	unsigned			j;
+
+	f = fopen (prof_tracename, "w");
+	if (!f)
+	{
+		Con_Printf ("couldn't open %s\n", prof_tracename);
+		Prof_StopTrace ();
+		return;
+	}
+
+	fprintf (f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf (f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,"
+		"\"args\":{\"name\":\"main\"}},\n");
+	fprintf (f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,"
+		"\"args\":{\"name\":\"server\"}}");
+
+	for (i=0 ; i<prof_numtraceframes ; i++)
+		fprintf (f, ",\n{\"name\":\"frame\",\"ph\":\"i\",\"s\":\"g\","
+			"\"ts\":%.3f,\"pid\":1,\"tid\":1}",
+			(prof_traceframetimes[i] - prof_tracestart) * 1000000.0);
+
+	events = dropped = 0;
+	for (i=0, s=prof_stats ; i<NUM_PROF_SCOPES ; i++, s++)
+	{
+		for (j=0, ev=s->trace ; j<s->numtrace ; j++, ev++)
+			fprintf (f, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\","
+				"\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%i}",
+				s->name, i >= PROF_FIRSTRENDER ? "render" : "host",
+				(ev->start - prof_tracestart) * 1000000.0, ev->ns / 1000.0,
+				ev->thread);
+		events += s->numtrace;
+		dropped += s->tracedropped;
+	}
+
+	fprintf (f, "\n]}\n");
+	fclose (f);
+
+	Con_Printf ("wrote %s, %i frames, %i events", prof_tracename,
+		prof_numtraceframes, events);
+	if (dropped)
+		Con_Printf (", %i dropped", dropped);
+	Con_Printf ("\n");
+
+	Prof_StopTrace ();
+}
+
+/*
+================
+Prof_Frame
+================
+*/
+void Prof_Frame (void)
+{
+	profstat_t	*s;
+	double		now;
+	int			i;
+
+	if (!prof.value && !prof_tracing)
+	{
+		prof_lastframe = 0;
+		return;
+	}
+
+	now = Sys_FloatTime ();
+
+	if (prof.value && prof_lastframe)
+	{
+		prof_framewindow[prof_windowpos] = (now - prof_lastframe) * 1000;
+		for (i=0, s=prof_stats ; i<NUM_PROF_SCOPES ; i++, s++)
+			s->window[prof_windowpos] = s->framesum / 1000000.0;
+
+		prof_windowpos = (prof_windowpos + 1) & (PROF_WINDOW - 1);
+		if (prof_windowfill < PROF_WINDOW)
+			prof_windowfill++;
+	}
+	for (i=0, s=prof_stats ; i<NUM_PROF_SCOPES ; i++, s++)
+		s->framesum = 0;
+	prof_lastframe = now;
+
+	if (prof_tracing)
+	{
+		prof_traceframetimes[prof_numtraceframes++] = now;
+		if (--prof_traceframes <= 0)
+			Prof_WriteTrace ();
+	}
+}
+
+/*
+================
+Prof_Trace_f
+
+prof_trace [frames] [filename]
+================
+*/
+static void Prof_Trace_f (void)
+{
+	profstat_t	*s;
+	int			i, frames;
+
+	if (prof_tracing)
+		Prof_StopTrace ();
+
+	frames = 100;
+	if (Cmd_Argc () > 1)
+		frames = Q_atoi (Cmd_Argv (1));
+	if (frames < 1)
+		frames = 1;
+
+	if (Cmd_Argc () > 2)
+		snprintf (prof_tracename, sizeof(prof_tracename), "%s/%s", com_gamedir, Cmd_Argv (2));
+	else
+		snprintf (prof_tracename, sizeof(prof_tracename), "%s/trace.json", com_gamedir);
+
+	for (i=0, s=prof_stats ; i<NUM_PROF_SCOPES ; i++, s++)
+	{
+		s->trace = malloc (PROF_TRACEEVENTS * sizeof(*s->trace));
+		if (!s->trace)
+		{
+			Con_Printf ("not enough memory for a trace\n");
+			Prof_StopTrace ();
+			return;
+		}
+	}
+	prof_traceframetimes = malloc (frames * sizeof(*prof_traceframetimes));
+	if (!prof_traceframetimes)
+	{
+		Con_Printf ("not enough memory for a trace\n");
+		Prof_StopTrace ();
+		return;
+	}
+
+	prof_traceframes = frames;
+	prof_tracestart = Sys_FloatTime ();
+	prof_tracing = true;
+	Con_Printf ("tracing %i frames\n", frames);
+}
+
+/*
+================
+Prof_DrawOverlay
+================
+*/
+qboolean Prof_DrawOverlay (void)
+{
+	profstat_t	*s;
+	char		line[64];
+	float		stats[4];
+	int			i, y;
+
+	if (!prof_overlay.value || !prof.value)
+		return false;
+
+	y = 8;
+	sprintf (line, "%-21s%6s%6s%6s", "ms/frame", "mean", "p50", "p99");
+	Draw_String (8, y, line);
+	y += 8;
+
+	Prof_WindowStats (prof_framewindow, stats);
+	sprintf (line, "%-21s%6.2f%6.2f%6.2f", "host frame", stats[0], stats[1],
+		stats[2]);
+	Draw_String (8, y, line);
+	y += 8;
+
+	for (i=PROF_FIRSTRENDER, s=&prof_stats[i] ; i<NUM_PROF_SCOPES ; i++, s++)
+	{
+		Prof_WindowStats (s->window, stats);
+		sprintf (line, "%-21.21s%6.2f%6.2f%6.2f", s->name, stats[0],
+			stats[1], stats[2]);
+		Draw_String (8, y, line);
+		y += 8;
+	}
+
+	return true;
+}
+
+/*
+================
+Prof_Init
+================
+*/
+void Prof_Init (void)
+{
+	int		i;
+
+	for (i=0 ; i<NUM_PROF_SCOPES ; i++)
+		prof_stats[i].name = prof_names[i];
+
+	Cvar_RegisterVariable (&prof);
+	Cvar_RegisterVariable (&prof_overlay);
+	Cmd_AddCommand ("prof_report", Prof_Report_f);
+	Cmd_AddCommand ("prof_dump", Prof_Dump_f);
+	Cmd_AddCommand ("prof_reset", Prof_Reset_f);
+	Cmd_AddCommand ("prof_trace", Prof_Trace_f);
+}
@@ -0,0 +1,67 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// prof.h -- named timing scopes with latency histograms
+
+typedef enum
+{
+	PROF_SERVERFRAME,
+	PROF_PHYSICS,
+	PROF_SENDMESSAGES,
+	PROF_EXECUTEPROGRAM,
+	PROF_MOVE,
+	PROF_NETPOLL,
+	PROF_SURFBUILD,
+
+// the refresh stages, all on the main thread; they nest, so the outer
+// stages include the time of the ones they call
+	PROF_RENDERVIEW,
+	PROF_MARKLEAVES,
+	PROF_WORLDBSP,
+	PROF_BMODELS,
+	PROF_EDGESCAN,
+	PROF_SURFCACHE,
+	PROF_SPANDRAW,
+	PROF_ENTITIES,
+	PROF_PARTICLES,
+	PROF_VIEWBLEND,
+	NUM_PROF_SCOPES
+} profscope_t;
+
+#define	PROF_FIRSTRENDER	PROF_RENDERVIEW
+
+void Prof_Init (void);
+
+double Prof_Begin (void);
+void Prof_End (profscope_t scope, double start);
+// Prof_Begin returns 0 when profiling is off, and Prof_End then records
+// nothing, so a scope that straddles "prof 1" is never half timed
+
+void Prof_Drain (void);
+// moves the samples waiting in the rings into the histograms, call at the
+// end of each frame on whichever thread owns the host lock
+
+void Prof_Frame (void);
+// closes a host frame: pushes every scope's time for the frame into its
+// rolling window and advances a running prof_trace, call right after the
+// Prof_Drain that ends the frame on the main thread
+
+qboolean Prof_DrawOverlay (void);
+// prof_overlay 1 draws the refresh stages' rolling times in the top left
+// corner of the screen, returns true if it drew anything
@@ -73,11 +73,35 @@ void	VID_UnlockBuffer (void);
 #define UNALIGNED_OK	0
 #endif
 
+// vector instruction sets the portable C paths can use through intrinsics
+#if !id386 && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define idSSE2	1
+#include <emmintrin.h>
+#else
+#define idSSE2	0
+#endif
+
+#if !id386 && (defined(__aarch64__) || defined(_M_ARM64))
+#define idNEON	1
+#include <arm_neon.h>
+#else
+#define idNEON	0
+#endif
+
+#define idSIMD	(idSSE2 || idNEON)
+
 // !!! if this is changed, it must be changed in d_ifacea.h too !!!
 #define CACHE_SIZE	32		// used to align key data structures
 
 #define UNUSED(x)	(x = x)	// for pesky compiler / lint warnings
 
+// per-thread storage, for rasterizer state the span drawers share
+#ifdef _MSC_VER
+#define THREADLOCAL	__declspec(thread)
+#else
+#define THREADLOCAL	__thread
+#endif
+
 #define	MINIMUM_MEMORY			0x550000
 #define	MINIMUM_MEMORY_LEVELPAK	(MINIMUM_MEMORY + 0x100000)
 
@@ -257,6 +281,7 @@ typedef struct
 #include "menu.h"
 #include "crc.h"
 #include "cdaudio.h"
+#include "prof.h"
 
 #ifdef GLQUAKE
 #include "glquake.h"
@@ -296,6 +321,8 @@ extern	cvar_t		sys_nostdout;
 extern	cvar_t		developer;
 
 extern	qboolean	host_initialized;		// true if into command execution
+extern	qboolean	host_headless;			// client with no display or keyboard
+extern	int			host_exitcode;			// passed to exit by Sys_Quit
 extern	double		host_frametime;
 extern	byte		*host_basepal;
 extern	byte		*host_colormap;
@@ -304,10 +331,11 @@ extern	double		realtime;			// not bounded in any way, changed at
 										// start of every frame, never reset
 
 void Host_ClearMemory (void);
-void Host_ServerFrame (void);
+void Host_ServerFrame (double frametime);
 void Host_InitCommands (void);
 void Host_Init (quakeparms_t *parms);
 void Host_Shutdown(void);
+void Host_StopServerThread (void);
 void Host_Error (char *error, ...);
 void Host_EndGame (char *message, ...);
 void Host_Frame (float time);
@@ -72,12 +72,17 @@ float	r_avertexnormals[NUMVERTEXNORMALS][3] = {
 #include "anorms.h"
 };
 
+static int	r_alightvals[NUMVERTEXNORMALS];	// vertex light for each normal,
+											//  set up for each model drawn
+
 void R_AliasTransformAndProjectFinalVerts (finalvert_t *fv,
 	stvert_t *pstverts);
 void R_AliasSetUpTransform (int trivial_accept);
 void R_AliasTransformVector (vec3_t in, vec3_t out);
 void R_AliasTransformFinalVert (finalvert_t *fv, auxvert_t *av,
 	trivertx_t *pverts, stvert_t *pstverts);
+void R_AliasTransformFinalVerts (finalvert_t *fv, auxvert_t *av,
+	stvert_t *pstverts);
 void R_AliasProjectFinalVert (finalvert_t *fv, auxvert_t *av);
 
 
@@ -91,6 +96,7 @@ qboolean R_AliasCheckBBox (void)
 	int					i, flags, frame, numv;
 	aliashdr_t			*pahdr;
 	float				zi, basepts[8][3], v0, v1, frac;
+	float				umin, vmin, umax, vmax, zimax;
 	finalvert_t			*pv0, *pv1, viewpts[16];
 	auxvert_t			*pa0, *pa1, viewaux[16];
 	maliasframedesc_t	*pframedesc;
@@ -199,6 +205,9 @@ qboolean R_AliasCheckBBox (void)
 // project the vertices that remain after clipping
 	anyclip = 0;
 	allclip = ALIAS_XY_CLIP_MASK;
+	umin = vmin = 999999;
+	umax = vmax = -999999;
+	zimax = 0;
 
 // TODO: probably should do this loop in ASM, especially if we use floats
 	for (i=0 ; i<numv ; i++)
@@ -213,6 +222,17 @@ qboolean R_AliasCheckBBox (void)
 		v0 = (viewaux[i].fv[0] * xscale * zi) + xcenter;
 		v1 = (viewaux[i].fv[1] * yscale * zi) + ycenter;
 
+		if (v0 < umin)
+			umin = v0;
+		if (v0 > umax)
+			umax = v0;
+		if (v1 < vmin)
+			vmin = v1;
+		if (v1 > vmax)
+			vmax = v1;
+		if (zi > zimax)
+			zimax = zi;
+
 		flags = 0;
 
 		if (v0 < r_refdef.fvrectx)
@@ -231,6 +251,16 @@ qboolean R_AliasCheckBBox (void)
 	if (allclip)
 		return false;	// trivial reject off one side
 
+// nothing in the model is nearer than the nearest corner of its box, so if
+// the world is in front of that everywhere the box covers, it's hidden
+	if (!zclipped && r_occlusion.value && (currententity != &cl.viewent) &&
+		D_Occluded ((int)umin - 1, (int)vmin - 1, (int)umax + 1,
+			(int)vmax + 1, (int)(zimax * 0x8000) + 1))
+	{
+		r_occluded++;
+		return false;
+	}
+
 	currententity->trivial_accept = !anyclip & !zclipped;
 
 	if (currententity->trivial_accept)
@@ -279,9 +309,10 @@ void R_AliasPreparePoints (void)
  	fv = pfinalverts;
 	av = pauxverts;
 
-	for (i=0 ; i<r_anumverts ; i++, fv++, av++, r_apverts++, pstverts++)
+	R_AliasTransformFinalVerts (fv, av, pstverts);
+
+	for (i=0 ; i<r_anumverts ; i++, fv++, av++)
 	{
-		R_AliasTransformFinalVert (fv, av, r_apverts, pstverts);
 		if (av->fv[2] < ALIAS_Z_CLIP_PLANE)
 			fv->flags |= ALIAS_Z_CLIP;
 		else
@@ -415,9 +446,6 @@ R_AliasTransformFinalVert
 void R_AliasTransformFinalVert (finalvert_t *fv, auxvert_t *av,
 	trivertx_t *pverts, stvert_t *pstverts)
 {
-	int		temp;
-	float	lightcos, *plightnormal;
-
 	av->fv[0] = DotProduct(pverts->v, aliastransform[0]) +
 			aliastransform[0][3];
 	av->fv[1] = DotProduct(pverts->v, aliastransform[1]) +
@@ -429,23 +457,227 @@ void R_AliasTransformFinalVert (finalvert_t *fv, auxvert_t *av,
 	fv->v[3] = pstverts->t;
 
 	fv->flags = pstverts->onseam;
+	fv->v[4] = r_alightvals[pverts->lightnormalindex];
+}
+
+
+#if idSIMD
+
+/*
+================
+R_AliasStoreVerts4
+
+The parts of four final verts that come straight from the model
+================
+*/
+static void R_AliasStoreVerts4 (finalvert_t *fv, trivertx_t *pverts,
+	stvert_t *pstverts)
+{
+	int		k;
+
+	for (k=0 ; k<4 ; k++)
+	{
+		fv[k].v[2] = pstverts[k].s;
+		fv[k].v[3] = pstverts[k].t;
+		fv[k].flags = pstverts[k].onseam;
+		fv[k].v[4] = r_alightvals[pverts[k].lightnormalindex];
+	}
+}
+
+
+/*
+================
+R_AliasTransformVertsSIMD
+
+Transforms the verts four at a time, with the four trivertx_t unpacked
+straight into x, y and z lanes, and returns how many it did.  The products
+and sums are made in the same order as DotProduct, unfused, so the results
+are exactly those of R_AliasTransformFinalVert.  A blend between two poses
+would lerp the unpacked lanes here, before the transform.
+================
+*/
+static int R_AliasTransformVertsSIMD (finalvert_t *fv, auxvert_t *av,
+	trivertx_t *pverts, stvert_t *pstverts, int numverts)
+{
+	int		i, k;
+	float	out[3][4];
 
-// lighting
-	plightnormal = r_avertexnormals[pverts->lightnormalindex];
-	lightcos = DotProduct (plightnormal, r_plightvec);
-	temp = r_ambientlight;
+#if idNEON
+	float32x4_t	m[3][4], x, y, z;
+	uint32x4_t	raw, mask;
 
-	if (lightcos < 0)
+	for (i=0 ; i<3 ; i++)
+		for (k=0 ; k<4 ; k++)
+			m[i][k] = vdupq_n_f32 (aliastransform[i][k]);
+	mask = vdupq_n_u32 (0xff);
+
+	for (i=0 ; i+4 <= numverts ; i+=4, fv+=4, av+=4, pverts+=4, pstverts+=4)
+	{
+		raw = vld1q_u32 ((unsigned *)pverts);
+		x = vcvtq_f32_u32 (vandq_u32 (raw, mask));
+		y = vcvtq_f32_u32 (vandq_u32 (vshrq_n_u32 (raw, 8), mask));
+		z = vcvtq_f32_u32 (vandq_u32 (vshrq_n_u32 (raw, 16), mask));
+
+		for (k=0 ; k<3 ; k++)
+			vst1q_f32 (out[k], vaddq_f32 (vaddq_f32 (vaddq_f32 (
+					vmulq_f32 (x, m[k][0]), vmulq_f32 (y, m[k][1])),
+					vmulq_f32 (z, m[k][2])), m[k][3]));
+#else
+	__m128		m[3][4], x, y, z;
+	__m128i		raw, mask;
+
+	for (i=0 ; i<3 ; i++)
+		for (k=0 ; k<4 ; k++)
+			m[i][k] = _mm_set1_ps (aliastransform[i][k]);
+	mask = _mm_set1_epi32 (0xff);
+
+	for (i=0 ; i+4 <= numverts ; i+=4, fv+=4, av+=4, pverts+=4, pstverts+=4)
 	{
-		temp += (int)(r_shadelight * lightcos);
+		raw = _mm_loadu_si128 ((__m128i *)pverts);
+		x = _mm_cvtepi32_ps (_mm_and_si128 (raw, mask));
+		y = _mm_cvtepi32_ps (_mm_and_si128 (_mm_srli_epi32 (raw, 8), mask));
+		z = _mm_cvtepi32_ps (_mm_and_si128 (_mm_srli_epi32 (raw, 16), mask));
+
+		for (k=0 ; k<3 ; k++)
+			_mm_storeu_ps (out[k], _mm_add_ps (_mm_add_ps (_mm_add_ps (
+					_mm_mul_ps (x, m[k][0]), _mm_mul_ps (y, m[k][1])),
+					_mm_mul_ps (z, m[k][2])), m[k][3]));
+#endif
+
+		for (k=0 ; k<4 ; k++)
+		{
+			av[k].fv[0] = out[0][k];
+			av[k].fv[1] = out[1][k];
+			av[k].fv[2] = out[2][k];
+		}
+		R_AliasStoreVerts4 (fv, pverts, pstverts);
+	}
+
+	return i;
+}
+
+
+/*
+================
+R_AliasProjectVertsSIMD
+
+The trivially accepted case of R_AliasTransformVertsSIMD, projecting as it
+goes.  1/z is a single precision divide, which gives the same float as the
+scalar double divide rounded back down.
+================
+*/
+static int R_AliasProjectVertsSIMD (finalvert_t *fv, trivertx_t *pverts,
+	stvert_t *pstverts, int numverts)
+{
+	int		i, k;
+	int		out[3][4];
+
+#if idNEON
+	float32x4_t	m[3][4], x, y, z, zi, xcenter, ycenter;
+	uint32x4_t	raw, mask;
+
+	for (i=0 ; i<3 ; i++)
+		for (k=0 ; k<4 ; k++)
+			m[i][k] = vdupq_n_f32 (aliastransform[i][k]);
+	mask = vdupq_n_u32 (0xff);
+	xcenter = vdupq_n_f32 (aliasxcenter);
+	ycenter = vdupq_n_f32 (aliasycenter);
+
+	for (i=0 ; i+4 <= numverts ; i+=4, fv+=4, pverts+=4, pstverts+=4)
+	{
+		raw = vld1q_u32 ((unsigned *)pverts);
+		x = vcvtq_f32_u32 (vandq_u32 (raw, mask));
+		y = vcvtq_f32_u32 (vandq_u32 (vshrq_n_u32 (raw, 8), mask));
+		z = vcvtq_f32_u32 (vandq_u32 (vshrq_n_u32 (raw, 16), mask));
+
+		zi = vdivq_f32 (vdupq_n_f32 (1), vaddq_f32 (vaddq_f32 (vaddq_f32 (
+				vmulq_f32 (x, m[2][0]), vmulq_f32 (y, m[2][1])),
+				vmulq_f32 (z, m[2][2])), m[2][3]));
+		vst1q_s32 (out[2], vcvtq_s32_f32 (zi));
+		vst1q_s32 (out[0], vcvtq_s32_f32 (vaddq_f32 (vmulq_f32 (
+				vaddq_f32 (vaddq_f32 (vaddq_f32 (
+				vmulq_f32 (x, m[0][0]), vmulq_f32 (y, m[0][1])),
+				vmulq_f32 (z, m[0][2])), m[0][3]), zi), xcenter)));
+		vst1q_s32 (out[1], vcvtq_s32_f32 (vaddq_f32 (vmulq_f32 (
+				vaddq_f32 (vaddq_f32 (vaddq_f32 (
+				vmulq_f32 (x, m[1][0]), vmulq_f32 (y, m[1][1])),
+				vmulq_f32 (z, m[1][2])), m[1][3]), zi), ycenter)));
+#else
+	__m128		m[3][4], x, y, z, zi, xcenter, ycenter;
+	__m128i		raw, mask;
+
+	for (i=0 ; i<3 ; i++)
+		for (k=0 ; k<4 ; k++)
+			m[i][k] = _mm_set1_ps (aliastransform[i][k]);
+	mask = _mm_set1_epi32 (0xff);
+	xcenter = _mm_set1_ps (aliasxcenter);
+	ycenter = _mm_set1_ps (aliasycenter);
+
+	for (i=0 ; i+4 <= numverts ; i+=4, fv+=4, pverts+=4, pstverts+=4)
+	{
+		raw = _mm_loadu_si128 ((__m128i *)pverts);
+		x = _mm_cvtepi32_ps (_mm_and_si128 (raw, mask));
+		y = _mm_cvtepi32_ps (_mm_and_si128 (_mm_srli_epi32 (raw, 8), mask));
+		z = _mm_cvtepi32_ps (_mm_and_si128 (_mm_srli_epi32 (raw, 16), mask));
+
+		zi = _mm_div_ps (_mm_set1_ps (1), _mm_add_ps (_mm_add_ps (_mm_add_ps (
+				_mm_mul_ps (x, m[2][0]), _mm_mul_ps (y, m[2][1])),
+				_mm_mul_ps (z, m[2][2])), m[2][3]));
+		_mm_storeu_si128 ((__m128i *)out[2], _mm_cvttps_epi32 (zi));
+		_mm_storeu_si128 ((__m128i *)out[0], _mm_cvttps_epi32 (_mm_add_ps (
+				_mm_mul_ps (_mm_add_ps (_mm_add_ps (_mm_add_ps (
+				_mm_mul_ps (x, m[0][0]), _mm_mul_ps (y, m[0][1])),
+				_mm_mul_ps (z, m[0][2])), m[0][3]), zi), xcenter)));
+		_mm_storeu_si128 ((__m128i *)out[1], _mm_cvttps_epi32 (_mm_add_ps (
+				_mm_mul_ps (_mm_add_ps (_mm_add_ps (_mm_add_ps (
+				_mm_mul_ps (x, m[1][0]), _mm_mul_ps (y, m[1][1])),
+				_mm_mul_ps (z, m[1][2])), m[1][3]), zi), ycenter)));
+#endif
+
+		for (k=0 ; k<4 ; k++)
+		{
+			fv[k].v[0] = out[0][k];
+			fv[k].v[1] = out[1][k];
+			fv[k].v[5] = out[2][k];
+		}
+		R_AliasStoreVerts4 (fv, pverts, pstverts);
+	}
+
+	return i;
+}
+
+#endif	// idSIMD
+
+
+/*
+================
+R_AliasTransformFinalVerts
+
+All of the verts of r_apverts, for the clipped case
+================
+*/
+void R_AliasTransformFinalVerts (finalvert_t *fv, auxvert_t *av,
+	stvert_t *pstverts)
+{
+	int			i;
+	trivertx_t	*pverts;
+
+	pverts = r_apverts;
 
-	// clamp; because we limited the minimum ambient and shading light, we
-	// don't have to clamp low light, just bright
-		if (temp < 0)
-			temp = 0;
+	i = 0;
+#if idSIMD
+	if (d_simd.value)
+	{
+		i = R_AliasTransformVertsSIMD (fv, av, pverts, pstverts, r_anumverts);
+		fv += i;
+		av += i;
+		pverts += i;
+		pstverts += i;
 	}
+#endif
 
-	fv->v[4] = temp;
+	for ( ; i<r_anumverts ; i++, fv++, av++, pverts++, pstverts++)
+		R_AliasTransformFinalVert (fv, av, pverts, pstverts);
 }
 
 
@@ -458,13 +690,24 @@ R_AliasTransformAndProjectFinalVerts
 */
 void R_AliasTransformAndProjectFinalVerts (finalvert_t *fv, stvert_t *pstverts)
 {
-	int			i, temp;
-	float		lightcos, *plightnormal, zi;
+	int			i;
+	float		zi;
 	trivertx_t	*pverts;
 
 	pverts = r_apverts;
 
-	for (i=0 ; i<r_anumverts ; i++, fv++, pverts++, pstverts++)
+	i = 0;
+#if idSIMD
+	if (d_simd.value)
+	{
+		i = R_AliasProjectVertsSIMD (fv, pverts, pstverts, r_anumverts);
+		fv += i;
+		pverts += i;
+		pstverts += i;
+	}
+#endif
+
+	for ( ; i<r_anumverts ; i++, fv++, pverts++, pstverts++)
 	{
 	// transform and project
 		zi = 1.0 / (DotProduct(pverts->v, aliastransform[2]) +
@@ -483,23 +726,7 @@ void R_AliasTransformAndProjectFinalVerts (finalvert_t *fv, stvert_t *pstverts)
 		fv->v[2] = pstverts->s;
 		fv->v[3] = pstverts->t;
 		fv->flags = pstverts->onseam;
-
-	// lighting
-		plightnormal = r_avertexnormals[pverts->lightnormalindex];
-		lightcos = DotProduct (plightnormal, r_plightvec);
-		temp = r_ambientlight;
-
-		if (lightcos < 0)
-		{
-			temp += (int)(r_shadelight * lightcos);
-
-		// clamp; because we limited the minimum ambient and shading light, we
-		// don't have to clamp low light, just bright
-			if (temp < 0)
-				temp = 0;
-		}
-
-		fv->v[4] = temp;
+		fv->v[4] = r_alightvals[pverts->lightnormalindex];
 	}
 }
 
@@ -616,6 +843,8 @@ R_AliasSetupLighting
 */
 void R_AliasSetupLighting (alight_t *plighting)
 {
+	int		i, temp;
+	float	lightcos;
 
 // guarantee that no vertex will ever be lit below LIGHT_MIN, so we don't have
 // to clamp off the bottom
@@ -640,6 +869,25 @@ void R_AliasSetupLighting (alight_t *plighting)
 	r_plightvec[0] = DotProduct (plighting->plightvec, alias_forward);
 	r_plightvec[1] = -DotProduct (plighting->plightvec, alias_right);
 	r_plightvec[2] = DotProduct (plighting->plightvec, alias_up);
+
+// light each of the normals once, so the vertices only look their light up
+	for (i=0 ; i<NUMVERTEXNORMALS ; i++)
+	{
+		lightcos = DotProduct (r_avertexnormals[i], r_plightvec);
+		temp = r_ambientlight;
+
+		if (lightcos < 0)
+		{
+			temp += (int)(r_shadelight * lightcos);
+
+		// clamp; because we limited the minimum ambient and shading light,
+		// we don't have to clamp low light, just bright
+			if (temp < 0)
+				temp = 0;
+		}
+
+		r_alightvals[i] = temp;
+	}
 }
 
 /*
@@ -751,3 +999,139 @@ void R_AliasDrawModel (alight_t *plighting)
 		R_AliasPreparePoints ();
 }
 
+
+
+/*
+================
+R_AliasTimeTransforms
+
+Best of passes runs of just the trivially accepted vertex transform over
+the entities, with the view's transform but without drawing anything
+================
+*/
+static double R_AliasTimeTransforms (entity_t **ents, int numents, int passes)
+{
+	finalvert_t	finalverts[MAXALIASVERTS];
+	alight_t	lighting;
+	float		lightvec[3] = {-1, 0, 0};
+	int			i, pass;
+	double		start, time, best;
+
+	lighting.ambientlight = 64;
+	lighting.shadelight = 64;
+	lighting.plightvec = lightvec;
+
+	best = 1e9;
+	for (pass=0 ; pass<passes ; pass++)
+	{
+		start = Sys_FloatTime ();
+		for (i=0 ; i<numents ; i++)
+		{
+			currententity = ents[i];
+			VectorSubtract (r_origin, currententity->origin, modelorg);
+
+			paliashdr = (aliashdr_t *)Mod_Extradata (currententity->model);
+			pmdl = (mdl_t *)((byte *)paliashdr + paliashdr->model);
+			r_anumverts = pmdl->numverts;
+
+			R_AliasSetUpTransform (1);
+			R_AliasSetupLighting (&lighting);
+			R_AliasSetupFrame ();
+			R_AliasTransformAndProjectFinalVerts (finalverts,
+					(stvert_t *)((byte *)paliashdr + paliashdr->stverts));
+		}
+		time = Sys_FloatTime () - start;
+		if (time < best)
+			best = time;
+	}
+	return best;
+}
+
+
+static entity_t	**r_aliasbenchents;
+static int		r_aliasbenchcount, r_aliasbenchpasses, r_aliasbenchdrawn;
+static double	r_aliasbenchtime[2], r_aliasbenchtransform[2];
+
+/*
+================
+R_AliasBenchRun
+================
+*/
+static void R_AliasBenchRun (int mode)
+{
+	double	world;
+
+	world = R_TimeView (NULL, 0, r_aliasbenchpasses);
+	r_aliasbenchtime[mode] = R_TimeView (r_aliasbenchents, r_aliasbenchcount,
+			r_aliasbenchpasses) - world;
+	r_aliasbenchdrawn = r_amodels_drawn;
+	r_aliasbenchtransform[mode] = R_AliasTimeTransforms (r_aliasbenchents,
+			r_aliasbenchcount, r_aliasbenchpasses);
+}
+
+
+/*
+================
+R_AliasBench_f
+
+r_aliasbench [model] [count] [passes]
+
+Stands a crowd of count copies of an alias model in front of the current
+view and renders it with the scalar and then the vector vertex transform,
+best of the given number of passes each, less the time for the view without
+the crowd, and checks that both draw the same pixels.  The transform is also
+timed on its own, since drawing a crowd close up is mostly rasterization,
+and the crowd's triangles are captured and rasterized on their own by both
+triangle rasterizers.
+================
+*/
+void R_AliasBench_f (void)
+{
+	model_t		*model;
+	char		*name;
+	int			i, count, passes, numverts, differ;
+
+	if (!R_BenchArgs ("progs/player.mdl", &name, &count, &passes))
+		return;
+
+	model = Mod_ForName (name, false);
+	if (!model || model->type != mod_alias)
+	{
+		Con_Printf ("r_aliasbench: %s is not an alias model\n", name);
+		return;
+	}
+
+// rows of the crowd, starting a little way in front of the view and facing
+// every which way, so both the clipped and the unclipped paths get used
+	r_aliasbenchents = R_BenchCrowd (model, count, model->radius * 8,
+			model->radius * 3);
+	for (i=0 ; i<count ; i++)
+	{
+		r_aliasbenchents[i]->frame = i % model->numframes;
+		r_aliasbenchents[i]->colormap = vid.colormap;
+	}
+	r_aliasbenchcount = count;
+	r_aliasbenchpasses = passes;
+
+	numverts = ((mdl_t *)((byte *)Mod_Extradata (model) +
+			((aliashdr_t *)Mod_Extradata (model))->model))->numverts;
+
+	differ = R_BenchModes ("d_simd", R_AliasBenchRun, vid.buffer,
+			vid.rowbytes * vid.height);
+
+	D_PolysetBeginCapture ();
+	R_TimeView (r_aliasbenchents, count, 1);
+
+	R_BenchRestoreEdicts ();
+
+	Con_Printf ("%i of %i %s drawn, %i verts each, %i passes\n",
+			r_aliasbenchdrawn, count, name, numverts, passes);
+	Con_Printf ("scalar: %.3f ms, transform %.3f ms\n",
+			r_aliasbenchtime[0] * 1000, r_aliasbenchtransform[0] * 1000);
+#if idSIMD
+	Con_Printf ("simd:   %.3f ms, transform %.3f ms, %s\n",
+			r_aliasbenchtime[1] * 1000, r_aliasbenchtransform[1] * 1000,
+			R_BenchVerdict (differ));
+#endif
+	D_PolysetBench (passes);
+}
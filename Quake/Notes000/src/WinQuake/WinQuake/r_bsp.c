@@ -41,17 +41,44 @@ int				r_currentbkey;
 
 typedef enum {touchessolid, drawnode, nodrawnode} solidstate_t;
 
-#define MAX_BMODEL_VERTS	500			// 6K
-#define MAX_BMODEL_EDGES	1000		// 12K
-
 static mvertex_t	*pbverts;
 static bedge_t		*pbedges;
-static int			numbverts, numbedges;
+static int			numbverts, numbedges, numbpolys;
 
 static mvertex_t	*pfrontenter, *pfrontexit;
 
 static qboolean		makeclippededge;
 
+// fragments of the submodel's polygons that got to leafs, in the order they
+// got there
+static bpoly_t		*r_bfragments, **r_bfragtail;
+static int			r_numbfragments;
+
+cvar_t	r_bmodelbatch = {"r_bmodelbatch", "1"};
+
+//
+// the world's node and leaf bounding boxes as floats, flattened into one
+// array (nodes, then leafs) so the four frustum planes can be tested against
+// a box at once
+//
+typedef struct
+{
+	float	mins[4], maxs[4];	// [3] is padding
+} nodebounds_t;
+
+static nodebounds_t	*r_nodebounds;
+
+int				r_nodesvisited;		// got past the PVS, so were frustum tested
+int				r_nodesculled;		// of those, rejected by the frustum
+int				r_pvsnodes;			// in the PVS of the view leaf
+
+#if idSIMD
+// the frustum planes a lane each, with each normal split by sign, so the
+// reject and accept points are picked by multiplying the box's mins and maxs
+// through, one of each pair of products being zero
+static float	r_frustumneg[3][4], r_frustumpos[3][4], r_frustumdist[4];
+#endif
+
 
 //===========================================================================
 
@@ -152,31 +179,25 @@ void R_RotateBmodel (void)
 
 /*
 ================
-R_RecursiveClipBPoly
+R_ClipBPolyToPlane
+
+Splits a polygon's edges to the front and back of a BSP plane that's been
+brought into model space, adding the edges along the plane to both sides.
+Returns false if the clip pools ran out, which drops the polygon.
 ================
 */
-void R_RecursiveClipBPoly (bedge_t *pedges, mnode_t *pnode, msurface_t *psurf)
+static qboolean R_ClipBPolyToPlane (bedge_t *pedges, mplane_t *tplane,
+	bedge_t *psideedges[2])
 {
-	bedge_t		*psideedges[2], *pnextedge, *ptedge;
-	int			i, side, lastside;
+	bedge_t		*pnextedge, *ptedge;
+	int			side, lastside;
 	float		dist, frac, lastdist;
-	mplane_t	*splitplane, tplane;
 	mvertex_t	*pvert, *plastvert, *ptvert;
-	mnode_t		*pn;
 
 	psideedges[0] = psideedges[1] = NULL;
 
 	makeclippededge = false;
 
-// transform the BSP plane into model space
-// FIXME: cache these?
-	splitplane = pnode->plane;
-	tplane.dist = splitplane->dist -
-			DotProduct(r_entorigin, splitplane->normal);
-	tplane.normal[0] = DotProduct (entity_rotation[0], splitplane->normal);
-	tplane.normal[1] = DotProduct (entity_rotation[1], splitplane->normal);
-	tplane.normal[2] = DotProduct (entity_rotation[2], splitplane->normal);
-
 // clip edges to BSP plane
 	for ( ; pedges ; pedges = pnextedge)
 	{
@@ -185,8 +206,8 @@ void R_RecursiveClipBPoly (bedge_t *pedges, mnode_t *pnode, msurface_t *psurf)
 	// set the status for the last point as the previous point
 	// FIXME: cache this stuff somehow?
 		plastvert = pedges->v[0];
-		lastdist = DotProduct (plastvert->position, tplane.normal) -
-				   tplane.dist;
+		lastdist = DotProduct (plastvert->position, tplane->normal) -
+				   tplane->dist;
 
 		if (lastdist > 0)
 			lastside = 0;
@@ -195,7 +216,7 @@ void R_RecursiveClipBPoly (bedge_t *pedges, mnode_t *pnode, msurface_t *psurf)
 
 		pvert = pedges->v[1];
 
-		dist = DotProduct (pvert->position, tplane.normal) - tplane.dist;
+		dist = DotProduct (pvert->position, tplane->normal) - tplane->dist;
 
 		if (dist > 0)
 			side = 0;
@@ -205,8 +226,11 @@ void R_RecursiveClipBPoly (bedge_t *pedges, mnode_t *pnode, msurface_t *psurf)
 		if (side != lastside)
 		{
 		// clipped
-			if (numbverts >= MAX_BMODEL_VERTS)
-				return;
+			if (numbverts >= r_bvertsallocated)
+			{
+				r_outofbverts++;
+				return false;
+			}
 
 		// generate the clipped vertex
 			frac = lastdist / (lastdist - dist);
@@ -224,10 +248,10 @@ void R_RecursiveClipBPoly (bedge_t *pedges, mnode_t *pnode, msurface_t *psurf)
 		// split into two edges, one on each side, and remember entering
 		// and exiting points
 		// FIXME: share the clip edge by having a winding direction flag?
-			if (numbedges >= (MAX_BMODEL_EDGES - 1))
+			if (numbedges >= (r_bedgesallocated - 1))
 			{
-				Con_Printf ("Out of edges for bmodel\n");
-				return;
+				r_outofbedges += 2;
+				return false;
 			}
 
 			ptedge = &pbedges[numbedges];
@@ -268,10 +292,10 @@ void R_RecursiveClipBPoly (bedge_t *pedges, mnode_t *pnode, msurface_t *psurf)
 // plane to both sides (but in opposite directions)
 	if (makeclippededge)
 	{
-		if (numbedges >= (MAX_BMODEL_EDGES - 2))
+		if (numbedges >= (r_bedgesallocated - 2))
 		{
-			Con_Printf ("Out of edges for bmodel\n");
-			return;
+			r_outofbedges += 2;
+			return false;
 		}
 
 		ptedge = &pbedges[numbedges];
@@ -289,6 +313,34 @@ void R_RecursiveClipBPoly (bedge_t *pedges, mnode_t *pnode, msurface_t *psurf)
 		numbedges += 2;
 	}
 
+	return true;
+}
+
+
+/*
+================
+R_RecursiveClipBPoly
+================
+*/
+void R_RecursiveClipBPoly (bedge_t *pedges, mnode_t *pnode, msurface_t *psurf)
+{
+	bedge_t		*psideedges[2];
+	int			i;
+	mplane_t	*splitplane, tplane;
+	mnode_t		*pn;
+
+// transform the BSP plane into model space
+// FIXME: cache these?
+	splitplane = pnode->plane;
+	tplane.dist = splitplane->dist -
+			DotProduct(r_entorigin, splitplane->normal);
+	tplane.normal[0] = DotProduct (entity_rotation[0], splitplane->normal);
+	tplane.normal[1] = DotProduct (entity_rotation[1], splitplane->normal);
+	tplane.normal[2] = DotProduct (entity_rotation[2], splitplane->normal);
+
+	if (!R_ClipBPolyToPlane (pedges, &tplane, psideedges))
+		return;
+
 // draw or recurse further
 	for (i=0 ; i<2 ; i++)
 	{
@@ -320,9 +372,159 @@ void R_RecursiveClipBPoly (bedge_t *pedges, mnode_t *pnode, msurface_t *psurf)
 }
 
 
+/*
+================
+R_RecursiveClipBPolys
+
+R_RecursiveClipBPoly for all of a submodel's polygons at once, so each node's
+plane is brought into model space, and its children checked against the PVS,
+once rather than once a polygon.  The fragments that get to leafs are put on
+r_bfragments instead of being drawn.
+================
+*/
+void R_RecursiveClipBPolys (bpoly_t *ppolys, mnode_t *pnode)
+{
+	bedge_t		*psideedges[2];
+	bpoly_t		*psidepolys[2], **pptail[2], *pnextpoly, *ptpoly;
+	int			i;
+	mplane_t	*splitplane, tplane;
+	mnode_t		*pn;
+
+	psidepolys[0] = psidepolys[1] = NULL;
+	pptail[0] = &psidepolys[0];
+	pptail[1] = &psidepolys[1];
+
+// transform the BSP plane into model space
+	splitplane = pnode->plane;
+	tplane.dist = splitplane->dist -
+			DotProduct(r_entorigin, splitplane->normal);
+	tplane.normal[0] = DotProduct (entity_rotation[0], splitplane->normal);
+	tplane.normal[1] = DotProduct (entity_rotation[1], splitplane->normal);
+	tplane.normal[2] = DotProduct (entity_rotation[2], splitplane->normal);
+
+// split each polygon, keeping them in the same order on both sides
+	for ( ; ppolys ; ppolys = pnextpoly)
+	{
+		pnextpoly = ppolys->pnext;
+
+		if (!R_ClipBPolyToPlane (ppolys->pedges, &tplane, psideedges))
+			continue;
+
+		ptpoly = ppolys;		// the first side gets the polygon itself
+		for (i=0 ; i<2 ; i++)
+		{
+			if (!psideedges[i])
+				continue;
+
+			if (!ptpoly)
+			{
+				if (numbpolys >= r_bpolysallocated)
+				{
+					r_outofbpolys++;
+					continue;
+				}
+				ptpoly = &r_bpolybuffer[numbpolys++];
+				ptpoly->psurf = ppolys->psurf;
+				ptpoly->surfnum = ppolys->surfnum;
+			}
+
+			ptpoly->pedges = psideedges[i];
+			ptpoly->pnext = NULL;
+			*pptail[i] = ptpoly;
+			pptail[i] = &ptpoly->pnext;
+			ptpoly = NULL;
+		}
+	}
+
+// keep the fragments that get to leafs, or recurse further
+	for (i=0 ; i<2 ; i++)
+	{
+		if (!psidepolys[i])
+			continue;
+
+		pn = pnode->children[i];
+
+	// we're done with this branch if the node or leaf isn't in the PVS
+		if (pn->visframe != r_visframecount)
+			continue;
+
+		if (pn->contents < 0)
+		{
+			if (pn->contents == CONTENTS_SOLID)
+				continue;
+
+			for (ptpoly = psidepolys[i] ; ptpoly ; ptpoly = ptpoly->pnext)
+			{
+				ptpoly->key = ((mleaf_t *)pn)->key;
+				r_numbfragments++;
+			}
+			*r_bfragtail = psidepolys[i];
+			r_bfragtail = pptail[i];
+		}
+		else
+		{
+			R_RecursiveClipBPolys (psidepolys[i], pn);
+		}
+	}
+}
+
+
+/*
+================
+R_SortBPolys
+
+Stable merge sort of the fragments by surface, which puts them in the order
+polygon at a time clipping would have drawn them in
+================
+*/
+bpoly_t *R_SortBPolys (bpoly_t *ppolys, int count)
+{
+	bpoly_t		*pfirst, *psecond, *phead, **pptail;
+	int			i, half;
+
+	if (count < 2)
+		return ppolys;
+
+	half = count >> 1;
+	psecond = ppolys;
+	for (i=1 ; i<half ; i++)
+		psecond = psecond->pnext;
+	pfirst = ppolys;
+	ppolys = psecond;
+	psecond = psecond->pnext;
+	ppolys->pnext = NULL;
+
+	pfirst = R_SortBPolys (pfirst, half);
+	psecond = R_SortBPolys (psecond, count - half);
+
+	pptail = &phead;
+	while (pfirst && psecond)
+	{
+		if (psecond->surfnum < pfirst->surfnum)
+		{
+			*pptail = psecond;
+			psecond = psecond->pnext;
+		}
+		else
+		{
+			*pptail = pfirst;
+			pfirst = pfirst->pnext;
+		}
+		pptail = &(*pptail)->pnext;
+	}
+	*pptail = pfirst ? pfirst : psecond;
+
+	return phead;
+}
+
+
 /*
 ================
 R_DrawSolidClippedSubmodelPolygons
+
+With r_bmodelbatch, all of the front facing polygons go through the world
+BSP together, and the fragments are drawn afterwards in surface order, which
+draws exactly what clipping them one at a time does
 ================
 */
 void R_DrawSolidClippedSubmodelPolygons (model_t *pmodel)
@@ -332,9 +534,10 @@ void R_DrawSolidClippedSubmodelPolygons (model_t *pmodel)
 	msurface_t	*psurf;
 	int			numsurfaces;
 	mplane_t	*pplane;
-	mvertex_t	bverts[MAX_BMODEL_VERTS];
-	bedge_t		bedges[MAX_BMODEL_EDGES], *pbedge;
+	bedge_t		*pbedge;
 	medge_t		*pedge, *pedges;
+	bpoly_t		*ppolys, **pptail, *ppoly;
+	qboolean	batch;
 
 // FIXME: use bounding-box-based frustum clipping info?
 
@@ -342,6 +545,13 @@ void R_DrawSolidClippedSubmodelPolygons (model_t *pmodel)
 	numsurfaces = pmodel->nummodelsurfaces;
 	pedges = pmodel->edges;
 
+	batch = r_bmodelbatch.value != 0;
+	pbverts = r_bvertbuffer;
+	pbedges = r_bedgebuffer;
+	numbverts = numbedges = numbpolys = 0;
+	ppolys = NULL;
+	pptail = &ppolys;
+
 	for (i=0 ; i<numsurfaces ; i++, psurf++)
 	{
 	// find which side of the node we are on
@@ -356,49 +566,85 @@ void R_DrawSolidClippedSubmodelPolygons (model_t *pmodel)
 		// FIXME: use bounding-box-based frustum clipping info?
 
 		// copy the edges to bedges, flipping if necessary so always
-		// clockwise winding
-		// FIXME: if edges and vertices get caches, these assignments must move
-		// outside the loop, and overflow checking must be done here
-			pbverts = bverts;
-			pbedges = bedges;
-			numbverts = numbedges = 0;
-
-			if (psurf->numedges > 0)
+		// clockwise winding; polygon at a time, the pools start over for
+		// each one
+			if (!batch)
+				numbverts = numbedges = 0;
+
+			if (psurf->numedges <= 0)
+				Sys_Error ("no edges in bmodel");
+
+			if (numbedges + psurf->numedges > r_bedgesallocated)
 			{
-				pbedge = &bedges[numbedges];
-				numbedges += psurf->numedges;
+				r_outofbedges += psurf->numedges;
+				continue;
+			}
 
-				for (j=0 ; j<psurf->numedges ; j++)
-				{
-				   lindex = pmodel->surfedges[psurf->firstedge+j];
+			pbedge = &pbedges[numbedges];
+			numbedges += psurf->numedges;
 
-					if (lindex > 0)
-					{
-						pedge = &pedges[lindex];
-						pbedge[j].v[0] = &r_pcurrentvertbase[pedge->v[0]];
-						pbedge[j].v[1] = &r_pcurrentvertbase[pedge->v[1]];
-					}
-					else
-					{
-						lindex = -lindex;
-						pedge = &pedges[lindex];
-						pbedge[j].v[0] = &r_pcurrentvertbase[pedge->v[1]];
-						pbedge[j].v[1] = &r_pcurrentvertbase[pedge->v[0]];
-					}
+			for (j=0 ; j<psurf->numedges ; j++)
+			{
+			   lindex = pmodel->surfedges[psurf->firstedge+j];
 
-					pbedge[j].pnext = &pbedge[j+1];
+				if (lindex > 0)
+				{
+					pedge = &pedges[lindex];
+					pbedge[j].v[0] = &r_pcurrentvertbase[pedge->v[0]];
+					pbedge[j].v[1] = &r_pcurrentvertbase[pedge->v[1]];
+				}
+				else
+				{
+					lindex = -lindex;
+					pedge = &pedges[lindex];
+					pbedge[j].v[0] = &r_pcurrentvertbase[pedge->v[1]];
+					pbedge[j].v[1] = &r_pcurrentvertbase[pedge->v[0]];
 				}
 
-				pbedge[j-1].pnext = NULL;	// mark end of edges
+				pbedge[j].pnext = &pbedge[j+1];
+			}
+
+			pbedge[j-1].pnext = NULL;	// mark end of edges
 
+			if (!batch)
+			{
 				R_RecursiveClipBPoly (pbedge, currententity->topnode, psurf);
+				continue;
 			}
-			else
+
+			if (numbpolys >= r_bpolysallocated)
 			{
-				Sys_Error ("no edges in bmodel");
+				r_outofbpolys++;
+				continue;
 			}
+
+			ppoly = &r_bpolybuffer[numbpolys++];
+			ppoly->pedges = pbedge;
+			ppoly->psurf = psurf;
+			ppoly->surfnum = i;
+			ppoly->pnext = NULL;
+			*pptail = ppoly;
+			pptail = &ppoly->pnext;
 		}
 	}
+
+	if (!ppolys)
+		return;
+
+	r_bfragments = NULL;
+	r_bfragtail = &r_bfragments;
+	r_numbfragments = 0;
+
+	R_RecursiveClipBPolys (ppolys, currententity->topnode);
+
+	*r_bfragtail = NULL;
+	r_bfragments = R_SortBPolys (r_bfragments, r_numbfragments);
+
+	for (ppoly = r_bfragments ; ppoly ; ppoly = ppoly->pnext)
+	{
+		r_currentbkey = ppoly->key;
+		R_RenderBmodelFace (ppoly->pedges, ppoly->psurf);
+	}
 }
 
 
@@ -440,6 +686,165 @@ void R_DrawSubmodelPolygons (model_t *pmodel, int clipflags)
 }
 
 
+/*
+================
+R_BuildNodeBounds
+
+Flattens the world's node and leaf boxes into r_nodebounds, on the hunk
+with the rest of the level
+================
+*/
+void R_BuildNodeBounds (void)
+{
+	int				i, j, numnodes;
+	mnode_t			*node;
+	nodebounds_t	*nb;
+
+	numnodes = cl.worldmodel->numnodes + cl.worldmodel->numleafs + 1;
+	r_nodebounds = Hunk_AllocName (numnodes * sizeof(nodebounds_t),
+			"nodebnds");
+
+	for (i=0, nb=r_nodebounds ; i<numnodes ; i++, nb++)
+	{
+		if (i < cl.worldmodel->numnodes)
+			node = cl.worldmodel->nodes + i;
+		else
+			node = (mnode_t *)(cl.worldmodel->leafs +
+					(i - cl.worldmodel->numnodes));
+
+		for (j=0 ; j<3 ; j++)
+		{
+			nb->mins[j] = (float)node->minmaxs[j];
+			nb->maxs[j] = (float)node->minmaxs[3+j];
+		}
+	}
+}
+
+
+#if idSIMD
+
+/*
+================
+R_SetUpFrustumLanes
+================
+*/
+static void R_SetUpFrustumLanes (void)
+{
+	int		i, j;
+	float	n;
+
+	for (i=0 ; i<4 ; i++)
+	{
+		for (j=0 ; j<3 ; j++)
+		{
+		// same split as R_SetUpFrustumIndexes
+			n = view_clipplanes[i].normal[j];
+			r_frustumneg[j][i] = n < 0 ? n : 0;
+			r_frustumpos[j][i] = n < 0 ? 0 : n;
+		}
+		r_frustumdist[i] = view_clipplanes[i].dist;
+	}
+}
+
+
+/*
+================
+R_CullNodeSIMD
+
+The plane loop of R_RecursiveWorldNode for all four planes at once.  The
+dot products are summed in the same order, unfused, so the distances have
+the same signs.  Returns the planes the node still crosses, or -1 if it's
+entirely off one of them.
+================
+*/
+static int R_CullNodeSIMD (nodebounds_t *nb, int clipflags)
+{
+	int		reject, accept;
+
+#if idNEON
+	float32x4_t	mins, maxs, neg, pos, dist, zero, dr, da, t, u;
+	uint32x4_t	bits;
+	static const unsigned	lanebits[4] = {1, 2, 4, 8};
+
+	mins = vld1q_f32 (nb->mins);
+	maxs = vld1q_f32 (nb->maxs);
+	zero = vdupq_n_f32 (0);
+
+// x
+	neg = vld1q_f32 (r_frustumneg[0]);
+	pos = vld1q_f32 (r_frustumpos[0]);
+	t = vdupq_laneq_f32 (mins, 0);
+	u = vdupq_laneq_f32 (maxs, 0);
+	dr = vaddq_f32 (vmulq_f32 (t, neg), vmulq_f32 (u, pos));
+	da = vaddq_f32 (vmulq_f32 (t, pos), vmulq_f32 (u, neg));
+
+// y
+	neg = vld1q_f32 (r_frustumneg[1]);
+	pos = vld1q_f32 (r_frustumpos[1]);
+	t = vdupq_laneq_f32 (mins, 1);
+	u = vdupq_laneq_f32 (maxs, 1);
+	dr = vaddq_f32 (dr, vaddq_f32 (vmulq_f32 (t, neg), vmulq_f32 (u, pos)));
+	da = vaddq_f32 (da, vaddq_f32 (vmulq_f32 (t, pos), vmulq_f32 (u, neg)));
+
+// z
+	neg = vld1q_f32 (r_frustumneg[2]);
+	pos = vld1q_f32 (r_frustumpos[2]);
+	t = vdupq_laneq_f32 (mins, 2);
+	u = vdupq_laneq_f32 (maxs, 2);
+	dr = vaddq_f32 (dr, vaddq_f32 (vmulq_f32 (t, neg), vmulq_f32 (u, pos)));
+	da = vaddq_f32 (da, vaddq_f32 (vmulq_f32 (t, pos), vmulq_f32 (u, neg)));
+
+	dist = vld1q_f32 (r_frustumdist);
+	bits = vld1q_u32 (lanebits);
+	reject = vaddvq_u32 (vandq_u32 (vcleq_f32 (vsubq_f32 (dr, dist), zero),
+			bits));
+	accept = vaddvq_u32 (vandq_u32 (vcgeq_f32 (vsubq_f32 (da, dist), zero),
+			bits));
+#else
+	__m128	mins, maxs, neg, pos, dist, zero, dr, da, t, u;
+
+	mins = _mm_loadu_ps (nb->mins);
+	maxs = _mm_loadu_ps (nb->maxs);
+	zero = _mm_setzero_ps ();
+
+// x
+	neg = _mm_loadu_ps (r_frustumneg[0]);
+	pos = _mm_loadu_ps (r_frustumpos[0]);
+	t = _mm_shuffle_ps (mins, mins, _MM_SHUFFLE(0,0,0,0));
+	u = _mm_shuffle_ps (maxs, maxs, _MM_SHUFFLE(0,0,0,0));
+	dr = _mm_add_ps (_mm_mul_ps (t, neg), _mm_mul_ps (u, pos));
+	da = _mm_add_ps (_mm_mul_ps (t, pos), _mm_mul_ps (u, neg));
+
+// y
+	neg = _mm_loadu_ps (r_frustumneg[1]);
+	pos = _mm_loadu_ps (r_frustumpos[1]);
+	t = _mm_shuffle_ps (mins, mins, _MM_SHUFFLE(1,1,1,1));
+	u = _mm_shuffle_ps (maxs, maxs, _MM_SHUFFLE(1,1,1,1));
+	dr = _mm_add_ps (dr, _mm_add_ps (_mm_mul_ps (t, neg), _mm_mul_ps (u, pos)));
+	da = _mm_add_ps (da, _mm_add_ps (_mm_mul_ps (t, pos), _mm_mul_ps (u, neg)));
+
+// z
+	neg = _mm_loadu_ps (r_frustumneg[2]);
+	pos = _mm_loadu_ps (r_frustumpos[2]);
+	t = _mm_shuffle_ps (mins, mins, _MM_SHUFFLE(2,2,2,2));
+	u = _mm_shuffle_ps (maxs, maxs, _MM_SHUFFLE(2,2,2,2));
+	dr = _mm_add_ps (dr, _mm_add_ps (_mm_mul_ps (t, neg), _mm_mul_ps (u, pos)));
+	da = _mm_add_ps (da, _mm_add_ps (_mm_mul_ps (t, pos), _mm_mul_ps (u, neg)));
+
+	dist = _mm_loadu_ps (r_frustumdist);
+	reject = _mm_movemask_ps (_mm_cmple_ps (_mm_sub_ps (dr, dist), zero));
+	accept = _mm_movemask_ps (_mm_cmpge_ps (_mm_sub_ps (da, dist), zero));
+#endif
+
+	if (reject & clipflags)
+		return -1;
+
+	return clipflags & ~accept;
+}
+
+#endif	// idSIMD
+
+
 /*
 ================
 R_RecursiveWorldNode
@@ -460,6 +865,26 @@ void R_RecursiveWorldNode (mnode_t *node, int clipflags)
 	if (node->visframe != r_visframecount)
 		return;
 
+	r_nodesvisited++;
+
+#if idSIMD
+	if (clipflags && d_simd.value)
+	{
+		if (node->contents < 0)
+			i = cl.worldmodel->numnodes +
+					((mleaf_t *)node - cl.worldmodel->leafs);
+		else
+			i = node - cl.worldmodel->nodes;
+
+		clipflags = R_CullNodeSIMD (r_nodebounds + i, clipflags);
+		if (clipflags < 0)
+		{
+			r_nodesculled++;
+			return;
+		}
+	}
+	else
+#endif
 // cull the clipping planes if not trivial accept
 // FIXME: the compiler is doing a lousy job of optimizing here; it could be
 //  twice as fast in ASM
@@ -484,7 +909,10 @@ void R_RecursiveWorldNode (mnode_t *node, int clipflags)
 			d -= view_clipplanes[i].dist;
 
 			if (d <= 0)
+			{
+				r_nodesculled++;
 				return;
+			}
 
 			acceptpt[0] = (float)node->minmaxs[pindex[3+0]];
 			acceptpt[1] = (float)node->minmaxs[pindex[3+1]];
@@ -516,9 +944,9 @@ void R_RecursiveWorldNode (mnode_t *node, int clipflags)
 		}
 
 	// deal with model fragments in this leaf
-		if (pleaf->efrags)
+		if (pleaf->numefrags)
 		{
-			R_StoreEfrags (&pleaf->efrags);
+			R_StoreEfrags (pleaf);
 		}
 
 		pleaf->key = r_currentkey;
@@ -658,6 +1086,10 @@ void R_RenderWorld (void)
 	clmodel = currententity->model;
 	r_pcurrentvertbase = clmodel->vertexes;
 
+#if idSIMD
+	R_SetUpFrustumLanes ();
+#endif
+
 	R_RecursiveWorldNode (clmodel->nodes, 15);
 
 // if the driver wants the polygons back to front, play the visible ones back
@@ -672,3 +1104,79 @@ void R_RenderWorld (void)
 }
 
 
+
+
+static entity_t	**r_bmodelbenchents;
+static int		r_bmodelbenchcount, r_bmodelbenchpasses;
+static double	r_bmodelbenchtime[2];
+
+/*
+================
+R_BmodelBenchRun
+================
+*/
+static void R_BmodelBenchRun (int mode)
+{
+	double	world;
+
+	world = R_TimeView (NULL, 0, r_bmodelbenchpasses);
+	r_bmodelbenchtime[mode] = R_TimeView (r_bmodelbenchents,
+			r_bmodelbenchcount, r_bmodelbenchpasses) - world;
+}
+
+
+/*
+================
+R_BmodelBench_f
+
+r_bmodelbench [model] [count] [passes]
+
+Times the current view with a crowd of copies of a submodel spinning in
+front of it, clipping them to the world BSP polygon at a time and a submodel
+at a time
+================
+*/
+void R_BmodelBench_f (void)
+{
+	model_t		*model;
+	char		*name;
+	int			i, count, passes, differ;
+
+	if (!R_BenchArgs ("*1", &name, &count, &passes))
+		return;
+
+	model = Mod_ForName (name, false);
+	if (!model || model->type != mod_brush || model == cl.worldmodel)
+	{
+		Con_Printf ("r_bmodelbench: %s is not a submodel\n", name);
+		return;
+	}
+
+// rows of copies from a little way in front of the view, turned every which
+// way, so they cross the world's planes and need the rotated path
+	r_bmodelbenchents = R_BenchCrowd (model, count, model->radius * 3,
+			model->radius * 1.5);
+	for (i=0 ; i<count ; i++)
+	{
+		r_bmodelbenchents[i]->angles[PITCH] = (i * 23) % 90 - 45;
+		r_bmodelbenchents[i]->angles[ROLL] = (i * 11) % 60 - 30;
+	}
+	r_bmodelbenchcount = count;
+	r_bmodelbenchpasses = passes;
+
+// a pass first to let the edge, surface and clip pools grow to the crowd
+	R_TimeView (r_bmodelbenchents, count, 2);
+
+	differ = R_BenchModes ("r_bmodelbatch", R_BmodelBenchRun, vid.buffer,
+			vid.rowbytes * vid.height);
+
+	R_BenchRestoreEdicts ();
+
+	Con_Printf ("%i of %s, %i surfaces each, %i passes\n",
+			count, name, model->nummodelsurfaces, passes);
+	Con_Printf ("clip pools: %i verts, %i edges, %i polys\n",
+			r_bvertsallocated, r_bedgesallocated, r_bpolysallocated);
+	Con_Printf ("polygon at a time: %.3f ms\n", r_bmodelbenchtime[0] * 1000);
+	Con_Printf ("batched:           %.3f ms, %s\n", r_bmodelbenchtime[1] * 1000,
+			R_BenchVerdict (differ));
+}
@@ -34,7 +34,6 @@ have a sentinal at both ends?
 #endif
 
 
-edge_t	*auxedges;
 edge_t	*r_edges, *edge_p, *edge_max;
 
 surf_t	*surfaces, *surface_p, *surf_max;
@@ -43,11 +42,15 @@ surf_t	*surfaces, *surface_p, *surf_max;
 // pointer is greater than another one, it should be drawn in front
 // surfaces[1] is the background, and is used as the active surface stack
 
-edge_t	*newedges[MAXHEIGHT];
-edge_t	*removeedges[MAXHEIGHT];
+edge_t	**newedges;			// [vid.height]
+edge_t	**removeedges;
 
+espan_t	*r_spans;			// [r_numspans]
+int		r_numspans;
 espan_t	*span_p, *max_span_p;
 
+int		r_edgeshift = 20;
+
 int		r_currentkey;
 
 extern	int	screenwidth;
@@ -383,7 +386,7 @@ continue_search:
 
 newtop:
 	// emit a span (obscures current top)
-		iu = edge->u >> 20;
+		iu = edge->u >> r_edgeshift;
 
 		if (iu > surf2->last_u)
 		{
@@ -429,7 +432,7 @@ void R_TrailingEdge (surf_t *surf, edge_t *edge)
 		if (surf == surfaces[1].next)
 		{
 		// emit a span (current top going away)
-			iu = edge->u >> 20;
+			iu = edge->u >> r_edgeshift;
 			if (iu > surf->last_u)
 			{
 				span = span_p++;
@@ -487,7 +490,8 @@ void R_LeadingEdge (edge_t *edge)
 			if (surf->insubmodel && (surf->key == surf2->key))
 			{
 			// must be two bmodels in the same leaf; sort on 1/z
-				fu = (float)(edge->u - 0xFFFFF) * (1.0 / 0x100000);
+				fu = (float)(edge->u - ((1 << r_edgeshift) - 1)) *
+						(1.0 / (1 << r_edgeshift));
 				newzi = surf->d_ziorigin + fv*surf->d_zistepv +
 						fu*surf->d_zistepu;
 				newzibottom = newzi * 0.99;
@@ -525,7 +529,8 @@ continue_search:
 					goto continue_search;
 
 			// must be two bmodels in the same leaf; sort on 1/z
-				fu = (float)(edge->u - 0xFFFFF) * (1.0 / 0x100000);
+				fu = (float)(edge->u - ((1 << r_edgeshift) - 1)) *
+						(1.0 / (1 << r_edgeshift));
 				newzi = surf->d_ziorigin + fv*surf->d_zistepv +
 						fu*surf->d_zistepu;
 				newzibottom = newzi * 0.99;
@@ -554,7 +559,7 @@ continue_search:
 
 newtop:
 		// emit a span (obscures current top)
-			iu = edge->u >> 20;
+			iu = edge->u >> r_edgeshift;
 
 			if (iu > surf2->last_u)
 			{
@@ -663,28 +668,27 @@ Each surface has a linked list of its visible spans
 void R_ScanEdges (void)
 {
 	int		iv, bottom;
-	byte	basespans[MAXSPANS*sizeof(espan_t)+CACHE_SIZE];
 	espan_t	*basespan_p;
 	surf_t	*s;
 
-	basespan_p = (espan_t *)
-			((long)(basespans + CACHE_SIZE - 1) & ~(CACHE_SIZE - 1));
-	max_span_p = &basespan_p[MAXSPANS - r_refdef.vrect.width];
+	basespan_p = r_spans;
+	max_span_p = &basespan_p[r_numspans - r_refdef.vrect.width];
 
 	span_p = basespan_p;
 
 // clear active edges to just the background edges around the whole screen
 // FIXME: most of this only needs to be set up once
-	edge_head.u = r_refdef.vrect.x << 20;
-	edge_head_u_shift20 = edge_head.u >> 20;
+	edge_head.u = r_refdef.vrect.x << r_edgeshift;
+	edge_head_u_shift20 = edge_head.u >> r_edgeshift;
 	edge_head.u_step = 0;
 	edge_head.prev = NULL;
 	edge_head.next = &edge_tail;
 	edge_head.surfs[0] = 0;
 	edge_head.surfs[1] = 1;
 	
-	edge_tail.u = (r_refdef.vrectright << 20) + 0xFFFFF;
-	edge_tail_u_shift20 = edge_tail.u >> 20;
+	edge_tail.u = (r_refdef.vrectright << r_edgeshift) +
+			((1 << r_edgeshift) - 1);
+	edge_tail_u_shift20 = edge_tail.u >> r_edgeshift;
 	edge_tail.u_step = 0;
 	edge_tail.prev = &edge_head;
 	edge_tail.next = &edge_aftertail;
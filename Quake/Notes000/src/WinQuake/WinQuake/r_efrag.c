@@ -35,6 +35,25 @@ mnode_t	*r_pefragtopnode;
 ===============================================================================
 */
 
+#define	EFRAGBLOCK	640		// efrags allocated at a time
+
+typedef struct efragblock_s
+{
+	struct efragblock_s	*next;
+	efrag_t				efrags[EFRAGBLOCK];
+} efragblock_t;
+
+// the blocks are kept from map to map, in the order they were allocated,
+// and handed out in that order after each R_ClearEfrags
+static efragblock_t	*r_efragblocks, **r_lastefragblock = &r_efragblocks;
+
+int			r_numefrags;		// in use
+entity_t	**r_efragents;		// the leaves' entity lists, one after another
+static int	r_maxefragents;
+static efrag_t	**r_sortedefrags;	// in use, oldest first, for R_SortEfrags
+static int	r_efragsequence;
+qboolean	r_efragsdirty;		// leaf lists need R_SortEfrags
+
 efrag_t		**lastlink;
 
 vec3_t		r_emins, r_emaxs;
@@ -42,6 +61,79 @@ vec3_t		r_emins, r_emaxs;
 entity_t	*r_addent;
 
 
+/*
+================
+R_ClearEfrags
+
+Puts every efrag back on the free list, called when the client state is
+cleared
+================
+*/
+void R_ClearEfrags (void)
+{
+	efragblock_t	*block;
+	efrag_t			*ef, **link;
+	int				i;
+
+	link = &cl.free_efrags;
+	for (block = r_efragblocks ; block ; block = block->next)
+	{
+		for (i=0, ef=block->efrags ; i<EFRAGBLOCK ; i++, ef++)
+		{
+			ef->entity = NULL;
+			*link = ef;
+			link = &ef->entnext;
+		}
+	}
+	*link = NULL;
+
+	r_numefrags = 0;
+	r_efragsequence = 0;
+	r_efragsdirty = true;
+}
+
+
+/*
+================
+R_NewEfrag
+
+Takes an efrag off the free list, allocating another block when it is empty
+================
+*/
+static efrag_t *R_NewEfrag (void)
+{
+	efragblock_t	*block;
+	efrag_t			*ef;
+	int				i;
+
+	if (!cl.free_efrags)
+	{
+		block = malloc (sizeof(*block));
+		if (!block)
+			Sys_Error ("R_NewEfrag: out of memory");
+		block->next = NULL;
+		*r_lastefragblock = block;
+		r_lastefragblock = &block->next;
+
+		for (i=0, ef=block->efrags ; i<EFRAGBLOCK ; i++, ef++)
+		{
+			ef->entity = NULL;
+			ef->entnext = ef + 1;
+		}
+		block->efrags[EFRAGBLOCK-1].entnext = NULL;
+		cl.free_efrags = block->efrags;
+	}
+
+	ef = cl.free_efrags;
+	cl.free_efrags = ef->entnext;
+	ef->sequence = r_efragsequence++;
+	r_numefrags++;
+	r_efragsdirty = true;
+
+	return ef;
+}
+
+
 /*
 ================
 R_RemoveEfrags
@@ -51,38 +143,98 @@ Call when removing an object from the world or moving it to another position
 */
 void R_RemoveEfrags (entity_t *ent)
 {
-	efrag_t		*ef, *old, *walk, **prev;
+	efrag_t		*ef, *old;
 	
 	ef = ent->efrag;
 	
 	while (ef)
 	{
-		prev = &ef->leaf->efrags;
-		while (1)
-		{
-			walk = *prev;
-			if (!walk)
-				break;
-			if (walk == ef)
-			{	// remove this fragment
-				*prev = ef->leafnext;
-				break;
-			}
-			else
-				prev = &walk->leafnext;
-		}
-				
 		old = ef;
 		ef = ef->entnext;
 		
 	// put it on the free list
+		old->entity = NULL;
 		old->entnext = cl.free_efrags;
 		cl.free_efrags = old;
+		r_numefrags--;
+		r_efragsdirty = true;
 	}
 	
 	ent->efrag = NULL; 
 }
 
+
+/*
+================
+R_CompareEfrags
+================
+*/
+static int R_CompareEfrags (const void *a, const void *b)
+{
+	return (*(efrag_t **)a)->sequence - (*(efrag_t **)b)->sequence;
+}
+
+
+/*
+================
+R_SortEfrags
+
+Rebuilds the per leaf entity lists from the efrags, after entities have been
+added or removed.  A leaf lists its entities newest first, the order its
+efrag chain used to give.  Freed efrags are handed out again from the top of
+the free list, so where an efrag sits in the blocks says nothing about when
+it was added, and the efrags are put in order by their sequence numbers
+================
+*/
+void R_SortEfrags (void)
+{
+	efragblock_t	*block;
+	efrag_t			*ef, **sorted;
+	mleaf_t			*leaf;
+	entity_t		**pent;
+	int				i, n;
+
+	r_efragsdirty = false;
+	if (!cl.worldmodel)
+		return;
+
+	if (r_numefrags > r_maxefragents)
+	{
+		r_maxefragents = r_numefrags * 2;
+		r_efragents = realloc (r_efragents,
+				r_maxefragents * sizeof(*r_efragents));
+		r_sortedefrags = realloc (r_sortedefrags,
+				r_maxefragents * sizeof(*r_sortedefrags));
+		if (!r_efragents || !r_sortedefrags)
+			Sys_Error ("R_SortEfrags: out of memory");
+	}
+
+// numleafs doesn't count the solid leaf 0
+	for (i=0, leaf=cl.worldmodel->leafs ; i<=cl.worldmodel->numleafs ; i++, leaf++)
+		leaf->numefrags = 0;
+
+	n = 0;
+	for (block = r_efragblocks ; block ; block = block->next)
+		for (i=0, ef=block->efrags ; i<EFRAGBLOCK ; i++, ef++)
+			if (ef->entity)
+			{
+				ef->leaf->numefrags++;
+				r_sortedefrags[n++] = ef;
+			}
+	qsort (r_sortedefrags, n, sizeof(*r_sortedefrags), R_CompareEfrags);
+
+// point each list past its end, then fill it backwards
+	pent = r_efragents;
+	for (i=0, leaf=cl.worldmodel->leafs ; i<=cl.worldmodel->numleafs ; i++, leaf++)
+	{
+		pent += leaf->numefrags;
+		leaf->efrags = pent;
+	}
+
+	for (i=0, sorted=r_sortedefrags ; i<n ; i++, sorted++)
+		*--(*sorted)->leaf->efrags = (*sorted)->entity;
+}
+
 /*
 ===================
 R_SplitEntityOnNode
@@ -110,25 +262,14 @@ void R_SplitEntityOnNode (mnode_t *node)
 		leaf = (mleaf_t *)node;
 
 // grab an efrag off the free list
-		ef = cl.free_efrags;
-		if (!ef)
-		{
-			Con_Printf ("Too many efrags!\n");
-			return;		// no free fragments...
-		}
-		cl.free_efrags = cl.free_efrags->entnext;
-
+		ef = R_NewEfrag ();
 		ef->entity = r_addent;
+		ef->leaf = leaf;
 		
 // add the entity link	
 		*lastlink = ef;
 		lastlink = &ef->entnext;
 		ef->entnext = NULL;
-		
-// set the leaf links
-		ef->leaf = leaf;
-		ef->leafnext = leaf->efrags;
-		leaf->efrags = ef;
 			
 		return;
 	}
@@ -233,42 +374,35 @@ void R_AddEfrags (entity_t *ent)
 ================
 R_StoreEfrags
 
-// FIXME: a lot of this goes away with edge-based
+Adds the entities touching a visible leaf to the ones drawn this frame
 ================
 */
-void R_StoreEfrags (efrag_t **ppefrag)
+void R_StoreEfrags (mleaf_t *pleaf)
 {
-	entity_t	*pent;
-	model_t		*clmodel;
-	efrag_t		*pefrag;
-
+	entity_t	*pent, **list;
+	int			count;
 
-	while ((pefrag = *ppefrag) != NULL)
+	list = pleaf->efrags;
+	for (count = pleaf->numefrags ; count ; count--)
 	{
-		pent = pefrag->entity;
-		clmodel = pent->model;
+		pent = *list++;
 
-		switch (clmodel->type)
+		switch (pent->model->type)
 		{
 		case mod_alias:
 		case mod_brush:
 		case mod_sprite:
-			pent = pefrag->entity;
-
-			if ((pent->visframe != r_framecount) &&
-				(cl_numvisedicts < MAX_VISEDICTS))
+			if (pent->visframe != r_framecount)
 			{
-				cl_visedicts[cl_numvisedicts++] = pent;
+				CL_AddVisEdict (pent);
 
 			// mark that we've recorded this entity for this frame
 				pent->visframe = r_framecount;
 			}
-
-			ppefrag = &pefrag->leafnext;
 			break;
 
 		default:	
-			Sys_Error ("R_StoreEfrags: Bad entity type %d\n", clmodel->type);
+			Sys_Error ("R_StoreEfrags: Bad entity type %d\n", pent->model->type);
 		}
 	}
 }
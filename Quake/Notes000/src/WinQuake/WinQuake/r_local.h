@@ -51,6 +51,17 @@ typedef struct {
 	float	fv[3];		// viewspace x, y
 } auxvert_t;
 
+// a polygon, or the part of one, going through the world BSP with the rest of
+// its submodel
+typedef struct bpoly_s
+{
+	bedge_t			*pedges;
+	msurface_t		*psurf;
+	int				surfnum;	// fragments are drawn in surface order
+	int				key;		// of the leaf the fragment got to
+	struct bpoly_s	*pnext;
+} bpoly_t;
+
 //===========================================================================
 
 extern cvar_t	r_draworder;
@@ -99,6 +110,9 @@ extern	clipplane_t	view_clipplanes[4];
 //=============================================================================
 
 void R_RenderWorld (void);
+void R_BuildNodeBounds (void);
+
+extern	int		r_nodesvisited, r_nodesculled, r_pvsnodes;
 
 //=============================================================================
 
@@ -155,10 +169,12 @@ void R_Surf8Patch (void);
 void R_Surf16Patch (void);
 void R_DrawSubmodelPolygons (model_t *pmodel, int clipflags);
 void R_DrawSolidClippedSubmodelPolygons (model_t *pmodel);
+void R_BmodelBench_f (void);
 
 void R_AddPolygonEdges (emitpoint_t *pverts, int numverts, int miplevel);
 surf_t *R_GetSurf (void);
 void R_AliasDrawModel (alight_t *plighting);
+void R_AliasBench_f (void);
 void R_BeginEdgeFrame (void);
 void R_ScanEdges (void);
 void D_DrawSurfaces (void);
@@ -189,8 +205,8 @@ extern int		*pfrustum_indexes[4];
 extern int			ubasestep, errorterm, erroradjustup, erroradjustdown;
 extern int			vstartscan;
 
-extern fixed16_t	sadjust, tadjust;
-extern fixed16_t	bbextents, bbextentt;
+extern THREADLOCAL fixed16_t	sadjust, tadjust;
+extern THREADLOCAL fixed16_t	bbextents, bbextentt;
 
 #define MAXBVERTINDEXES	1000	// new clipped vertices when clipping bmodels
 								//  to the world BSP
@@ -252,14 +268,19 @@ void R_InitParticles (void);
 void R_ClearParticles (void);
 void R_ReadPointFile_f (void);
 void R_SurfacePatch (void);
+void R_SizeEdgeBuffers (void);
+int R_ModeMemory (void);
+void R_ModeMemory_f (void);
 
 extern int		r_amodels_drawn;
-extern edge_t	*auxedges;
 extern int		r_numallocatededges;
 extern edge_t	*r_edges, *edge_p, *edge_max;
 
-extern	edge_t	*newedges[MAXHEIGHT];
-extern	edge_t	*removeedges[MAXHEIGHT];
+extern	edge_t	**newedges;
+extern	edge_t	**removeedges;
+
+extern	espan_t	*r_spans;
+extern	int		r_numspans;
 
 extern	int	screenwidth;
 
@@ -276,6 +297,19 @@ extern float		r_aliastransition, r_resfudge;
 extern int		r_outofsurfaces;
 extern int		r_outofedges;
 
+#define MINBMODELVERTS	500		// the bmodel clip pools start out this big and
+#define MINBMODELEDGES	1000	//  grow when a frame runs short
+#define MINBMODELPOLYS	250
+
+extern mvertex_t	*r_bvertbuffer;
+extern bedge_t		*r_bedgebuffer;
+extern bpoly_t		*r_bpolybuffer;
+extern int			r_bvertsallocated, r_bedgesallocated, r_bpolysallocated;
+extern int			r_numallocatedbverts, r_numallocatedbedges;
+extern int			r_numallocatedbpolys;
+extern int			r_outofbverts, r_outofbedges, r_outofbpolys;
+extern cvar_t		r_bmodelbatch;
+
 extern mvertex_t	*r_pcurrentvertbase;
 extern int			r_maxvalidedgeoffset;
 
@@ -286,7 +320,6 @@ extern float	dp_time1, dp_time2, db_time1, db_time2, rw_time1, rw_time2;
 extern float	se_time1, se_time2, de_time1, de_time2, dv_time1, dv_time2;
 extern int		r_frustum_indexes[4*6];
 extern int		r_maxsurfsseen, r_maxedgesseen, r_cnumsurfs;
-extern qboolean	r_surfsonstack;
 extern cshift_t	cshift_water;
 extern qboolean	r_dowarpold, r_viewchanged;
 
@@ -298,8 +331,18 @@ extern int		r_clipflags;
 extern int		r_dlightframecount;
 extern qboolean	r_fov_greater_than_90;
 
-void R_StoreEfrags (efrag_t **ppefrag);
+extern qboolean	r_efragsdirty;
+
+void R_StoreEfrags (mleaf_t *pleaf);
+void R_SortEfrags (void);
 void R_TimeRefresh_f (void);
+double R_TimeView (entity_t **ents, int numents, int passes);
+qboolean R_BenchArgs (char *defaultmodel, char **name, int *count, int *passes);
+entity_t **R_BenchCrowd (model_t *model, int count, float first, float spacing);
+void R_BenchRestoreEdicts (void);
+
+#define	MAX_BENCHCROWD	256		// most copies r_aliasbench and r_bmodelbench
+								//  stand in front of the view
 void R_TimeGraph (void);
 void R_PrintAliasStats (void);
 void R_PrintTimes (void);
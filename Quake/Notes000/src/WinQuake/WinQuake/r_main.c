@@ -44,9 +44,8 @@ int			numbtofpolys;
 btofpoly_t	*pbtofpolys;
 mvertex_t	*r_pcurrentvertbase;
 
-int			c_surf;
+int			c_surf, c_surftexels;
 int			r_maxsurfsseen, r_maxedgesseen, r_cnumsurfs;
-qboolean	r_surfsonstack;
 int			r_clipflags;
 
 byte		*r_warpbuffer;
@@ -55,6 +54,45 @@ byte		*r_stack_start;
 
 qboolean	r_fov_greater_than_90;
 
+//
+// buffers sized from the video mode
+//
+#define	MAX_MODEBUFFERS	32
+
+typedef struct
+{
+	char	*name;
+	int		size;
+} modebuffer_t;
+
+modebuffer_t	r_modebuffers[MAX_MODEBUFFERS];
+int				r_nummodebuffers;
+int				r_modememory;		// total at the last report
+
+int			r_turbsize;				// entries in sintable / intsintable
+edge_t		*r_edgebuffer;
+int			r_edgesallocated;
+surf_t		*r_surfbuffer;
+int			r_surfsallocated;
+int			r_edgeheight;			// entries in newedges / removeedges
+
+// bmodel polygons clipped to the world BSP; these only depend on the level
+// and the entities, but grow between frames the same way
+mvertex_t	*r_bvertbuffer;
+bedge_t		*r_bedgebuffer;
+bpoly_t		*r_bpolybuffer;
+int			r_bvertsallocated, r_bedgesallocated, r_bpolysallocated;
+int			r_numallocatedbverts, r_numallocatedbedges, r_numallocatedbpolys;
+int			r_outofbverts, r_outofbedges, r_outofbpolys;
+
+// the PVS the visframes are currently marked from, and how many of each
+// node's children are marked, so a new view leaf only has to mark and unmark
+// the leafs that differ
+byte		*r_visleafbits;
+int			r_visleafbytes;
+byte		*r_visnodechildren;		// [numnodes]
+qboolean	r_visleafsmarked;		// false until the first PVS of a map
+
 //
 // view origin
 //
@@ -91,6 +129,7 @@ int		d_spanpixcount;
 int		r_polycount;
 int		r_drawnpolycount;
 int		r_wholepolycount;
+int		r_occluded;
 
 #define		VIEWMODNAME_LENGTH	256
 char		viewmodname[VIEWMODNAME_LENGTH+1];
@@ -136,6 +175,7 @@ cvar_t	r_maxedges = {"r_maxedges", "0"};
 cvar_t	r_numedges = {"r_numedges", "0"};
 cvar_t	r_aliastransbase = {"r_aliastransbase", "200"};
 cvar_t	r_aliastransadj = {"r_aliastransadj", "100"};
+cvar_t	r_occlusion = {"r_occlusion", "1"};
 
 extern cvar_t	scr_fov;
 
@@ -191,6 +231,9 @@ void R_Init (void)
 	
 	Cmd_AddCommand ("timerefresh", R_TimeRefresh_f);	
 	Cmd_AddCommand ("pointfile", R_ReadPointFile_f);	
+	Cmd_AddCommand ("r_modemem", R_ModeMemory_f);
+	Cmd_AddCommand ("r_aliasbench", R_AliasBench_f);
+	Cmd_AddCommand ("r_bmodelbench", R_BmodelBench_f);
 
 	Cvar_RegisterVariable (&r_draworder);
 	Cvar_RegisterVariable (&r_speeds);
@@ -211,8 +254,10 @@ void R_Init (void)
 	Cvar_RegisterVariable (&r_reportedgeout);
 	Cvar_RegisterVariable (&r_maxedges);
 	Cvar_RegisterVariable (&r_numedges);
+	Cvar_RegisterVariable (&r_bmodelbatch);
 	Cvar_RegisterVariable (&r_aliastransbase);
 	Cvar_RegisterVariable (&r_aliastransadj);
+	Cvar_RegisterVariable (&r_occlusion);
 
 	Cvar_SetValue ("r_maxedges", (float)NUMSTACKEDGES);
 	Cvar_SetValue ("r_maxsurfs", (float)NUMSTACKSURFACES);
@@ -250,32 +295,28 @@ void R_NewMap (void)
 // clear out efrags in case the level hasn't been reloaded
 // FIXME: is this one short?
 	for (i=0 ; i<cl.worldmodel->numleafs ; i++)
+	{
 		cl.worldmodel->leafs[i].efrags = NULL;
+		cl.worldmodel->leafs[i].numefrags = 0;
+	}
+	r_efragsdirty = true;
 		 	
 	r_viewleaf = NULL;
 	R_ClearParticles ();
+	R_BuildNodeBounds ();
+
+	r_visleafbytes = (cl.worldmodel->numleafs + 7) >> 3;
+	r_visleafbits = Hunk_AllocName (r_visleafbytes, "visbits");
+	r_visnodechildren = Hunk_AllocName (cl.worldmodel->numnodes, "vischild");
+	r_visleafsmarked = false;
 
+// the edge and surface buffers are resized to fit the mode on the next
+// frame, and grow from there if the level needs more
 	r_cnumsurfs = r_maxsurfs.value;
 
 	if (r_cnumsurfs <= MINSURFACES)
 		r_cnumsurfs = MINSURFACES;
 
-	if (r_cnumsurfs > NUMSTACKSURFACES)
-	{
-		surfaces = Hunk_AllocName (r_cnumsurfs * sizeof(surf_t), "surfaces");
-		surface_p = surfaces;
-		surf_max = &surfaces[r_cnumsurfs];
-		r_surfsonstack = false;
-	// surface 0 doesn't really exist; it's just a dummy because index 0
-	// is used to indicate no edge attached to surface
-		surfaces--;
-		R_SurfacePatch ();
-	}
-	else
-	{
-		r_surfsonstack = true;
-	}
-
 	r_maxedgesseen = 0;
 	r_maxsurfsseen = 0;
 
@@ -284,16 +325,6 @@ void R_NewMap (void)
 	if (r_numallocatededges < MINEDGES)
 		r_numallocatededges = MINEDGES;
 
-	if (r_numallocatededges <= NUMSTACKEDGES)
-	{
-		auxedges = NULL;
-	}
-	else
-	{
-		auxedges = Hunk_AllocName (r_numallocatededges * sizeof(edge_t),
-								   "edges");
-	}
-
 	r_dowarpold = false;
 	r_viewchanged = false;
 #ifdef PASSAGES
@@ -302,6 +333,166 @@ CreatePassages ();
 }
 
 
+/*
+===============
+R_ModeAlloc
+
+Resizes one of the buffers that depend on the video mode, keeping a tally
+by name for r_modemem
+===============
+*/
+void *R_ModeAlloc (void *buffer, int size, char *name)
+{
+	int				i;
+	modebuffer_t	*mb;
+
+	for (i=0, mb=r_modebuffers ; i<r_nummodebuffers ; i++, mb++)
+		if (!strcmp (mb->name, name))
+			break;
+
+	if (i == r_nummodebuffers)
+	{
+		if (r_nummodebuffers == MAX_MODEBUFFERS)
+			Sys_Error ("R_ModeAlloc: too many buffers");
+		r_nummodebuffers++;
+		mb->name = name;
+	}
+
+	buffer = realloc (buffer, size);
+	if (!buffer)
+		Sys_Error ("R_ModeAlloc: failed on %i bytes for %s", size, name);
+	mb->size = size;
+
+	return buffer;
+}
+
+
+/*
+===============
+R_ModeMemory
+===============
+*/
+int R_ModeMemory (void)
+{
+	int		i, total;
+
+	total = 0;
+	for (i=0 ; i<r_nummodebuffers ; i++)
+		total += r_modebuffers[i].size;
+
+	return total;
+}
+
+
+/*
+===============
+R_ModeMemory_f
+===============
+*/
+void R_ModeMemory_f (void)
+{
+	int				i;
+	modebuffer_t	*mb;
+
+	Con_Printf ("renderer buffers at %ix%i:\n", vid.width, vid.height);
+
+	for (i=0, mb=r_modebuffers ; i<r_nummodebuffers ; i++, mb++)
+		Con_Printf ("%8i  %s\n", mb->size, mb->name);
+
+	Con_Printf ("%8i  total\n", R_ModeMemory ());
+	Con_Printf ("%i edges, %i surfaces, %i spans, edge u %i.%i\n",
+			r_edgesallocated, r_surfsallocated, r_numspans,
+			31 - r_edgeshift, r_edgeshift);
+}
+
+
+/*
+===============
+R_SizeEdgeBuffers
+
+The edge, surface and span counts that were fixed for 320x200 are scaled by
+the mode height; r_numallocatededges and r_cnumsurfs also grow when a frame
+runs short, and the buffers follow them here between frames.  The bmodel clip
+pools grow the same way.
+===============
+*/
+void R_SizeEdgeBuffers (void)
+{
+	int		scale, numspans;
+
+	scale = vid.height / 200;
+	if (scale < 1)
+		scale = 1;
+
+	if (r_numallocatededges < NUMSTACKEDGES * scale)
+		r_numallocatededges = NUMSTACKEDGES * scale;
+	if (r_cnumsurfs < NUMSTACKSURFACES * scale)
+		r_cnumsurfs = NUMSTACKSURFACES * scale;
+
+	if (r_edgesallocated != r_numallocatededges)
+	{
+		r_edgebuffer = R_ModeAlloc (r_edgebuffer,
+				r_numallocatededges * sizeof(edge_t), "edges");
+		r_edgesallocated = r_numallocatededges;
+	}
+
+	if (r_surfsallocated != r_cnumsurfs)
+	{
+		r_surfbuffer = R_ModeAlloc (r_surfbuffer,
+				(r_cnumsurfs + 1) * sizeof(surf_t), "surfaces");
+		r_surfsallocated = r_cnumsurfs;
+	}
+
+// a full scan line has to fit behind max_span_p
+	numspans = MAXSPANS * scale;
+	if (numspans < vid.width * 2)
+		numspans = vid.width * 2;
+
+	if (r_numspans != numspans)
+	{
+		r_spans = R_ModeAlloc (r_spans, numspans * sizeof(espan_t), "spans");
+		r_numspans = numspans;
+	}
+
+	if (r_edgeheight != vid.height)
+	{
+		newedges = R_ModeAlloc (newedges, vid.height * sizeof(edge_t *),
+				"newedges");
+		removeedges = R_ModeAlloc (removeedges, vid.height * sizeof(edge_t *),
+				"removeedges");
+		r_edgeheight = vid.height;
+	}
+
+	if (r_numallocatedbverts < MINBMODELVERTS)
+		r_numallocatedbverts = MINBMODELVERTS;
+	if (r_numallocatedbedges < MINBMODELEDGES)
+		r_numallocatedbedges = MINBMODELEDGES;
+	if (r_numallocatedbpolys < MINBMODELPOLYS)
+		r_numallocatedbpolys = MINBMODELPOLYS;
+
+	if (r_bvertsallocated != r_numallocatedbverts)
+	{
+		r_bvertbuffer = R_ModeAlloc (r_bvertbuffer,
+				r_numallocatedbverts * sizeof(mvertex_t), "bmodel verts");
+		r_bvertsallocated = r_numallocatedbverts;
+	}
+
+	if (r_bedgesallocated != r_numallocatedbedges)
+	{
+		r_bedgebuffer = R_ModeAlloc (r_bedgebuffer,
+				r_numallocatedbedges * sizeof(bedge_t), "bmodel edges");
+		r_bedgesallocated = r_numallocatedbedges;
+	}
+
+	if (r_bpolysallocated != r_numallocatedbpolys)
+	{
+		r_bpolybuffer = R_ModeAlloc (r_bpolybuffer,
+				r_numallocatedbpolys * sizeof(bpoly_t), "bmodel polys");
+		r_bpolysallocated = r_numallocatedbpolys;
+	}
+}
+
+
 /*
 ===============
 R_SetVrect
@@ -364,14 +555,25 @@ void R_ViewChanged (vrect_t *pvrect, int lineadj, float aspect)
 
 	R_SetVrect (pvrect, &r_refdef.vrect, lineadj);
 
+// edge u is fixed point with the pixel in the high bits; give up fraction
+// bits on modes too wide for 12.20
+	r_edgeshift = 20;
+	while ((double)(vid.width + 2) * (1 << r_edgeshift) >= 2147483648.0)
+		r_edgeshift--;
+
+	R_InitTurb ();
+	R_SizeEdgeBuffers ();
+
 	r_refdef.horizontalFieldOfView = 2.0 * tan (r_refdef.fov_x/360*M_PI);
 	r_refdef.fvrectx = (float)r_refdef.vrect.x;
 	r_refdef.fvrectx_adj = (float)r_refdef.vrect.x - 0.5;
-	r_refdef.vrect_x_adj_shift20 = (r_refdef.vrect.x<<20) + (1<<19) - 1;
+	r_refdef.vrect_x_adj_shift20 = (r_refdef.vrect.x<<r_edgeshift) +
+			(1<<(r_edgeshift-1)) - 1;
 	r_refdef.fvrecty = (float)r_refdef.vrect.y;
 	r_refdef.fvrecty_adj = (float)r_refdef.vrect.y - 0.5;
 	r_refdef.vrectright = r_refdef.vrect.x + r_refdef.vrect.width;
-	r_refdef.vrectright_adj_shift20 = (r_refdef.vrectright<<20) + (1<<19) - 1;
+	r_refdef.vrectright_adj_shift20 = (r_refdef.vrectright<<r_edgeshift) +
+			(1<<(r_edgeshift-1)) - 1;
 	r_refdef.fvrectright = (float)r_refdef.vrectright;
 	r_refdef.fvrectright_adj = (float)r_refdef.vrectright - 0.5;
 	r_refdef.vrectrightedge = (float)r_refdef.vrectright - 0.99;
@@ -480,40 +682,113 @@ void R_ViewChanged (vrect_t *pvrect, int lineadj, float aspect)
 #endif	// id386
 
 	D_ViewChanged ();
+
+	if (R_ModeMemory () != r_modememory)
+	{
+		r_modememory = R_ModeMemory ();
+		Con_DPrintf ("%ik renderer buffers at %ix%i\n",
+				(r_modememory + 1023) / 1024, vid.width, vid.height);
+	}
+}
+
+
+/*
+===============
+R_MarkVisLeaf
+
+Marks a leaf and, going up, each node that didn't already have a marked child
+===============
+*/
+static void R_MarkVisLeaf (mnode_t *node)
+{
+	node->visframe = r_visframecount;
+	r_pvsnodes++;
+
+	for (node = node->parent ; node ; node = node->parent)
+	{
+		if (r_visnodechildren[node - cl.worldmodel->nodes]++)
+			return;		// already marked
+		node->visframe = r_visframecount;
+		r_pvsnodes++;
+	}
+}
+
+
+/*
+===============
+R_UnmarkVisLeaf
+
+Unmarks a leaf and, going up, each node that's left without a marked child
+===============
+*/
+static void R_UnmarkVisLeaf (mnode_t *node)
+{
+	node->visframe = r_visframecount - 1;
+	r_pvsnodes--;
+
+	for (node = node->parent ; node ; node = node->parent)
+	{
+		if (--r_visnodechildren[node - cl.worldmodel->nodes])
+			return;		// still has a marked child
+		node->visframe = r_visframecount - 1;
+		r_pvsnodes--;
+	}
 }
 
 
 /*
 ===============
 R_MarkLeaves
+
+Only the leafs whose PVS bits differ from the last view leaf's are touched,
+so moving between leafs costs the bytes of the PVS and the change in it,
+not the whole visible set.  r_visframecount only goes up when a map starts
+over, which drops every old mark at once.
 ===============
 */
 void R_MarkLeaves (void)
 {
 	byte	*vis;
-	mnode_t	*node;
-	int		i;
+	mleaf_t	*leafs;
+	int		i, j, bits, leafnum;
 
 	if (r_oldviewleaf == r_viewleaf)
 		return;
 	
-	r_visframecount++;
 	r_oldviewleaf = r_viewleaf;
 
+	if (!r_visleafsmarked)
+	{
+		r_visframecount++;
+		memset (r_visleafbits, 0, r_visleafbytes);
+		memset (r_visnodechildren, 0, cl.worldmodel->numnodes);
+		r_pvsnodes = 0;
+		r_visleafsmarked = true;
+	}
+
 	vis = Mod_LeafPVS (r_viewleaf, cl.worldmodel);
+	leafs = cl.worldmodel->leafs + 1;	// leaf 0 is the solid leaf
 		
-	for (i=0 ; i<cl.worldmodel->numleafs ; i++)
+	for (i=0 ; i<r_visleafbytes ; i++)
 	{
-		if (vis[i>>3] & (1<<(i&7)))
+		bits = vis[i] ^ r_visleafbits[i];
+		if (!bits)
+			continue;
+		r_visleafbits[i] = vis[i];
+
+		for (j=0 ; j<8 ; j++)
 		{
-			node = (mnode_t *)&cl.worldmodel->leafs[i+1];
-			do
-			{
-				if (node->visframe == r_visframecount)
-					break;
-				node->visframe = r_visframecount;
-				node = node->parent;
-			} while (node);
+			if (!(bits & (1<<j)))
+				continue;
+
+			leafnum = (i<<3) + j;
+			if (leafnum >= cl.worldmodel->numleafs)
+				break;
+
+			if (vis[i] & (1<<j))
+				R_MarkVisLeaf ((mnode_t *)&leafs[leafnum]);
+			else
+				R_UnmarkVisLeaf ((mnode_t *)&leafs[leafnum]);
 		}
 	}
 }
@@ -537,6 +812,8 @@ void R_DrawEntitiesOnList (void)
 	if (!r_drawentities.value)
 		return;
 
+	D_BeginOcclusion ();
+
 	for (i=0 ; i<cl_numvisedicts ; i++)
 	{
 		currententity = cl_visedicts[i];
@@ -875,31 +1152,17 @@ R_EdgeDrawing
 */
 void R_EdgeDrawing (void)
 {
-	edge_t	ledges[NUMSTACKEDGES +
-				((CACHE_SIZE - 1) / sizeof(edge_t)) + 1];
-	surf_t	lsurfs[NUMSTACKSURFACES +
-				((CACHE_SIZE - 1) / sizeof(surf_t)) + 1];
+	double	prof_start;
 
-	if (auxedges)
-	{
-		r_edges = auxedges;
-	}
-	else
-	{
-		r_edges =  (edge_t *)
-				(((long)&ledges[0] + CACHE_SIZE - 1) & ~(CACHE_SIZE - 1));
-	}
+	R_SizeEdgeBuffers ();
 
-	if (r_surfsonstack)
-	{
-		surfaces =  (surf_t *)
-				(((long)&lsurfs[0] + CACHE_SIZE - 1) & ~(CACHE_SIZE - 1));
-		surf_max = &surfaces[r_cnumsurfs];
-	// surface 0 doesn't really exist; it's just a dummy because index 0
-	// is used to indicate no edge attached to surface
-		surfaces--;
-		R_SurfacePatch ();
-	}
+	r_edges = r_edgebuffer;
+
+// surface 0 doesn't really exist; it's just a dummy because index 0
+// is used to indicate no edge attached to surface
+	surfaces = r_surfbuffer;
+	surf_max = &surfaces[r_cnumsurfs + 1];
+	R_SurfacePatch ();
 
 	R_BeginEdgeFrame ();
 
@@ -908,7 +1171,9 @@ void R_EdgeDrawing (void)
 		rw_time1 = Sys_FloatTime ();
 	}
 
+	prof_start = Prof_Begin ();
 	R_RenderWorld ();
+	Prof_End (PROF_WORLDBSP, prof_start);
 
 	if (r_drawculledpolys)
 		R_ScanEdges ();
@@ -923,7 +1188,9 @@ void R_EdgeDrawing (void)
 		db_time1 = rw_time2;
 	}
 
+	prof_start = Prof_Begin ();
 	R_DrawBEntitiesOnList ();
+	Prof_End (PROF_BMODELS, prof_start);
 
 	if (r_dspeeds.value)
 	{
@@ -939,7 +1206,11 @@ void R_EdgeDrawing (void)
 	}
 	
 	if (!(r_drawpolys | r_drawculledpolys))
+	{
+		prof_start = Prof_Begin ();
 		R_ScanEdges ();
+		Prof_End (PROF_EDGESCAN, prof_start);
+	}
 }
 
 
@@ -953,9 +1224,12 @@ r_refdef must be set before the first call
 void R_RenderView_ (void)
 {
 	byte	warpbuffer[WARP_WIDTH * WARP_HEIGHT];
+	double	prof_view, prof_start;
 
 	r_warpbuffer = warpbuffer;
 
+	prof_view = Prof_Begin ();
+
 	if (r_timegraph.value || r_speeds.value || r_dspeeds.value)
 		r_time1 = Sys_FloatTime ();
 
@@ -964,7 +1238,9 @@ void R_RenderView_ (void)
 #ifdef PASSAGES
 SetVisibilityByPassages ();
 #else
+	prof_start = Prof_Begin ();
 	R_MarkLeaves ();	// done here so we know if we're in water
+	Prof_End (PROF_MARKLEAVES, prof_start);
 #endif
 
 // make FDIV fast. This reduces timing precision after we've been running for a
@@ -998,7 +1274,9 @@ SetVisibilityByPassages ();
 		de_time1 = se_time2;
 	}
 
+	prof_start = Prof_Begin ();
 	R_DrawEntitiesOnList ();
+	Prof_End (PROF_ENTITIES, prof_start);
 
 	if (r_dspeeds.value)
 	{
@@ -1014,7 +1292,9 @@ SetVisibilityByPassages ();
 		dp_time1 = Sys_FloatTime ();
 	}
 
+	prof_start = Prof_Begin ();
 	R_DrawParticles ();
+	Prof_End (PROF_PARTICLES, prof_start);
 
 	if (r_dspeeds.value)
 		dp_time2 = Sys_FloatTime ();
@@ -1042,6 +1322,31 @@ SetVisibilityByPassages ();
 	if (r_reportedgeout.value && r_outofedges)
 		Con_Printf ("Short roughly %d edges\n", r_outofedges * 2 / 3);
 
+	if (r_reportedgeout.value &&
+		(r_outofbverts || r_outofbedges || r_outofbpolys))
+	{
+		Con_Printf ("Short %d bmodel verts, %d edges, %d polys\n",
+				r_outofbverts, r_outofbedges, r_outofbpolys);
+	}
+
+// make room for next frame
+	if (r_outofsurfaces)
+		r_cnumsurfs += r_cnumsurfs / 2 + r_outofsurfaces;
+
+	if (r_outofedges)
+		r_numallocatededges += r_numallocatededges / 2 + r_outofedges;
+
+	if (r_outofbverts)
+		r_numallocatedbverts += r_numallocatedbverts / 2 + r_outofbverts;
+
+	if (r_outofbedges)
+		r_numallocatedbedges += r_numallocatedbedges / 2 + r_outofbedges;
+
+	if (r_outofbpolys)
+		r_numallocatedbpolys += r_numallocatedbpolys / 2 + r_outofbpolys;
+
+	Prof_End (PROF_RENDERVIEW, prof_view);
+
 // back to high floating-point precision
 	//Sys_HighFPPrecision ();
 }
@@ -1074,9 +1379,17 @@ R_InitTurb
 */
 void R_InitTurb (void)
 {
-	int		i;
-	
-	for (i=0 ; i<(SIN_BUFFER_SIZE) ; i++)
+	int		i, size;
+
+	size = (vid.width > vid.height ? vid.width : vid.height) + CYCLE;
+	if (size == r_turbsize)
+		return;
+
+	sintable = R_ModeAlloc (sintable, size * sizeof(int), "sintable");
+	intsintable = R_ModeAlloc (intsintable, size * sizeof(int), "intsintable");
+	r_turbsize = size;
+
+	for (i=0 ; i<size ; i++)
 	{
 		sintable[i] = AMP + sin(i*3.14159*2/CYCLE)*AMP;
 		intsintable[i] = AMP2 + sin(i*3.14159*2/CYCLE)*AMP2;	// AMP2, not 20
@@ -101,6 +101,204 @@ void R_TimeRefresh_f (void)
 }
 
 
+/*
+================
+R_TimeView
+
+Best of passes renders of the current view, with the given entities, for
+the benchmarks
+================
+*/
+double R_TimeView (entity_t **ents, int numents, int passes)
+{
+	int		i, pass;
+	double	start, time, best;
+
+	cl_numvisedicts = 0;
+	for (i=0 ; i<numents ; i++)
+		CL_AddVisEdict (ents[i]);
+
+	best = 1e9;
+	for (pass=0 ; pass<passes ; pass++)
+	{
+		VID_LockBuffer ();
+		start = Sys_FloatTime ();
+		R_RenderView ();
+		time = Sys_FloatTime () - start;
+		VID_UnlockBuffer ();
+		if (time < best)
+			best = time;
+	}
+	return best;
+}
+
+
+/*
+==============================================================================
+
+BENCHMARK SCAFFOLDING
+
+The benchmarks time a reference way and a faster way of doing one job over
+the current view, and check that the two leave the same pixels behind.  The
+crowds the model benchmarks stand in front of the view are set up here too.
+
+==============================================================================
+*/
+
+static entity_t	r_benchcrowd[MAX_BENCHCROWD];
+static entity_t	*r_benchents[MAX_BENCHCROWD];
+static entity_t	**r_benchsaved;
+static int		r_numbenchsaved;
+
+
+/*
+================
+R_BenchArgs
+
+Parses [model] [count] [passes] for a crowd benchmark
+================
+*/
+qboolean R_BenchArgs (char *defaultmodel, char **name, int *count, int *passes)
+{
+	if (!cl.worldmodel)
+	{
+		Con_Printf ("%s: no map loaded\n", Cmd_Argv (0));
+		return false;
+	}
+
+	*name = defaultmodel;
+	*count = 64;
+	*passes = 20;
+	if (Cmd_Argc () > 1)
+		*name = Cmd_Argv (1);
+	if (Cmd_Argc () > 2)
+		*count = Q_atoi (Cmd_Argv (2));
+	if (Cmd_Argc () > 3)
+		*passes = Q_atoi (Cmd_Argv (3));
+	if (*count < 1)
+		*count = 1;
+	if (*count > MAX_BENCHCROWD)
+		*count = MAX_BENCHCROWD;
+	if (*passes < 1)
+		*passes = 1;
+	return true;
+}
+
+
+/*
+================
+R_BenchCrowd
+
+Stands count copies of model in rows, from first units in front of the view
+and spacing units apart, each turned a different way, and saves the visible
+entities for R_BenchRestoreEdicts.  The caller fills in whatever else its
+copies need
+================
+*/
+entity_t **R_BenchCrowd (model_t *model, int count, float first, float spacing)
+{
+	entity_t	*e;
+	vec3_t		forward, right, up;
+	int			i, side;
+
+	AngleVectors (r_refdef.viewangles, forward, right, up);
+	for (side=1 ; side*side < count ; side++)
+		;
+	for (i=0, e=r_benchcrowd ; i<count ; i++, e++)
+	{
+		memset (e, 0, sizeof(*e));
+		e->model = model;
+		e->angles[YAW] = (i * 37) % 360;
+		VectorMA (r_refdef.vieworg, first + (i / side) * spacing, forward,
+				e->origin);
+		VectorMA (e->origin, ((i % side) - (side - 1) * 0.5) * spacing, right,
+				e->origin);
+		r_benchents[i] = e;
+	}
+
+	r_numbenchsaved = cl_numvisedicts;
+	r_benchsaved = malloc ((r_numbenchsaved + 1) * sizeof(*r_benchsaved));
+	if (!r_benchsaved)
+		Sys_Error ("R_BenchCrowd: out of memory");
+	for (i=0 ; i<r_numbenchsaved ; i++)
+		r_benchsaved[i] = cl_visedicts[i];
+
+	return r_benchents;
+}
+
+
+/*
+================
+R_BenchRestoreEdicts
+================
+*/
+void R_BenchRestoreEdicts (void)
+{
+	int		i;
+
+	cl_numvisedicts = 0;
+	for (i=0 ; i<r_numbenchsaved ; i++)
+		CL_AddVisEdict (r_benchsaved[i]);
+	free (r_benchsaved);
+	r_benchsaved = NULL;
+}
+
+
+/*
+================
+R_BenchModes
+
+Calls run with mode 0 and then 1, with cvar (if not NULL) set to the mode
+for each call and put back afterwards, and returns how many of the size
+bytes at pixels differ between what the two calls left there
+================
+*/
+int R_BenchModes (char *cvar, void (*run) (int mode), byte *pixels, int size)
+{
+	byte	*first;
+	float	saved;
+	int		i, mode, differ;
+
+	first = malloc (size);
+	if (!first)
+		Sys_Error ("R_BenchModes: out of memory");
+	saved = cvar ? Cvar_VariableValue (cvar) : 0;
+
+	for (mode=0 ; mode<2 ; mode++)
+	{
+		if (cvar)
+			Cvar_SetValue (cvar, mode);
+		run (mode);
+		if (!mode)
+			memcpy (first, pixels, size);
+	}
+
+	if (cvar)
+		Cvar_SetValue (cvar, saved);
+
+	differ = 0;
+	for (i=0 ; i<size ; i++)
+		if (first[i] != pixels[i])
+			differ++;
+
+	free (first);
+	return differ;
+}
+
+
+/*
+================
+R_BenchVerdict
+================
+*/
+char *R_BenchVerdict (int differ)
+{
+	if (!differ)
+		return "identical";
+	return va ("MISMATCH, %i bytes differ", differ);
+}
+
+
 /*
 ================
 R_LineGraph
@@ -200,9 +398,13 @@ void R_PrintTimes (void)
 
 	ms = 1000* (r_time2 - r_time1);
 	
-	Con_Printf ("%5.1f ms %3i/%3i/%3i poly %3i surf\n",
-				ms, c_faceclip, r_polycount, r_drawnpolycount, c_surf);
+	Con_Printf ("%5.1f ms %3i/%3i/%3i poly %3i surf %5i texels\n",
+				ms, c_faceclip, r_polycount, r_drawnpolycount, c_surf,
+				c_surftexels);
+	Con_Printf ("%5i/%5i/%5i nodes visited/culled/pvs %3i occluded\n",
+				r_nodesvisited, r_nodesculled, r_pvsnodes, r_occluded);
 	c_surf = 0;
+	c_surftexels = 0;
 }
 
 
@@ -238,7 +440,8 @@ R_PrintAliasStats
 */
 void R_PrintAliasStats (void)
 {
-	Con_Printf ("%3i polygon model drawn\n", r_amodels_drawn);
+	Con_Printf ("%3i polygon model drawn %3i occluded\n", r_amodels_drawn,
+			r_occluded);
 }
 
 
@@ -379,6 +582,10 @@ void R_SetupFrame (void)
 		Cvar_Set ("r_drawflat", "0");
 	}
 
+// static entities came or went since the leaf lists were built
+	if (r_efragsdirty)
+		R_SortEfrags ();
+
 	if (r_numsurfs.value)
 	{
 		if ((surface_p - surfaces) > r_maxsurfsseen)
@@ -510,13 +717,19 @@ r_refdef.viewangles[2]=    0;
 
 // clear frame counts
 	c_faceclip = 0;
+	r_nodesvisited = 0;
+	r_nodesculled = 0;
 	d_spanpixcount = 0;
 	r_polycount = 0;
 	r_drawnpolycount = 0;
 	r_wholepolycount = 0;
 	r_amodels_drawn = 0;
+	r_occluded = 0;
 	r_outofsurfaces = 0;
 	r_outofedges = 0;
+	r_outofbverts = 0;
+	r_outofbedges = 0;
+	r_outofbpolys = 0;
 
 	D_SetupFrame ();
 }
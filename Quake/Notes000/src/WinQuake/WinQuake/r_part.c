@@ -20,6 +20,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "quakedef.h"
 #include "r_local.h"
+#include "d_local.h"
 
 #define MAX_PARTICLES			2048	// default max # of particles at one
 										//  time
@@ -30,13 +31,36 @@ int		ramp1[8] = {0x6f, 0x6d, 0x6b, 0x69, 0x67, 0x65, 0x63, 0x61};
 int		ramp2[8] = {0x6f, 0x6e, 0x6d, 0x6c, 0x6b, 0x6a, 0x68, 0x66};
 int		ramp3[8] = {0x6d, 0x6b, 6, 5, 4, 3};
 
-particle_t	*active_particles, *free_particles;
+// one particle as an effect fills it in
+typedef struct
+{
+	vec3_t		org;
+	float		color;
+	vec3_t		vel;
+	float		ramp;
+	float		die;
+	ptype_t		type;
+} particle_t;
+
+#define	MAX_NEWPARTICLES	256		// spawned particles held before sorting
+									//  them into the blocks of their type
 
-particle_t	*particles;
-int			r_numparticles;
+particleblock_t	*r_particleblocks;
+int				r_numparticleblocks;
+int				r_numparticles;
+int				r_numactiveparticles;
+
+// the first block of each type is the only one that may be partly full
+particleblock_t	*r_activeparticles[NUM_PARTICLETYPES];
+particleblock_t	*r_freeparticleblocks;
+
+static particle_t	r_newparticles[MAX_NEWPARTICLES];
+static int			r_numnewparticles;
 
 vec3_t			r_pright, r_pup, r_ppn;
 
+void R_ParticleBench_f (void);
+
 
 /*
 ===============
@@ -60,8 +84,77 @@ void R_InitParticles (void)
 		r_numparticles = MAX_PARTICLES;
 	}
 
-	particles = (particle_t *)
-			Hunk_AllocName (r_numparticles * sizeof(particle_t), "particles");
+// a partly full block per type on top of the full ones
+	r_numparticleblocks = (r_numparticles + PARTICLEBLOCK - 1) / PARTICLEBLOCK +
+			NUM_PARTICLETYPES;
+	r_particleblocks = (particleblock_t *)
+			Hunk_AllocName (r_numparticleblocks * sizeof(particleblock_t),
+			"particles");
+
+	Cmd_AddCommand ("r_partbench", R_ParticleBench_f);
+}
+
+
+/*
+===============
+R_FlushNewParticles
+
+Moves the spawned particles into the blocks of their types
+===============
+*/
+static void R_FlushNewParticles (void)
+{
+	particle_t		*p;
+	particleblock_t	*pb;
+	int				i, n;
+
+	for (i=0, p=r_newparticles ; i<r_numnewparticles ; i++, p++)
+	{
+		pb = r_activeparticles[p->type];
+		if (!pb || pb->count == PARTICLEBLOCK)
+		{
+			pb = r_freeparticleblocks;
+			if (!pb)
+				Sys_Error ("R_FlushNewParticles: out of blocks");
+			r_freeparticleblocks = pb->next;
+			pb->next = r_activeparticles[p->type];
+			pb->count = 0;
+			r_activeparticles[p->type] = pb;
+		}
+
+		n = pb->count++;
+		pb->org[0][n] = p->org[0];
+		pb->org[1][n] = p->org[1];
+		pb->org[2][n] = p->org[2];
+		pb->color[n] = p->color;
+		pb->vel[0][n] = p->vel[0];
+		pb->vel[1][n] = p->vel[1];
+		pb->vel[2][n] = p->vel[2];
+		pb->ramp[n] = p->ramp;
+		pb->die[n] = p->die;
+	}
+
+	r_numactiveparticles += r_numnewparticles;
+	r_numnewparticles = 0;
+}
+
+
+/*
+===============
+R_NewParticle
+
+Hands out a particle for an effect to fill in, or NULL when the -particles
+limit is reached.  Particles are only sorted into the blocks of their type
+once the effect is done with them
+===============
+*/
+static particle_t *R_NewParticle (void)
+{
+	if (r_numactiveparticles + r_numnewparticles >= r_numparticles)
+		return NULL;
+	if (r_numnewparticles == MAX_NEWPARTICLES)
+		R_FlushNewParticles ();
+	return &r_newparticles[r_numnewparticles++];
 }
 
 #ifdef QUAKE2
@@ -80,12 +173,8 @@ void R_DarkFieldParticles (entity_t *ent)
 		for (j=-16 ; j<16 ; j+=8)
 			for (k=0 ; k<32 ; k+=8)
 			{
-				if (!free_particles)
+				if (!(p = R_NewParticle ()))
 					return;
-				p = free_particles;
-				free_particles = p->next;
-				p->next = active_particles;
-				active_particles = p;
 		
 				p->die = cl.time + 0.2 + (rand()&7) * 0.02;
 				p->color = 150 + rand()%6;
@@ -157,12 +246,8 @@ avelocities[0][i] = (rand()&255) * 0.01;
 		forward[1] = cp*sy;
 		forward[2] = -sp;
 
-		if (!free_particles)
+		if (!(p = R_NewParticle ()))
 			return;
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
 
 		p->die = cl.time + 0.01;
 		p->color = 0x6f;
@@ -184,12 +269,15 @@ void R_ClearParticles (void)
 {
 	int		i;
 	
-	free_particles = &particles[0];
-	active_particles = NULL;
-
-	for (i=0 ;i<r_numparticles ; i++)
-		particles[i].next = &particles[i+1];
-	particles[r_numparticles-1].next = NULL;
+	r_freeparticleblocks = &r_particleblocks[0];
+	for (i=0 ; i<r_numparticleblocks ; i++)
+		r_particleblocks[i].next = &r_particleblocks[i+1];
+	r_particleblocks[r_numparticleblocks-1].next = NULL;
+
+	for (i=0 ; i<NUM_PARTICLETYPES ; i++)
+		r_activeparticles[i] = NULL;
+	r_numactiveparticles = 0;
+	r_numnewparticles = 0;
 }
 
 
@@ -220,15 +308,11 @@ void R_ReadPointFile_f (void)
 			break;
 		c++;
 		
-		if (!free_particles)
+		if (!(p = R_NewParticle ()))
 		{
 			Con_Printf ("Not enough free particles\n");
 			break;
 		}
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
 		
 		p->die = 99999;
 		p->color = (-c)&15;
@@ -281,12 +365,8 @@ void R_ParticleExplosion (vec3_t org)
 	
 	for (i=0 ; i<1024 ; i++)
 	{
-		if (!free_particles)
+		if (!(p = R_NewParticle ()))
 			return;
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
 
 		p->die = cl.time + 5;
 		p->color = ramp1[0];
@@ -326,12 +406,8 @@ void R_ParticleExplosion2 (vec3_t org, int colorStart, int colorLength)
 
 	for (i=0; i<512; i++)
 	{
-		if (!free_particles)
+		if (!(p = R_NewParticle ()))
 			return;
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
 
 		p->die = cl.time + 0.3;
 		p->color = colorStart + (colorMod % colorLength);
@@ -359,12 +435,8 @@ void R_BlobExplosion (vec3_t org)
 	
 	for (i=0 ; i<1024 ; i++)
 	{
-		if (!free_particles)
+		if (!(p = R_NewParticle ()))
 			return;
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
 
 		p->die = cl.time + 1 + (rand()&8)*0.05;
 
@@ -404,12 +476,8 @@ void R_RunParticleEffect (vec3_t org, vec3_t dir, int color, int count)
 	
 	for (i=0 ; i<count ; i++)
 	{
-		if (!free_particles)
+		if (!(p = R_NewParticle ()))
 			return;
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
 
 		if (count == 1024)
 		{	// rocket explosion
@@ -467,12 +535,8 @@ void R_LavaSplash (vec3_t org)
 		for (j=-16 ; j<16 ; j++)
 			for (k=0 ; k<1 ; k++)
 			{
-				if (!free_particles)
+				if (!(p = R_NewParticle ()))
 					return;
-				p = free_particles;
-				free_particles = p->next;
-				p->next = active_particles;
-				active_particles = p;
 		
 				p->die = cl.time + 2 + (rand()&31) * 0.02;
 				p->color = 224 + (rand()&7);
@@ -509,12 +573,8 @@ void R_TeleportSplash (vec3_t org)
 		for (j=-16 ; j<16 ; j+=4)
 			for (k=-24 ; k<32 ; k+=4)
 			{
-				if (!free_particles)
+				if (!(p = R_NewParticle ()))
 					return;
-				p = free_particles;
-				free_particles = p->next;
-				p->next = active_particles;
-				active_particles = p;
 		
 				p->die = cl.time + 0.2 + (rand()&7) * 0.02;
 				p->color = 7 + (rand()&7);
@@ -557,12 +617,8 @@ void R_RocketTrail (vec3_t start, vec3_t end, int type)
 	{
 		len -= dec;
 
-		if (!free_particles)
+		if (!(p = R_NewParticle ()))
 			return;
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
 		
 		VectorCopy (vec3_origin, p->vel);
 		p->die = cl.time + 2;
@@ -639,6 +695,175 @@ void R_RocketTrail (vec3_t start, vec3_t end, int type)
 }
 
 
+/*
+===============
+R_KillParticles
+
+Drops the particles of a type that have died, filling each hole with the
+last particle of the partly full first block, so every other block stays
+full
+===============
+*/
+static void R_KillParticles (int type)
+{
+	particleblock_t	*pb, *head, *next;
+	int				i, last;
+
+	for (pb = r_activeparticles[type] ; pb ; pb = next)
+	{
+		next = pb->next;
+
+		for (i=0 ; i<pb->count ; )
+		{
+			if (pb->die[i] >= cl.time)
+			{
+				i++;
+				continue;
+			}
+
+			head = r_activeparticles[type];
+			last = --head->count;
+			r_numactiveparticles--;
+
+			if (head != pb || last != i)
+			{
+				pb->org[0][i] = head->org[0][last];
+				pb->org[1][i] = head->org[1][last];
+				pb->org[2][i] = head->org[2][last];
+				pb->color[i] = head->color[last];
+				pb->vel[0][i] = head->vel[0][last];
+				pb->vel[1][i] = head->vel[1][last];
+				pb->vel[2][i] = head->vel[2][last];
+				pb->ramp[i] = head->ramp[last];
+				pb->die[i] = head->die[last];
+			}
+
+			if (!head->count)
+			{
+				r_activeparticles[type] = head->next;
+				head->next = r_freeparticleblocks;
+				r_freeparticleblocks = head;
+			}
+		}
+	}
+}
+
+
+// how a type of particle moves, worked out once a frame
+typedef struct
+{
+	float	scale[3];		// velocity change as a fraction of the velocity
+	float	gravity;		// vertical velocity change
+	float	ramptime;		// color ramp advance
+	float	rampend;		// dies at the end of the ramp
+	int		*ramp;			// NULL for no color ramp
+} partphysics_t;
+
+
+/*
+===============
+R_MoveParticles
+
+Steps a block of particles of one type.  Types that leave a velocity alone
+scale it by zero, which changes nothing, so every type runs the same
+branch free loop, four particles at a time under d_simd
+===============
+*/
+static void R_MoveParticles (particleblock_t *pb, partphysics_t *ph,
+	float frametime)
+{
+	int		i, count;
+
+	count = pb->count;
+	i = 0;
+
+#if idSIMD
+	if (d_simd.value)
+	{
+#if idNEON
+		float32x4_t	ft, s0, s1, s2, g, v0, v1, v2;
+
+		ft = vdupq_n_f32 (frametime);
+		s0 = vdupq_n_f32 (ph->scale[0]);
+		s1 = vdupq_n_f32 (ph->scale[1]);
+		s2 = vdupq_n_f32 (ph->scale[2]);
+		g = vdupq_n_f32 (ph->gravity);
+
+		for ( ; i+4 <= count ; i+=4)
+		{
+			v0 = vld1q_f32 (&pb->vel[0][i]);
+			v1 = vld1q_f32 (&pb->vel[1][i]);
+			v2 = vld1q_f32 (&pb->vel[2][i]);
+
+			vst1q_f32 (&pb->org[0][i],
+					vaddq_f32 (vld1q_f32 (&pb->org[0][i]), vmulq_f32 (v0, ft)));
+			vst1q_f32 (&pb->org[1][i],
+					vaddq_f32 (vld1q_f32 (&pb->org[1][i]), vmulq_f32 (v1, ft)));
+			vst1q_f32 (&pb->org[2][i],
+					vaddq_f32 (vld1q_f32 (&pb->org[2][i]), vmulq_f32 (v2, ft)));
+
+			vst1q_f32 (&pb->vel[0][i], vaddq_f32 (v0, vmulq_f32 (v0, s0)));
+			vst1q_f32 (&pb->vel[1][i], vaddq_f32 (v1, vmulq_f32 (v1, s1)));
+			vst1q_f32 (&pb->vel[2][i],
+					vaddq_f32 (vaddq_f32 (v2, vmulq_f32 (v2, s2)), g));
+		}
+#else
+		__m128	ft, s0, s1, s2, g, v0, v1, v2;
+
+		ft = _mm_set1_ps (frametime);
+		s0 = _mm_set1_ps (ph->scale[0]);
+		s1 = _mm_set1_ps (ph->scale[1]);
+		s2 = _mm_set1_ps (ph->scale[2]);
+		g = _mm_set1_ps (ph->gravity);
+
+		for ( ; i+4 <= count ; i+=4)
+		{
+			v0 = _mm_loadu_ps (&pb->vel[0][i]);
+			v1 = _mm_loadu_ps (&pb->vel[1][i]);
+			v2 = _mm_loadu_ps (&pb->vel[2][i]);
+
+			_mm_storeu_ps (&pb->org[0][i],
+					_mm_add_ps (_mm_loadu_ps (&pb->org[0][i]), _mm_mul_ps (v0, ft)));
+			_mm_storeu_ps (&pb->org[1][i],
+					_mm_add_ps (_mm_loadu_ps (&pb->org[1][i]), _mm_mul_ps (v1, ft)));
+			_mm_storeu_ps (&pb->org[2][i],
+					_mm_add_ps (_mm_loadu_ps (&pb->org[2][i]), _mm_mul_ps (v2, ft)));
+
+			_mm_storeu_ps (&pb->vel[0][i], _mm_add_ps (v0, _mm_mul_ps (v0, s0)));
+			_mm_storeu_ps (&pb->vel[1][i], _mm_add_ps (v1, _mm_mul_ps (v1, s1)));
+			_mm_storeu_ps (&pb->vel[2][i],
+					_mm_add_ps (_mm_add_ps (v2, _mm_mul_ps (v2, s2)), g));
+		}
+#endif
+	}
+#endif
+
+	for ( ; i<count ; i++)
+	{
+		pb->org[0][i] += pb->vel[0][i]*frametime;
+		pb->org[1][i] += pb->vel[1][i]*frametime;
+		pb->org[2][i] += pb->vel[2][i]*frametime;
+
+		pb->vel[0][i] += pb->vel[0][i]*ph->scale[0];
+		pb->vel[1][i] += pb->vel[1][i]*ph->scale[1];
+		pb->vel[2][i] += pb->vel[2][i]*ph->scale[2];
+		pb->vel[2][i] += ph->gravity;
+	}
+
+	if (!ph->ramp)
+		return;
+
+	for (i=0 ; i<count ; i++)
+	{
+		pb->ramp[i] += ph->ramptime;
+		if (pb->ramp[i] >= ph->rampend)
+			pb->die[i] = -1;
+		else
+			pb->color[i] = ph->ramp[(int)pb->ramp[i]];
+	}
+}
+
+
 /*
 ===============
 R_DrawParticles
@@ -648,16 +873,18 @@ extern	cvar_t	sv_gravity;
 
 void R_DrawParticles (void)
 {
-	particle_t		*p, *kill;
+	particleblock_t	*pb;
+	partphysics_t	physics[NUM_PARTICLETYPES], *ph;
 	float			grav;
-	int				i;
+	int				type;
 	float			time2, time3;
 	float			time1;
 	float			dvel;
 	float			frametime;
 	
 #ifdef GLQUAKE
-	vec3_t			up, right;
+	int				i;
+	vec3_t			up, right, org;
 	float			scale;
 
     GL_Bind(particletexture);
@@ -680,121 +907,223 @@ void R_DrawParticles (void)
 	time1 = frametime * 5;
 	grav = frametime * sv_gravity.value * 0.05;
 	dvel = 4*frametime;
-	
-	for ( ;; ) 
-	{
-		kill = active_particles;
-		if (kill && kill->die < cl.time)
-		{
-			active_particles = kill->next;
-			kill->next = free_particles;
-			free_particles = kill;
-			continue;
-		}
-		break;
-	}
 
-	for (p=active_particles ; p ; p=p->next)
+	memset (physics, 0, sizeof(physics));
+
+	physics[pt_fire].gravity = grav;
+	physics[pt_fire].ramptime = time1;
+	physics[pt_fire].rampend = 6;
+	physics[pt_fire].ramp = ramp3;
+
+	ph = &physics[pt_explode];
+	ph->scale[0] = ph->scale[1] = ph->scale[2] = dvel;
+	ph->gravity = -grav;
+	ph->ramptime = time2;
+	ph->rampend = 8;
+	ph->ramp = ramp1;
+
+	ph = &physics[pt_explode2];
+	ph->scale[0] = ph->scale[1] = ph->scale[2] = -frametime;
+	ph->gravity = -grav;
+	ph->ramptime = time3;
+	ph->rampend = 8;
+	ph->ramp = ramp2;
+
+	ph = &physics[pt_blob];
+	ph->scale[0] = ph->scale[1] = ph->scale[2] = dvel;
+	ph->gravity = -grav;
+
+	ph = &physics[pt_blob2];
+	ph->scale[0] = ph->scale[1] = -dvel;
+	ph->gravity = -grav;
+
+#ifdef QUAKE2
+	physics[pt_grav].gravity = -(grav * 20);
+#else
+	physics[pt_grav].gravity = -grav;
+#endif
+	physics[pt_slowgrav].gravity = -grav;
+
+	R_FlushNewParticles ();
+
+// particles are drawn a type at a time, not in the order they were spawned
+// as the old single list did, so where two land on the same pixel at the
+// same depth a different one can win
+	for (type=0 ; type<NUM_PARTICLETYPES ; type++)
 	{
-		for ( ;; )
+		R_KillParticles (type);
+
+		for (pb = r_activeparticles[type] ; pb ; pb = pb->next)
 		{
-			kill = p->next;
-			if (kill && kill->die < cl.time)
+#ifdef GLQUAKE
+			for (i=0 ; i<pb->count ; i++)
 			{
-				p->next = kill->next;
-				kill->next = free_particles;
-				free_particles = kill;
-				continue;
+				org[0] = pb->org[0][i];
+				org[1] = pb->org[1][i];
+				org[2] = pb->org[2][i];
+
+				// hack a scale up to keep particles from disapearing
+				scale = (org[0] - r_origin[0])*vpn[0] + (org[1] - r_origin[1])*vpn[1]
+					+ (org[2] - r_origin[2])*vpn[2];
+				if (scale < 20)
+					scale = 1;
+				else
+					scale = 1 + scale * 0.004;
+				glColor3ubv ((byte *)&d_8to24table[(int)pb->color[i]]);
+				glTexCoord2f (0,0);
+				glVertex3fv (org);
+				glTexCoord2f (1,0);
+				glVertex3f (org[0] + up[0]*scale, org[1] + up[1]*scale, org[2] + up[2]*scale);
+				glTexCoord2f (0,1);
+				glVertex3f (org[0] + right[0]*scale, org[1] + right[1]*scale, org[2] + right[2]*scale);
 			}
-			break;
+#else
+			D_DrawParticles (pb);
+#endif
+			R_MoveParticles (pb, &physics[type], frametime);
 		}
+	}
 
 #ifdef GLQUAKE
-		// hack a scale up to keep particles from disapearing
-		scale = (p->org[0] - r_origin[0])*vpn[0] + (p->org[1] - r_origin[1])*vpn[1]
-			+ (p->org[2] - r_origin[2])*vpn[2];
-		if (scale < 20)
-			scale = 1;
-		else
-			scale = 1 + scale * 0.004;
-		glColor3ubv ((byte *)&d_8to24table[(int)p->color]);
-		glTexCoord2f (0,0);
-		glVertex3fv (p->org);
-		glTexCoord2f (1,0);
-		glVertex3f (p->org[0] + up[0]*scale, p->org[1] + up[1]*scale, p->org[2] + up[2]*scale);
-		glTexCoord2f (0,1);
-		glVertex3f (p->org[0] + right[0]*scale, p->org[1] + right[1]*scale, p->org[2] + right[2]*scale);
+	glEnd ();
+	glDisable (GL_BLEND);
+	glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
 #else
-		D_DrawParticle (p);
+	D_EndParticles ();
 #endif
-		p->org[0] += p->vel[0]*frametime;
-		p->org[1] += p->vel[1]*frametime;
-		p->org[2] += p->vel[2]*frametime;
-		
-		switch (p->type)
-		{
-		case pt_static:
-			break;
-		case pt_fire:
-			p->ramp += time1;
-			if (p->ramp >= 6)
-				p->die = -1;
-			else
-				p->color = ramp3[(int)p->ramp];
-			p->vel[2] += grav;
-			break;
+}
 
-		case pt_explode:
-			p->ramp += time2;
-			if (p->ramp >=8)
-				p->die = -1;
-			else
-				p->color = ramp1[(int)p->ramp];
-			for (i=0 ; i<3 ; i++)
-				p->vel[i] += p->vel[i]*dvel;
-			p->vel[2] -= grav;
-			break;
 
-		case pt_explode2:
-			p->ramp += time3;
-			if (p->ramp >=8)
-				p->die = -1;
-			else
-				p->color = ramp2[(int)p->ramp];
-			for (i=0 ; i<3 ; i++)
-				p->vel[i] -= p->vel[i]*frametime;
-			p->vel[2] -= grav;
-			break;
+static byte		*r_partbenchpixels, *r_partbenchz;
+static int		r_partbenchcount, r_partbenchframes;
+static int		r_partbenchspawned, r_partbenchleft;
+static double	r_partbenchspawn[2], r_partbenchstep[2];
 
-		case pt_blob:
-			for (i=0 ; i<3 ; i++)
-				p->vel[i] += p->vel[i]*dvel;
-			p->vel[2] -= grav;
+/*
+===============
+R_ParticleBenchRun
+===============
+*/
+static void R_ParticleBenchRun (int mode)
+{
+	int			i;
+	float		oldtime, time;
+	double		start;
+	vec3_t		forward, right, up, org;
+
+	AngleVectors (r_refdef.viewangles, forward, right, up);
+	oldtime = cl.oldtime;
+	time = cl.time;
+
+	memcpy (vid.buffer, r_partbenchpixels, vid.rowbytes * vid.height);
+	memcpy (d_pzbuffer, r_partbenchz, d_zrowbytes * vid.height);
+	R_ClearParticles ();
+	srand (0);
+
+// a spread of effects from a little way in front of the view
+	start = Sys_FloatTime ();
+	for (i=0 ; r_numactiveparticles + r_numnewparticles < r_partbenchcount ; i++)
+	{
+		VectorMA (r_refdef.vieworg, 200 + (i & 7) * 40, forward, org);
+		VectorMA (org, ((i >> 3) % 5 - 2) * 80, right, org);
+		switch (i & 3)
+		{
+		case 0:
+			R_ParticleExplosion (org);
 			break;
-
-		case pt_blob2:
-			for (i=0 ; i<2 ; i++)
-				p->vel[i] -= p->vel[i]*dvel;
-			p->vel[2] -= grav;
+		case 1:
+			R_BlobExplosion (org);
 			break;
-
-		case pt_grav:
-#ifdef QUAKE2
-			p->vel[2] -= grav * 20;
+		case 2:
+			R_LavaSplash (org);
 			break;
-#endif
-		case pt_slowgrav:
-			p->vel[2] -= grav;
+		case 3:
+			R_TeleportSplash (org);
 			break;
 		}
 	}
+	R_FlushNewParticles ();
+	r_partbenchspawn[mode] = Sys_FloatTime () - start;
+	r_partbenchspawned = r_numactiveparticles;
 
-#ifdef GLQUAKE
-	glEnd ();
-	glDisable (GL_BLEND);
-	glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
-#else
-	D_EndParticles ();
-#endif
+	start = Sys_FloatTime ();
+	for (i=0 ; i<r_partbenchframes ; i++)
+	{
+		cl.oldtime = cl.time;
+		cl.time += 0.005;
+		R_DrawParticles ();
+	}
+	r_partbenchstep[mode] = (Sys_FloatTime () - start) / r_partbenchframes;
+	r_partbenchleft = r_numactiveparticles;
+
+	cl.oldtime = oldtime;
+	cl.time = time;
 }
 
+
+/*
+===============
+R_ParticleBench_f
+
+r_partbench [particles] [frames]
+
+Fills the pool with explosions and splashes in front of the view, then
+times spawning them and stepping and drawing them over frames of 5 ms,
+with and without d_simd
+===============
+*/
+void R_ParticleBench_f (void)
+{
+	int			size, zsize, differ;
+
+	if (!cl.worldmodel)
+	{
+		Con_Printf ("r_partbench: no map loaded\n");
+		return;
+	}
+
+	r_partbenchcount = r_numparticles;
+	r_partbenchframes = 100;
+	if (Cmd_Argc () > 1)
+		r_partbenchcount = Q_atoi (Cmd_Argv (1));
+	if (Cmd_Argc () > 2)
+		r_partbenchframes = Q_atoi (Cmd_Argv (2));
+	if (r_partbenchcount > r_numparticles)
+	{
+		Con_Printf ("r_partbench: only %i particles, see -particles\n",
+				r_numparticles);
+		r_partbenchcount = r_numparticles;
+	}
+	if (r_partbenchframes < 1)
+		r_partbenchframes = 1;
+
+	size = vid.rowbytes * vid.height;
+	zsize = d_zrowbytes * vid.height;
+	r_partbenchpixels = malloc (size);
+	r_partbenchz = malloc (zsize);
+	if (!r_partbenchpixels || !r_partbenchz)
+		Sys_Error ("R_ParticleBench_f: out of memory");
+
+	VID_LockBuffer ();
+	memcpy (r_partbenchpixels, vid.buffer, size);
+	memcpy (r_partbenchz, d_pzbuffer, zsize);
+
+	differ = R_BenchModes ("d_simd", R_ParticleBenchRun, vid.buffer, size);
+
+	memcpy (vid.buffer, r_partbenchpixels, size);
+	memcpy (d_pzbuffer, r_partbenchz, zsize);
+	VID_UnlockBuffer ();
+
+	R_ClearParticles ();
+
+	Con_Printf ("%i particles spawned, %i left after %i frames\n",
+			r_partbenchspawned, r_partbenchleft, r_partbenchframes);
+	Con_Printf ("scalar: spawn %.3f ms, %.3f ms a frame\n",
+			r_partbenchspawn[0] * 1000, r_partbenchstep[0] * 1000);
+	Con_Printf ("simd:   spawn %.3f ms, %.3f ms a frame, %s\n",
+			r_partbenchspawn[1] * 1000, r_partbenchstep[1] * 1000,
+			R_BenchVerdict (differ));
+
+	free (r_partbenchpixels);
+	free (r_partbenchz);
+}
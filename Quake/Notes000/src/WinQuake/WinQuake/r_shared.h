@@ -29,12 +29,10 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #define	MAXVERTS	16					// max points in a surface polygon
 #define MAXWORKINGVERTS	(MAXVERTS+4)	// max points in an intermediate
 										//  polygon (while processing)
-// !!! if this is changed, it must be changed in d_ifacea.h too !!!
-#define	MAXHEIGHT		1024
-#define	MAXWIDTH		1280
-#define MAXDIMENSION	((MAXHEIGHT > MAXWIDTH) ? MAXHEIGHT : MAXWIDTH)
-
-#define SIN_BUFFER_SIZE	(MAXDIMENSION+CYCLE)
+// largest mode the video drivers will offer; the renderer sizes its own
+// buffers from vid when the mode changes
+#define	MAXHEIGHT		4320
+#define	MAXWIDTH		7680
 
 #define INFINITE_DISTANCE	0x10000		// distance that's always guaranteed to
 										//  be farther away than anything in
@@ -44,8 +42,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 extern void	R_DrawLine (polyvert_t *polyvert0, polyvert_t *polyvert1);
 
-extern int		cachewidth;
-extern pixel_t	*cacheblock;
+extern THREADLOCAL int		cachewidth;
+extern THREADLOCAL pixel_t	*cacheblock;
 extern int		screenwidth;
 
 extern	float	pixelAspect;
@@ -54,14 +52,24 @@ extern int		r_drawnpolycount;
 
 extern cvar_t	r_clearcolor;
 
-extern int	sintable[SIN_BUFFER_SIZE];
-extern int	intsintable[SIN_BUFFER_SIZE];
+extern int	*sintable;			// [max (vid.width, vid.height) + CYCLE]
+extern int	*intsintable;
+
+extern int	r_edgeshift;		// fraction bits in edge_t u, 20 below 2048 wide
+
+void *R_ModeAlloc (void *buffer, int size, char *name);
+
+// the benchmarks' reference and fast runs, compared pixel for pixel
+int R_BenchModes (char *cvar, void (*run) (int mode), byte *pixels, int size);
+char *R_BenchVerdict (int differ);
 
 extern	vec3_t	vup, base_vup;
 extern	vec3_t	vpn, base_vpn;
 extern	vec3_t	vright, base_vright;
 extern	entity_t		*currententity;
 
+// edges, surfaces and spans at 320x200; the buffers scale with the mode
+// height and grow when a frame runs short
 #define NUMSTACKEDGES		2400
 #define	MINEDGES			NUMSTACKEDGES
 #define NUMSTACKSURFACES	800
@@ -22,20 +22,22 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "quakedef.h"
 #include "r_local.h"
 
-drawsurf_t	r_drawsurf;
-
-int				lightleft, sourcesstep, blocksize, sourcetstep;
-int				lightdelta, lightdeltastep;
-int				lightright, lightleftstep, lightrightstep, blockdivshift;
-unsigned		blockdivmask;
-void			*prowdestbase;
-unsigned char	*pbasesource;
-int				surfrowbytes;	// used by ASM files
-unsigned		*r_lightptr;
-int				r_stepback;
-int				r_lightwidth;
-int				r_numhblocks, r_numvblocks;
-unsigned char	*r_source, *r_sourcemax;
+// thread local so that surface cache builders can run on the d_threads
+// workers
+THREADLOCAL drawsurf_t	r_drawsurf;
+
+THREADLOCAL int				lightleft, sourcesstep, blocksize, sourcetstep;
+THREADLOCAL int				lightdelta, lightdeltastep;
+THREADLOCAL int				lightright, lightleftstep, lightrightstep, blockdivshift;
+THREADLOCAL unsigned		blockdivmask;
+THREADLOCAL void			*prowdestbase;
+THREADLOCAL unsigned char	*pbasesource;
+THREADLOCAL int				surfrowbytes;	// used by ASM files
+THREADLOCAL unsigned		*r_lightptr;
+THREADLOCAL int				r_stepback;
+THREADLOCAL int				r_lightwidth;
+THREADLOCAL int				r_numhblocks, r_numvblocks;
+THREADLOCAL unsigned char	*r_source, *r_sourcemax;
 
 void R_DrawSurfaceBlock8_mip0 (void);
 void R_DrawSurfaceBlock8_mip1 (void);
@@ -49,9 +51,264 @@ static void	(*surfmiptable[4])(void) = {
 	R_DrawSurfaceBlock8_mip3
 };
 
+#if idSIMD
+void R_DrawSurfaceBlock8SIMD_mip0 (void);
+void R_DrawSurfaceBlock8SIMD_mip1 (void);
 
+static void	(*surfmiptablesimd[4])(void) = {
+	R_DrawSurfaceBlock8SIMD_mip0,
+	R_DrawSurfaceBlock8SIMD_mip1,
+	R_DrawSurfaceBlock8_mip2,
+	R_DrawSurfaceBlock8_mip3
+};
+#endif
+
+
+
+THREADLOCAL unsigned	blocklights[18*18];
+
+/*
+===============
+R_AddLightMaps
+
+dest[i] += lightmaps[k][i] * scales[k], summed over the maps.  Lightstyle
+values and their deltas are well inside 16 bits signed, so the vector
+products are exact and the sums wrap the same as the scalar ones
+===============
+*/
+static void R_AddLightMaps (unsigned *dest, byte **lightmaps, int *scales,
+	int nummaps, int size)
+{
+	int			i, k;
+
+	i = 0;
+#if idSIMD
+	if (d_simd.value)
+	{
+		for ( ; i+8 <= size ; i+=8)
+		{
+#if idNEON
+			int32x4_t	a0, a1;
+			int16x8_t	lm;
+
+			a0 = vld1q_s32 ((int *)dest + i);
+			a1 = vld1q_s32 ((int *)dest + i + 4);
+			for (k=0 ; k<nummaps ; k++)
+			{
+				lm = vreinterpretq_s16_u16 (vmovl_u8 (vld1_u8 (lightmaps[k] + i)));
+				a0 = vmlal_n_s16 (a0, vget_low_s16 (lm), (short)scales[k]);
+				a1 = vmlal_n_s16 (a1, vget_high_s16 (lm), (short)scales[k]);
+			}
+			vst1q_s32 ((int *)dest + i, a0);
+			vst1q_s32 ((int *)dest + i + 4, a1);
+#else
+			__m128i		a0, a1, lm, scale, zero;
+
+			zero = _mm_setzero_si128 ();
+			a0 = _mm_loadu_si128 ((__m128i *)(dest + i));
+			a1 = _mm_loadu_si128 ((__m128i *)(dest + i + 4));
+			for (k=0 ; k<nummaps ; k++)
+			{
+			// each 32 bit lane holds (texel, 0) and (scale, junk) as
+			// 16 bit pairs, so madd yields texel * scale
+				lm = _mm_unpacklo_epi8 (_mm_loadl_epi64 ((__m128i *)(lightmaps[k] + i)), zero);
+				scale = _mm_set1_epi32 ((unsigned short)scales[k]);
+				a0 = _mm_add_epi32 (a0, _mm_madd_epi16 (_mm_unpacklo_epi16 (lm, zero), scale));
+				a1 = _mm_add_epi32 (a1, _mm_madd_epi16 (_mm_unpackhi_epi16 (lm, zero), scale));
+			}
+			_mm_storeu_si128 ((__m128i *)(dest + i), a0);
+			_mm_storeu_si128 ((__m128i *)(dest + i + 4), a1);
+#endif
+		}
+	}
+#endif
+
+	for (k=0 ; k<nummaps ; k++)
+	{
+		byte		*lightmap;
+		unsigned	scale;
+		int			j;
+
+		lightmap = lightmaps[k];
+		scale = scales[k];
+		for (j=i ; j<size ; j++)
+			dest[j] += lightmap[j] * scale;
+	}
+}
+
+
+/*
+===============
+R_CombineLightMaps
+
+Ambient plus all the styled lightmaps, in 8.8
+===============
+*/
+static void R_CombineLightMaps (unsigned *dest, int size)
+{
+	msurface_t	*surf;
+	byte		*lightmaps[MAXLIGHTMAPS];
+	int			i, maps;
+
+	surf = r_drawsurf.surf;
+
+// clear to ambient
+	for (i=0 ; i<size ; i++)
+		dest[i] = r_refdef.ambientlight<<8;
+
+// add all the lightmaps
+	if (!surf->samples)
+		return;
+
+	for (maps = 0 ; maps < MAXLIGHTMAPS && surf->styles[maps] != 255 ;
+		 maps++)
+		lightmaps[maps] = surf->samples + maps*size;
+
+	R_AddLightMaps (dest, lightmaps, r_drawsurf.lightadj, maps, size);
+}
+
+
+/*
+===============
+R_UpdateStaticLight
+
+Brings surf->staticlight up to the current lightstyles, recombining only
+the lightmaps whose style has changed since it was last built
+===============
+*/
+static void R_UpdateStaticLight (int size)
+{
+	msurface_t	*surf;
+	byte		*lightmaps[MAXLIGHTMAPS];
+	int			deltas[MAXLIGHTMAPS];
+	int			maps, changed;
+
+	surf = r_drawsurf.surf;
+
+	if (!surf->staticvalid || surf->staticambient != r_refdef.ambientlight)
+	{
+		R_CombineLightMaps (surf->staticlight, size);
+		for (maps=0 ; maps<MAXLIGHTMAPS ; maps++)
+			surf->staticlightadj[maps] = r_drawsurf.lightadj[maps];
+		surf->staticambient = r_refdef.ambientlight;
+		surf->staticvalid = true;
+		return;
+	}
+
+	changed = 0;
+	for (maps = 0 ; maps < MAXLIGHTMAPS && surf->styles[maps] != 255 ;
+		 maps++)
+	{
+		if (surf->staticlightadj[maps] == r_drawsurf.lightadj[maps])
+			continue;
+		lightmaps[changed] = surf->samples + maps*size;
+		deltas[changed] = r_drawsurf.lightadj[maps] - surf->staticlightadj[maps];
+		surf->staticlightadj[maps] = r_drawsurf.lightadj[maps];
+		changed++;
+	}
+
+	if (changed)
+		R_AddLightMaps (surf->staticlight, lightmaps, deltas, changed, size);
+}
+
+
+/*
+===============
+R_AddLightRow
+
+Adds one dynamic light to a row of luxels, td being the row's distance
+from the light along t.  The vector path rounds exactly as the scalar
+one, converting each luxel to float, adding and truncating back
+===============
+*/
+static void R_AddLightRow (unsigned *dest, int smax, float local0, int td,
+	float rad, float minlight)
+{
+	int			s, sd;
+	float		dist;
+
+	s = 0;
+#if idSIMD
+	if (d_simd.value)
+	{
+#if idNEON
+		static const int	steps[4] = {0, 16, 32, 48};
+		int32x4_t	vtd, vtdhalf, vsteps, vsd, vdist, vbl;
+		float32x4_t	vlocal, vrad, vmin, vdistf;
+		uint32x4_t	lit;
+
+		vtd = vdupq_n_s32 (td);
+		vtdhalf = vdupq_n_s32 (td>>1);
+		vsteps = vld1q_s32 (steps);
+		vlocal = vdupq_n_f32 (local0);
+		vrad = vdupq_n_f32 (rad);
+		vmin = vdupq_n_f32 (minlight);
+
+		for ( ; s+4 <= smax ; s+=4)
+		{
+			vsd = vcvtq_s32_f32 (vsubq_f32 (vlocal, vcvtq_f32_s32 (
+					vaddq_s32 (vdupq_n_s32 (s*16), vsteps))));
+			vsd = vabsq_s32 (vsd);
+			vdist = vbslq_s32 (vcgtq_s32 (vsd, vtd),
+					vaddq_s32 (vsd, vtdhalf),
+					vaddq_s32 (vtd, vshrq_n_s32 (vsd, 1)));
+			vdistf = vcvtq_f32_s32 (vdist);
+			lit = vcltq_f32 (vdistf, vmin);
+
+			vbl = vld1q_s32 ((int *)dest + s);
+			vbl = vbslq_s32 (lit, vcvtq_s32_f32 (vaddq_f32 (vcvtq_f32_s32 (vbl),
+					vmulq_n_f32 (vsubq_f32 (vrad, vdistf), 256))), vbl);
+			vst1q_s32 ((int *)dest + s, vbl);
+		}
+#else
+		__m128i		vtd, vtdhalf, vsd, vsign, vdist, vbl, gt, lit;
+		__m128		vlocal, vrad, vmin, vdistf;
+
+		vtd = _mm_set1_epi32 (td);
+		vtdhalf = _mm_set1_epi32 (td>>1);
+		vlocal = _mm_set1_ps (local0);
+		vrad = _mm_set1_ps (rad);
+		vmin = _mm_set1_ps (minlight);
+
+		for ( ; s+4 <= smax ; s+=4)
+		{
+			vsd = _mm_cvttps_epi32 (_mm_sub_ps (vlocal, _mm_cvtepi32_ps (
+					_mm_setr_epi32 (s*16, s*16+16, s*16+32, s*16+48))));
+			vsign = _mm_srai_epi32 (vsd, 31);
+			vsd = _mm_sub_epi32 (_mm_xor_si128 (vsd, vsign), vsign);
+			gt = _mm_cmpgt_epi32 (vsd, vtd);
+			vdist = _mm_or_si128 (
+					_mm_and_si128 (gt, _mm_add_epi32 (vsd, vtdhalf)),
+					_mm_andnot_si128 (gt, _mm_add_epi32 (vtd, _mm_srai_epi32 (vsd, 1))));
+			vdistf = _mm_cvtepi32_ps (vdist);
+			lit = _mm_castps_si128 (_mm_cmplt_ps (vdistf, vmin));
+
+			vbl = _mm_loadu_si128 ((__m128i *)(dest + s));
+			vbl = _mm_or_si128 (
+					_mm_and_si128 (lit, _mm_cvttps_epi32 (_mm_add_ps (
+						_mm_cvtepi32_ps (vbl),
+						_mm_mul_ps (_mm_sub_ps (vrad, vdistf), _mm_set1_ps (256))))),
+					_mm_andnot_si128 (lit, vbl));
+			_mm_storeu_si128 ((__m128i *)(dest + s), vbl);
+		}
+#endif
+	}
+#endif
+
+	for ( ; s<smax ; s++)
+	{
+		sd = local0 - s*16;
+		if (sd < 0)
+			sd = -sd;
+		if (sd > td)
+			dist = sd + (td>>1);
+		else
+			dist = td + (sd>>1);
+		if (dist < minlight)
+			dest[s] += (rad - dist)*256;
+	}
+}
 
-unsigned		blocklights[18*18];
 
 /*
 ===============
@@ -62,13 +319,16 @@ void R_AddDynamicLights (void)
 {
 	msurface_t *surf;
 	int			lnum;
-	int			sd, td;
+	int			td;
 	float		dist, rad, minlight;
 	vec3_t		impact, local;
-	int			s, t;
+	int			t;
 	int			i;
 	int			smax, tmax;
 	mtexinfo_t	*tex;
+#ifdef QUAKE2
+	int			s, sd;
+#endif
 
 	surf = r_drawsurf.surf;
 	smax = (surf->extents[0]>>4)+1;
@@ -106,6 +366,7 @@ void R_AddDynamicLights (void)
 			td = local[1] - t*16;
 			if (td < 0)
 				td = -td;
+#ifdef QUAKE2
 			for (s=0 ; s<smax ; s++)
 			{
 				sd = local[0] - s*16;
@@ -116,7 +377,6 @@ void R_AddDynamicLights (void)
 				else
 					dist = td + (sd>>1);
 				if (dist < minlight)
-#ifdef QUAKE2
 				{
 					unsigned temp;
 					temp = (rad - dist)*256;
@@ -131,10 +391,13 @@ void R_AddDynamicLights (void)
 							blocklights[i] = 0;
 					}
 				}
+			}
 #else
-					blocklights[t*smax + s] += (rad - dist)*256;
+			if (td >= minlight)
+				continue;		// every luxel in the row is at least td away
+			R_AddLightRow (blocklights + t*smax, smax, local[0], td, rad,
+					minlight);
 #endif
-			}
 		}
 	}
 }
@@ -151,9 +414,6 @@ void R_BuildLightMap (void)
 	int			smax, tmax;
 	int			t;
 	int			i, size;
-	byte		*lightmap;
-	unsigned	scale;
-	int			maps;
 	msurface_t	*surf;
 
 	surf = r_drawsurf.surf;
@@ -161,7 +421,6 @@ void R_BuildLightMap (void)
 	smax = (surf->extents[0]>>4)+1;
 	tmax = (surf->extents[1]>>4)+1;
 	size = smax*tmax;
-	lightmap = surf->samples;
 
 	if (r_fullbright.value || !cl.worldmodel->lightdata)
 	{
@@ -170,21 +429,15 @@ void R_BuildLightMap (void)
 		return;
 	}
 
-// clear to ambient
-	for (i=0 ; i<size ; i++)
-		blocklights[i] = r_refdef.ambientlight<<8;
-
-
-// add all the lightmaps
-	if (lightmap)
-		for (maps = 0 ; maps < MAXLIGHTMAPS && surf->styles[maps] != 255 ;
-			 maps++)
-		{
-			scale = r_drawsurf.lightadj[maps];	// 8.8 fraction		
-			for (i=0 ; i<size ; i++)
-				blocklights[i] += lightmap[i] * scale;
-			lightmap += size;	// skip to next lightmap
-		}
+// the styled lightmaps only change with their lightstyles, so surfaces
+// keep the sum between rebuilds
+	if (surf->staticlight && r_drawsurf.cachelight)
+	{
+		R_UpdateStaticLight (size);
+		memcpy (blocklights, surf->staticlight, size*sizeof(blocklights[0]));
+	}
+	else
+		R_CombineLightMaps (blocklights, size);
 
 // add all the dynamic lights
 	if (surf->dlightframe == r_framecount)
@@ -283,6 +536,11 @@ void R_DrawSurface (void)
 
 	if (r_pixbytes == 1)
 	{
+#if idSIMD
+		if (d_simd.value)
+			pblockdrawer = surfmiptablesimd[r_drawsurf.surfmip];
+		else
+#endif
 		pblockdrawer = surfmiptable[r_drawsurf.surfmip];
 	// TODO: only needs to be set when there is a display settings change
 		horzblockstep = blocksize;
@@ -535,6 +793,145 @@ void R_DrawSurfaceBlock8_mip3 (void)
 }
 
 
+#if idSIMD
+
+/*
+================
+R_LightRow8
+
+Lights eight texels, where texel k gets light + (7 - k) * lightstep, as
+the block drawers step from right to left.  Only the low 16 bits of the
+light value reach the colormap index, so 16 bit lanes are exact
+================
+*/
+static void R_LightRow8 (unsigned char *prowdest, unsigned char *psource,
+	int light, int lightstep)
+{
+	unsigned char	*colormap;
+#if idNEON
+	static const unsigned short	lanes[8] = {7, 6, 5, 4, 3, 2, 1, 0};
+	uint16x8_t		vi;
+
+	vi = vmlaq_u16 (vdupq_n_u16 ((unsigned short)light), vld1q_u16 (lanes),
+			vdupq_n_u16 ((unsigned short)lightstep));
+	vi = vaddq_u16 (vandq_u16 (vi, vdupq_n_u16 (0xFF00)),
+			vmovl_u8 (vld1_u8 (psource)));
+
+	colormap = (unsigned char *)vid.colormap;
+	prowdest[0] = colormap[vgetq_lane_u16 (vi, 0)];
+	prowdest[1] = colormap[vgetq_lane_u16 (vi, 1)];
+	prowdest[2] = colormap[vgetq_lane_u16 (vi, 2)];
+	prowdest[3] = colormap[vgetq_lane_u16 (vi, 3)];
+	prowdest[4] = colormap[vgetq_lane_u16 (vi, 4)];
+	prowdest[5] = colormap[vgetq_lane_u16 (vi, 5)];
+	prowdest[6] = colormap[vgetq_lane_u16 (vi, 6)];
+	prowdest[7] = colormap[vgetq_lane_u16 (vi, 7)];
+#else
+	__m128i			vi;
+
+	vi = _mm_add_epi16 (_mm_set1_epi16 ((short)light),
+			_mm_mullo_epi16 (_mm_setr_epi16 (7, 6, 5, 4, 3, 2, 1, 0),
+				_mm_set1_epi16 ((short)lightstep)));
+	vi = _mm_add_epi16 (_mm_and_si128 (vi, _mm_set1_epi16 ((short)0xFF00)),
+			_mm_unpacklo_epi8 (_mm_loadl_epi64 ((__m128i *)psource),
+				_mm_setzero_si128 ()));
+
+	colormap = (unsigned char *)vid.colormap;
+	prowdest[0] = colormap[_mm_extract_epi16 (vi, 0)];
+	prowdest[1] = colormap[_mm_extract_epi16 (vi, 1)];
+	prowdest[2] = colormap[_mm_extract_epi16 (vi, 2)];
+	prowdest[3] = colormap[_mm_extract_epi16 (vi, 3)];
+	prowdest[4] = colormap[_mm_extract_epi16 (vi, 4)];
+	prowdest[5] = colormap[_mm_extract_epi16 (vi, 5)];
+	prowdest[6] = colormap[_mm_extract_epi16 (vi, 6)];
+	prowdest[7] = colormap[_mm_extract_epi16 (vi, 7)];
+#endif
+}
+
+
+/*
+================
+R_DrawSurfaceBlock8SIMD_mip0
+
+R_DrawSurfaceBlock8_mip0 with each row lit by R_LightRow8
+================
+*/
+void R_DrawSurfaceBlock8SIMD_mip0 (void)
+{
+	int				v, i, lightstep;
+	unsigned char	*psource, *prowdest;
+
+	psource = pbasesource;
+	prowdest = prowdestbase;
+
+	for (v=0 ; v<r_numvblocks ; v++)
+	{
+		lightleft = r_lightptr[0];
+		lightright = r_lightptr[1];
+		r_lightptr += r_lightwidth;
+		lightleftstep = (r_lightptr[0] - lightleft) >> 4;
+		lightrightstep = (r_lightptr[1] - lightright) >> 4;
+
+		for (i=0 ; i<16 ; i++)
+		{
+			lightstep = (lightleft - lightright) >> 4;
+
+			R_LightRow8 (prowdest, psource, lightright + 8*lightstep, lightstep);
+			R_LightRow8 (prowdest + 8, psource + 8, lightright, lightstep);
+	
+			psource += sourcetstep;
+			lightright += lightrightstep;
+			lightleft += lightleftstep;
+			prowdest += surfrowbytes;
+		}
+
+		if (psource >= r_sourcemax)
+			psource -= r_stepback;
+	}
+}
+
+
+/*
+================
+R_DrawSurfaceBlock8SIMD_mip1
+================
+*/
+void R_DrawSurfaceBlock8SIMD_mip1 (void)
+{
+	int				v, i, lightstep;
+	unsigned char	*psource, *prowdest;
+
+	psource = pbasesource;
+	prowdest = prowdestbase;
+
+	for (v=0 ; v<r_numvblocks ; v++)
+	{
+		lightleft = r_lightptr[0];
+		lightright = r_lightptr[1];
+		r_lightptr += r_lightwidth;
+		lightleftstep = (r_lightptr[0] - lightleft) >> 3;
+		lightrightstep = (r_lightptr[1] - lightright) >> 3;
+
+		for (i=0 ; i<8 ; i++)
+		{
+			lightstep = (lightleft - lightright) >> 3;
+
+			R_LightRow8 (prowdest, psource, lightright, lightstep);
+	
+			psource += sourcetstep;
+			lightright += lightrightstep;
+			lightleft += lightleftstep;
+			prowdest += surfrowbytes;
+		}
+
+		if (psource >= r_sourcemax)
+			psource -= r_stepback;
+	}
+}
+
+#endif	// idSIMD
+
+
 /*
 ================
 R_DrawSurfaceBlock16
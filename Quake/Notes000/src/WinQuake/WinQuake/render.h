@@ -30,9 +30,9 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 typedef struct efrag_s
 {
 	struct mleaf_s		*leaf;
-	struct efrag_s		*leafnext;
-	struct entity_s		*entity;
+	struct entity_s		*entity;		// NULL on the free list
 	struct efrag_s		*entnext;
+	int					sequence;		// order it was handed out in
 } efrag_t;
 
 
@@ -81,8 +81,8 @@ typedef struct
 										//  for use in edge list
 	float		fvrectx, fvrecty;		// for floating-point compares
 	float		fvrectx_adj, fvrecty_adj; // left and top edges, for clamping
-	int			vrect_x_adj_shift20;	// (vrect.x + 0.5 - epsilon) << 20
-	int			vrectright_adj_shift20;	// (vrectright + 0.5 - epsilon) << 20
+	int			vrect_x_adj_shift20;	// (vrect.x + 0.5 - epsilon) << r_edgeshift
+	int			vrectright_adj_shift20;	// (vrectright + 0.5 - epsilon) << r_edgeshift
 	float		fvrectright_adj, fvrectbottom_adj;
 										// right and bottom edges, for clamping
 	float		fvrectright;			// rightmost edge, for Alias clamping
@@ -123,6 +123,7 @@ void R_InitSky (struct texture_s *mt);	// called at level load
 
 void R_AddEfrags (entity_t *ent);
 void R_RemoveEfrags (entity_t *ent);
+void R_ClearEfrags (void);
 
 void R_NewMap (void);
 
@@ -462,6 +462,11 @@ void SCR_SetUpToDrawConsole (void)
 		scr_conlines = vid.height/2;	// half screen
 	else
 		scr_conlines = 0;				// none visible
+
+// timedemo frame times are as short as the renderer can make them; snap the
+// console instead of sliding it so every run draws the same frames
+	if (cls.timedemo)
+		scr_con_current = scr_conlines;
 	
 	if (scr_conlines < scr_con_current)
 	{
@@ -810,6 +815,7 @@ void SCR_UpdateScreen (void)
 	static float	oldscr_viewsize;
 	static float	oldlcd_x;
 	vrect_t		vrect;
+	double		prof_start;
 	
 	if (scr_skipupdate || block_drawing)
 		return;
@@ -929,6 +935,8 @@ void SCR_UpdateScreen (void)
 		SCR_DrawPause ();
 		SCR_CheckDrawCenterString ();
 		Sbar_Draw ();
+		if (Prof_DrawOverlay ())
+			scr_copyeverything = 1;
 		SCR_DrawConsole ();
 		M_Draw ();
 	}
@@ -940,7 +948,9 @@ void SCR_UpdateScreen (void)
 		D_UpdateRects (pconupdate);
 	}
 
+	prof_start = Prof_Begin ();
 	V_UpdatePalette ();
+	Prof_End (PROF_VIEWBLEND, prof_start);
 
 //
 // update one of three areas
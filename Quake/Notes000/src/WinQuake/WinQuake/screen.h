@@ -42,6 +42,7 @@ extern	int			sb_lines;
 
 extern	int			clearnotify;	// set to 0 whenever notify text is drawn
 extern	qboolean	scr_disabled_for_loading;
+extern	qboolean	scr_drawloading;
 extern	qboolean	scr_skipupdate;
 
 extern	cvar_t		scr_viewsize;
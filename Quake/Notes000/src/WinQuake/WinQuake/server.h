@@ -210,6 +210,7 @@ extern	client_t	*host_client;
 extern	jmp_buf 	host_abortserver;
 
 extern	double		host_time;
+extern	double		sv_frametime;		// host_frametime belongs to the client
 
 extern	edict_t		*sv_player;
 
@@ -227,6 +227,13 @@ void S_Init (void)
 		shm->buffer = Hunk_AllocName(1<<16, "shmbuf");
 	}
 
+	if (!shm)
+	{
+	// no device; S_Startup left sound_started clear, so nothing mixes
+		Con_Printf ("No sound device\n");
+		return;
+	}
+
 	Con_Printf ("Sound sampling rate: %i\n", shm->speed);
 
 	// provides a tick sound until washed clean
@@ -24,6 +24,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 server_t		sv;
 server_static_t	svs;
 
+double			sv_frametime;		// length of the server frame being run
+
 char	localmodels[MAX_MODELS][5];			// inline model names for precache
 
 //============================================================================
@@ -366,6 +368,7 @@ byte	fatpvs[MAX_MAP_LEAFS/8];
 
 void SV_AddToFatPVS (vec3_t org, mnode_t *node)
 {
+	static byte	leafpvs[MAX_MAP_LEAFS/8];
 	int		i;
 	byte	*pvs;
 	mplane_t	*plane;
@@ -378,7 +381,7 @@ void SV_AddToFatPVS (vec3_t org, mnode_t *node)
 		{
 			if (node->contents != CONTENTS_SOLID)
 			{
-				pvs = Mod_LeafPVS ( (mleaf_t *)node, sv.worldmodel);
+				pvs = Mod_LeafPVSBuffer ( (mleaf_t *)node, sv.worldmodel, leafpvs);
 				for (i=0 ; i<fatbytes ; i++)
 					fatpvs[i] |= pvs[i];
 			}
@@ -819,6 +822,9 @@ SV_SendClientMessages
 void SV_SendClientMessages (void)
 {
 	int			i;
+	double		prof_start;
+
+	prof_start = Prof_Begin ();
 	
 // update frags, names, etc
 	SV_UpdateToReliableMessages ();
@@ -884,6 +890,8 @@ void SV_SendClientMessages (void)
 	
 // clear muzzle flashes
 	SV_CleanupEnts ();
+
+	Prof_End (PROF_SENDMESSAGES, prof_start);
 }
 
 
@@ -1157,7 +1165,9 @@ void SV_SpawnServer (char *server)
 	ent = EDICT_NUM(0);
 	memset (&ent->v, 0, progs->entityfields * 4);
 	ent->free = false;
-	ent->v.model = sv.worldmodel->name - pr_strings;
+// string_t is a 32 bit offset from pr_strings, so names that live outside
+// the hunk have to be copied in
+	ent->v.model = ED_NewString (sv.worldmodel->name) - pr_strings;
 	ent->v.modelindex = 1;		// world model
 	ent->v.solid = SOLID_BSP;
 	ent->v.movetype = MOVETYPE_PUSH;
@@ -1167,9 +1177,9 @@ void SV_SpawnServer (char *server)
 	else
 		pr_global_struct->deathmatch = deathmatch.value;
 
-	pr_global_struct->mapname = sv.name - pr_strings;
+	pr_global_struct->mapname = ED_NewString (sv.name) - pr_strings;
 #ifdef QUAKE2
-	pr_global_struct->startspot = sv.startspot - pr_strings;
+	pr_global_struct->startspot = ED_NewString (sv.startspot) - pr_strings;
 #endif
 
 // serverflags are for cross level information (sigils)
@@ -1183,7 +1193,7 @@ void SV_SpawnServer (char *server)
 	sv.state = ss_active;
 	
 // run two frames to allow everything to settle
-	host_frametime = 0.1;
+	sv_frametime = 0.1;
 	SV_Physics ();
 	SV_Physics ();
 
@@ -148,7 +148,7 @@ void SV_UserFriction (void)
 
 // apply friction	
 	control = speed < sv_stopspeed.value ? sv_stopspeed.value : speed;
-	newspeed = speed - host_frametime*control*friction;
+	newspeed = speed - sv_frametime*control*friction;
 	
 	if (newspeed < 0)
 		newspeed = 0;
@@ -179,7 +179,7 @@ void SV_Accelerate (vec3_t wishvel)
 	VectorSubtract (wishvel, velocity, pushvec);
 	addspeed = VectorNormalize (pushvec);
 
-	accelspeed = sv_accelerate.value*host_frametime*addspeed;
+	accelspeed = sv_accelerate.value*sv_frametime*addspeed;
 	if (accelspeed > addspeed)
 		accelspeed = addspeed;
 	
@@ -196,7 +196,7 @@ void SV_Accelerate (void)
 	addspeed = wishspeed - currentspeed;
 	if (addspeed <= 0)
 		return;
-	accelspeed = sv_accelerate.value*host_frametime*wishspeed;
+	accelspeed = sv_accelerate.value*sv_frametime*wishspeed;
 	if (accelspeed > addspeed)
 		accelspeed = addspeed;
 	
@@ -216,8 +216,8 @@ void SV_AirAccelerate (vec3_t wishveloc)
 	addspeed = wishspd - currentspeed;
 	if (addspeed <= 0)
 		return;
-//	accelspeed = sv_accelerate.value * host_frametime;
-	accelspeed = sv_accelerate.value*wishspeed * host_frametime;
+//	accelspeed = sv_accelerate.value * sv_frametime;
+	accelspeed = sv_accelerate.value*wishspeed * sv_frametime;
 	if (accelspeed > addspeed)
 		accelspeed = addspeed;
 	
@@ -232,7 +232,7 @@ void DropPunchAngle (void)
 	
 	len = VectorNormalize (sv_player->v.punchangle);
 	
-	len -= 10*host_frametime;
+	len -= 10*sv_frametime;
 	if (len < 0)
 		len = 0;
 	VectorScale (sv_player->v.punchangle, len, sv_player->v.punchangle);
@@ -277,7 +277,7 @@ void SV_WaterMove (void)
 	speed = Length (velocity);
 	if (speed)
 	{
-		newspeed = speed - host_frametime * speed * sv_friction.value;
+		newspeed = speed - sv_frametime * speed * sv_friction.value;
 		if (newspeed < 0)
 			newspeed = 0;	
 		VectorScale (velocity, newspeed/speed, velocity);
@@ -296,7 +296,7 @@ void SV_WaterMove (void)
 		return;
 
 	VectorNormalize (wishvel);
-	accelspeed = sv_accelerate.value * wishspeed * host_frametime;
+	accelspeed = sv_accelerate.value * wishspeed * sv_frametime;
 	if (accelspeed > addspeed)
 		accelspeed = addspeed;
 
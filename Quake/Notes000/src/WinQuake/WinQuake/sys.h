@@ -65,6 +65,28 @@ void Sys_Sleep (void);
 void Sys_SendKeyEvents (void);
 // Perform Key_Event () callbacks until the input que is empty
 
+//
+// threads, for running the server at its own tick rate
+//
+void *Sys_CreateThread (void (*func) (void *), void *arg);
+void Sys_WaitThread (void *thread);
+// blocks until the thread function has returned
+
+void *Sys_CreateMutex (void);
+void Sys_LockMutex (void *mutex);
+void Sys_UnlockMutex (void *mutex);
+
+void *Sys_CreateSemaphore (int count);
+void Sys_PostSemaphore (void *sem);
+void Sys_WaitSemaphore (void *sem);
+// counting semaphores, for handing work to a pool of threads
+
+qboolean Sys_IsMainThread (void);
+// false on any thread made with Sys_CreateThread
+
+void Sys_ThreadSleep (double seconds);
+// finer grained than Sys_Sleep, for threads that keep their own schedule
+
 //void Sys_LowFPPrecision (void);
 //void Sys_HighFPPrecision (void);
 void Sys_SetFPCW (void);
@@ -0,0 +1,653 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// sys_linux.c -- Linux system interface code for the dedicated server
+//
+// The main loop sleeps in epoll_wait on three descriptors: a monotonic
+// timerfd armed for the next server tick, stdin for console commands and a
+// signalfd so SIGINT/SIGTERM shut the server down cleanly.
+//
+// Built with HEADLESS_CLIENT this is also the system layer for the offscreen
+// client (vid_mem.c), which runs the full client with no display and does
+// not sleep at all while a timedemo is playing.
+
+#include "quakedef.h"
+
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+
+#define DEFAULT_MEMORY		0x2000000	// 32 Mb; 64 bit edicts and links are bigger
+
+#define MAX_EVENTS			4
+
+qboolean			isDedicated;
+
+static double		sys_timebase;		// CLOCK_MONOTONIC at startup
+static double		sys_timeoffset;		// -starttime
+
+static int			sys_epollfd = -1;
+static int			sys_timerfd = -1;
+static int			sys_signalfd = -1;
+static qboolean		sys_stdin;
+
+static pthread_t	sys_mainthread;
+
+static char			sys_inbuf[1024];	// console input not yet returned
+static int			sys_inlen;
+
+
+/*
+===============================================================================
+
+FILE IO
+
+===============================================================================
+*/
+
+#define	MAX_HANDLES		10
+FILE	*sys_handles[MAX_HANDLES];
+
+int		findhandle (void)
+{
+	int		i;
+	
+	for (i=1 ; i<MAX_HANDLES ; i++)
+		if (!sys_handles[i])
+			return i;
+	Sys_Error ("out of handles");
+	return -1;
+}
+
+/*
+================
+filelength
+================
+*/
+int filelength (FILE *f)
+{
+	int		pos;
+	int		end;
+
+	pos = ftell (f);
+	fseek (f, 0, SEEK_END);
+	end = ftell (f);
+	fseek (f, pos, SEEK_SET);
+
+	return end;
+}
+
+int Sys_FileOpenRead (char *path, int *hndl)
+{
+	FILE	*f;
+	int		i;
+
+	i = findhandle ();
+
+	f = fopen(path, "rb");
+	if (!f)
+	{
+		*hndl = -1;
+		return -1;
+	}
+	sys_handles[i] = f;
+	*hndl = i;
+	
+	return filelength(f);
+}
+
+int Sys_FileOpenWrite (char *path)
+{
+	FILE	*f;
+	int		i;
+	
+	i = findhandle ();
+
+	f = fopen(path, "wb");
+	if (!f)
+		Sys_Error ("Error opening %s: %s", path,strerror(errno));
+	sys_handles[i] = f;
+	
+	return i;
+}
+
+void Sys_FileClose (int handle)
+{
+	fclose (sys_handles[handle]);
+	sys_handles[handle] = NULL;
+}
+
+void Sys_FileSeek (int handle, int position)
+{
+	fseek (sys_handles[handle], position, SEEK_SET);
+}
+
+int Sys_FileRead (int handle, void *dest, int count)
+{
+	return fread (dest, 1, count, sys_handles[handle]);
+}
+
+int Sys_FileWrite (int handle, void *data, int count)
+{
+	return fwrite (data, 1, count, sys_handles[handle]);
+}
+
+int	Sys_FileTime (char *path)
+{
+	struct	stat	buf;
+	
+	if (stat (path,&buf) == -1)
+		return -1;
+	
+	return buf.st_mtime;
+}
+
+void Sys_mkdir (char *path)
+{
+	mkdir (path, 0777);
+}
+
+
+/*
+===============================================================================
+
+SYSTEM IO
+
+===============================================================================
+*/
+
+/*
+================
+Sys_MakeCodeWriteable
+================
+*/
+void Sys_MakeCodeWriteable (unsigned long startaddr, unsigned long length)
+{
+	unsigned long	pagesize, addr;
+
+	pagesize = getpagesize ();
+	addr = startaddr & ~(pagesize - 1);
+	length += startaddr - addr;
+
+	if (mprotect ((void *)addr, length, PROT_READ | PROT_WRITE | PROT_EXEC) == -1)
+		Sys_Error ("Protection change failed\n");
+}
+
+void Sys_SetFPCW (void)
+{
+}
+
+void Sys_DebugLog (char *file, char *fmt, ...)
+{
+	va_list		argptr;
+	FILE		*f;
+
+	f = fopen (file, "a");
+	if (!f)
+		return;
+	va_start (argptr, fmt);
+	vfprintf (f, fmt, argptr);
+	va_end (argptr);
+	fclose (f);
+}
+
+static double Sys_MonotonicTime (void)
+{
+	struct timespec	ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 0.000000001;
+}
+
+static void Sys_WatchDescriptor (int fd)
+{
+	struct epoll_event	ev;
+
+	ev.events = EPOLLIN;
+	ev.data.fd = fd;
+	if (epoll_ctl (sys_epollfd, EPOLL_CTL_ADD, fd, &ev) == -1)
+		Sys_Error ("Sys_Init: epoll_ctl: %s", strerror (errno));
+}
+
+/*
+================
+Sys_Init
+================
+*/
+void Sys_Init (void)
+{
+	struct epoll_event	ev;
+	sigset_t			mask;
+	int					j;
+
+	sys_timebase = Sys_MonotonicTime ();
+	j = COM_CheckParm ("-starttime");
+	if (j && j < com_argc-1)
+		sys_timeoffset = Q_atof (com_argv[j+1]);
+
+	sys_epollfd = epoll_create1 (0);
+	if (sys_epollfd == -1)
+		Sys_Error ("Sys_Init: epoll_create1: %s", strerror (errno));
+
+	sys_timerfd = timerfd_create (CLOCK_MONOTONIC, 0);
+	if (sys_timerfd == -1)
+		Sys_Error ("Sys_Init: timerfd_create: %s", strerror (errno));
+	Sys_WatchDescriptor (sys_timerfd);
+
+	sigemptyset (&mask);
+	sigaddset (&mask, SIGINT);
+	sigaddset (&mask, SIGTERM);
+	sigprocmask (SIG_BLOCK, &mask, NULL);
+	sys_signalfd = signalfd (-1, &mask, 0);
+	if (sys_signalfd == -1)
+		Sys_Error ("Sys_Init: signalfd: %s", strerror (errno));
+	Sys_WatchDescriptor (sys_signalfd);
+
+// stdin may be a file or /dev/null, which epoll refuses; just go without
+	ev.events = EPOLLIN;
+	ev.data.fd = 0;
+	sys_stdin = (epoll_ctl (sys_epollfd, EPOLL_CTL_ADD, 0, &ev) == 0);
+}
+
+void Sys_Error (char *error, ...)
+{
+	va_list		argptr;
+	char		text[1024];
+	static int	in_sys_error = 0;
+
+	va_start (argptr, error);
+	vsnprintf (text, sizeof(text), error, argptr);
+	va_end (argptr);
+
+	fprintf (stderr, "Error: %s\n", text);
+	fflush (stdout);
+
+	if (!in_sys_error)
+	{
+		in_sys_error = 1;
+		Host_Shutdown ();
+	}
+
+	exit (1);
+}
+
+void Sys_Printf (char *fmt, ...)
+{
+	va_list		argptr;
+	char		text[1024];
+	unsigned char	*p;
+
+	va_start (argptr,fmt);
+	vsnprintf (text, sizeof(text), fmt, argptr);
+	va_end (argptr);
+
+	for (p = (unsigned char *)text; *p; p++)
+		*p &= 0x7f;		// strip the colored text bit
+
+	fputs (text, stdout);
+	fflush (stdout);
+}
+
+void Sys_Quit (void)
+{
+	Host_Shutdown();
+	fflush (stdout);
+	exit (host_exitcode);
+}
+
+
+/*
+================
+Sys_FloatTime
+================
+*/
+double Sys_FloatTime (void)
+{
+	return Sys_MonotonicTime () - sys_timebase + sys_timeoffset;
+}
+
+
+/*
+================
+Sys_ReadStdin
+
+Only called once epoll has said stdin is readable, so the read won't block
+================
+*/
+static void Sys_ReadStdin (void)
+{
+	int		r;
+
+	if (sys_inlen == sizeof(sys_inbuf))
+		sys_inlen = 0;		// a line that long isn't a command, throw it away
+
+	r = read (0, sys_inbuf + sys_inlen, sizeof(sys_inbuf) - sys_inlen);
+	if (r > 0)
+	{
+		sys_inlen += r;
+		return;
+	}
+	if (r == -1 && errno == EINTR)
+		return;
+
+// end of file; stop watching it or epoll will report it forever
+	epoll_ctl (sys_epollfd, EPOLL_CTL_DEL, 0, NULL);
+	sys_stdin = false;
+}
+
+
+char *Sys_ConsoleInput (void)
+{
+	static char	text[256];
+	char		*nl;
+	int			len, n;
+
+	nl = memchr (sys_inbuf, '\n', sys_inlen);
+	if (!nl)
+		return NULL;
+
+	len = nl - sys_inbuf + 1;
+	n = len;
+	if (n > sizeof(text) - 2)
+		n = sizeof(text) - 2;
+	Q_memcpy (text, sys_inbuf, n);
+	text[n-1] = '\n';
+	text[n] = 0;
+
+	sys_inlen -= len;
+	memmove (sys_inbuf, sys_inbuf + len, sys_inlen);
+
+	return text;
+}
+
+void Sys_Sleep (void)
+{
+	struct timespec	ts;
+
+	ts.tv_sec = 0;
+	ts.tv_nsec = 1000000;
+	nanosleep (&ts, NULL);
+}
+
+
+void Sys_SendKeyEvents (void)
+{
+}
+
+
+/*
+===============================================================================
+
+THREADS
+
+===============================================================================
+*/
+
+typedef struct
+{
+	pthread_t	thread;
+	void		(*func) (void *);
+	void		*arg;
+} sys_thread_t;
+
+static void *Sys_ThreadStart (void *data)
+{
+	sys_thread_t	*t = data;
+	sigset_t		mask;
+
+// signals are read from the signalfd by the main thread only
+	sigfillset (&mask);
+	pthread_sigmask (SIG_BLOCK, &mask, NULL);
+
+	t->func (t->arg);
+	return NULL;
+}
+
+void *Sys_CreateThread (void (*func) (void *), void *arg)
+{
+	sys_thread_t	*t;
+
+	t = malloc (sizeof(*t));
+	if (!t)
+		Sys_Error ("Sys_CreateThread: out of memory");
+	t->func = func;
+	t->arg = arg;
+	if (pthread_create (&t->thread, NULL, Sys_ThreadStart, t))
+		Sys_Error ("Sys_CreateThread: pthread_create failed");
+	return t;
+}
+
+void Sys_WaitThread (void *thread)
+{
+	sys_thread_t	*t = thread;
+
+	pthread_join (t->thread, NULL);
+	free (t);
+}
+
+void *Sys_CreateMutex (void)
+{
+	pthread_mutex_t	*m;
+
+	m = malloc (sizeof(*m));
+	if (!m)
+		Sys_Error ("Sys_CreateMutex: out of memory");
+	pthread_mutex_init (m, NULL);
+	return m;
+}
+
+void Sys_LockMutex (void *mutex)
+{
+	pthread_mutex_lock (mutex);
+}
+
+void Sys_UnlockMutex (void *mutex)
+{
+	pthread_mutex_unlock (mutex);
+}
+
+void *Sys_CreateSemaphore (int count)
+{
+	sem_t	*s;
+
+	s = malloc (sizeof(*s));
+	if (!s)
+		Sys_Error ("Sys_CreateSemaphore: out of memory");
+	if (sem_init (s, 0, count) == -1)
+		Sys_Error ("Sys_CreateSemaphore: %s", strerror (errno));
+	return s;
+}
+
+void Sys_PostSemaphore (void *sem)
+{
+	sem_post (sem);
+}
+
+void Sys_WaitSemaphore (void *sem)
+{
+	while (sem_wait (sem) == -1 && errno == EINTR)
+		;
+}
+
+qboolean Sys_IsMainThread (void)
+{
+	return pthread_equal (pthread_self (), sys_mainthread) != 0;
+}
+
+void Sys_ThreadSleep (double seconds)
+{
+	struct timespec	ts;
+
+	if (seconds <= 0)
+		return;
+	ts.tv_sec = (time_t)seconds;
+	ts.tv_nsec = (long)((seconds - ts.tv_sec) * 1000000000.0);
+	while (nanosleep (&ts, &ts) == -1 && errno == EINTR)
+		;
+}
+
+
+/*
+==================
+Sys_WaitForTick
+
+Sleeps until Sys_FloatTime reaches when, reading console input and shutdown
+signals as they arrive
+==================
+*/
+static void Sys_WaitForTick (double when)
+{
+	struct itimerspec		its;
+	struct epoll_event		events[MAX_EVENTS];
+	struct signalfd_siginfo	si;
+	uint64_t				expirations;
+	double					abstime;
+	int						i, n;
+
+	abstime = when - sys_timeoffset + sys_timebase;
+	its.it_interval.tv_sec = 0;
+	its.it_interval.tv_nsec = 0;
+	its.it_value.tv_sec = (time_t)abstime;
+	its.it_value.tv_nsec = (long)((abstime - its.it_value.tv_sec) * 1000000000.0);
+	if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0)
+		its.it_value.tv_nsec = 1;		// zero would disarm the timer
+	timerfd_settime (sys_timerfd, TFD_TIMER_ABSTIME, &its, NULL);
+
+	while (1)
+	{
+		n = epoll_wait (sys_epollfd, events, MAX_EVENTS, -1);
+		if (n == -1)
+		{
+			if (errno == EINTR)
+				continue;
+			Sys_Error ("epoll_wait: %s", strerror (errno));
+		}
+
+		for (i = 0; i < n; i++)
+		{
+			if (events[i].data.fd == 0)
+				Sys_ReadStdin ();
+			else if (events[i].data.fd == sys_signalfd)
+			{
+				read (sys_signalfd, &si, sizeof(si));
+				Cbuf_AddText ("quit\n");
+				return;
+			}
+		}
+
+		// the timer goes last so input that arrived with it is seen this frame
+		for (i = 0; i < n; i++)
+		{
+			if (events[i].data.fd == sys_timerfd)
+			{
+				read (sys_timerfd, &expirations, sizeof(expirations));
+				return;
+			}
+		}
+	}
+}
+
+
+/*
+==================
+main
+==================
+*/
+char	*newargv[MAX_NUM_ARGVS];
+
+int main (int argc, char **argv)
+{
+	quakeparms_t	parms;
+	double			oldtime, newtime;
+	static	char	cwd[1024];
+	int				i, t;
+
+	sys_mainthread = pthread_self ();
+
+	if (!getcwd (cwd, sizeof(cwd)))
+		Sys_Error ("Couldn't determine current directory");
+
+	if (cwd[Q_strlen(cwd)-1] == '/')
+		cwd[Q_strlen(cwd)-1] = 0;
+
+	parms.basedir = cwd;
+	parms.cachedir = NULL;
+
+	for (i = 0; i < argc && i < MAX_NUM_ARGVS - 1; i++)
+		newargv[i] = argv[i];
+	for (t = 1; t < i; t++)
+		if (!Q_strcmp (newargv[t], "-dedicated"))
+			break;
+#ifdef HEADLESS_CLIENT
+	isDedicated = (t != i);
+	host_headless = !isDedicated;
+#else
+// this binary is only ever a dedicated server
+	isDedicated = true;
+	if (t == i)
+		newargv[i++] = "-dedicated";
+#endif
+
+	COM_InitArgv (i, newargv);
+
+	parms.argc = com_argc;
+	parms.argv = com_argv;
+
+	parms.memsize = DEFAULT_MEMORY;
+
+	t = COM_CheckParm ("-heapsize");
+	if (t && t < com_argc-1)
+		parms.memsize = Q_atoi (com_argv[t+1]) * 1024;
+
+	parms.membase = malloc (parms.memsize);
+	if (!parms.membase)
+		Sys_Error ("Not enough memory free\n");
+
+	Sys_Init ();
+
+	Sys_Printf ("Host_Init\n");
+	Host_Init (&parms);
+
+	oldtime = Sys_FloatTime ();
+
+	while (1)
+	{
+		if (isDedicated)
+			Sys_WaitForTick (oldtime + sys_ticrate.value);
+		else if (cls.timedemo)
+			Sys_WaitForTick (oldtime);	// just collect input
+		else
+			Sys_WaitForTick (oldtime + 1.0/72.0);
+
+		newtime = Sys_FloatTime ();
+		Host_Frame (newtime - oldtime);
+		oldtime = newtime;
+	}
+
+	return 0;
+}
@@ -41,6 +41,7 @@ static double		pfreq;
 static double		curtime = 0.0;
 static double		lastcurtime = 0.0;
 static int			lowshift;
+static qboolean		sys_timerperiod;	// timeBeginPeriod (1) is in effect
 qboolean			isDedicated;
 static qboolean		sc_return_on_enter = false;
 HANDLE				hinput, houtput;
@@ -450,7 +451,10 @@ void Sys_Quit (void)
 // shut down QHOST hooks if necessary
 	DeinitConProc ();
 
-	exit (0);
+	if (sys_timerperiod)
+		timeEndPeriod (1);
+
+	exit (host_exitcode);
 }
 
 
@@ -464,9 +468,14 @@ double Sys_FloatTime (void)
 	static int			sametimecount;
 	static unsigned int	oldtime;
 	static int			first = 1;
+	static CRITICAL_SECTION	lock;	// the server thread reads the clock too
 	LARGE_INTEGER		PerformanceCount;
 	unsigned int		temp, t2;
-	double				time;
+	double				time, now;
+
+	if (first)
+		InitializeCriticalSection (&lock);	// always called first from WinMain
+	EnterCriticalSection (&lock);
 
 	Sys_PushFPCW_SetHigh ();
 
@@ -517,7 +526,10 @@ double Sys_FloatTime (void)
 
 	Sys_PopFPCW ();
 
-    return curtime;
+	now = curtime;
+	LeaveCriticalSection (&lock);
+
+    return now;
 }
 
 
@@ -633,6 +645,123 @@ void Sys_Sleep (void)
 }
 
 
+/*
+===============================================================================
+
+THREADS
+
+===============================================================================
+*/
+
+static DWORD	sys_mainthreadid;
+
+typedef struct
+{
+	HANDLE		handle;
+	void		(*func) (void *);
+	void		*arg;
+} sys_thread_t;
+
+static DWORD WINAPI Sys_ThreadStart (LPVOID data)
+{
+	sys_thread_t	*t = data;
+
+	t->func (t->arg);
+	return 0;
+}
+
+void *Sys_CreateThread (void (*func) (void *), void *arg)
+{
+	sys_thread_t	*t;
+	DWORD			id;
+
+	t = malloc (sizeof(*t));
+	if (!t)
+		Sys_Error ("Sys_CreateThread: out of memory");
+	t->func = func;
+	t->arg = arg;
+	t->handle = CreateThread (NULL, 0, Sys_ThreadStart, t, 0, &id);
+	if (!t->handle)
+		Sys_Error ("Sys_CreateThread: CreateThread failed");
+	return t;
+}
+
+void Sys_WaitThread (void *thread)
+{
+	sys_thread_t	*t = thread;
+
+	WaitForSingleObject (t->handle, INFINITE);
+	CloseHandle (t->handle);
+	free (t);
+}
+
+void *Sys_CreateMutex (void)
+{
+	CRITICAL_SECTION	*cs;
+
+	cs = malloc (sizeof(*cs));
+	if (!cs)
+		Sys_Error ("Sys_CreateMutex: out of memory");
+	InitializeCriticalSection (cs);
+	return cs;
+}
+
+void Sys_LockMutex (void *mutex)
+{
+	EnterCriticalSection (mutex);
+}
+
+void Sys_UnlockMutex (void *mutex)
+{
+	LeaveCriticalSection (mutex);
+}
+
+void *Sys_CreateSemaphore (int count)
+{
+	HANDLE	s;
+
+	s = CreateSemaphore (NULL, count, 0x7fffffff, NULL);
+	if (!s)
+		Sys_Error ("Sys_CreateSemaphore: failed");
+	return s;
+}
+
+void Sys_PostSemaphore (void *sem)
+{
+	ReleaseSemaphore (sem, 1, NULL);
+}
+
+void Sys_WaitSemaphore (void *sem)
+{
+	WaitForSingleObject (sem, INFINITE);
+}
+
+qboolean Sys_IsMainThread (void)
+{
+	return GetCurrentThreadId () == sys_mainthreadid;
+}
+
+void Sys_ThreadSleep (double seconds)
+{
+	double	end;
+
+// Sleep rounds up to the system timer period, 15.6 ms by default, which is
+// longer than a server tick, so ask for 1 ms the first time through
+	if (!sys_timerperiod)
+	{
+		timeBeginPeriod (1);
+		sys_timerperiod = true;
+	}
+
+// Sleep only has millisecond granularity, so spin out the remainder
+	end = Sys_FloatTime () + seconds;
+	if (seconds > 0.002)
+		Sleep ((DWORD)((seconds - 0.001) * 1000));
+	while (Sys_FloatTime () < end)
+		;
+}
+
+
 void Sys_SendKeyEvents (void)
 {
     MSG        msg;
@@ -699,6 +828,7 @@ int WINAPI WinMain (HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLin
         return 0;
 
 	global_hInstance = hInstance;
+	sys_mainthreadid = GetCurrentThreadId ();
 	global_nCmdShow = nCmdShow;
 
 	lpBuffer.dwLength = sizeof(MEMORYSTATUS);
@@ -0,0 +1,544 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// vid_mem.c -- offscreen video driver that renders into system memory
+//
+// The headless client uses this in place of a real display so the renderer
+// can be timed and regression tested on a CPU only box.  Frames stay in
+// memory unless vid_dump or vid_dumpframes writes them out as PPM or PNG
+// files, and vid_checksum keeps a running hash of every frame for pixel
+// diffs between builds without writing anything at all.
+//
+// With -bpp 32 each frame is also expanded to a 32 bit surface, the way a
+// true color display driver would present it, so the cost of that output
+// path shows up in timedemos.
+
+#include "quakedef.h"
+#include "d_local.h"
+
+#define	BASEWIDTH	320
+#define	BASEHEIGHT	200
+
+byte	*vid_buffer;
+short	*zbuffer;
+byte	*surfcache;
+unsigned	*vid_buffer32;		// -bpp 32 display surface, else NULL
+unsigned	vid_lut32[256];		// display pixel for each palette index
+
+unsigned short	d_8to16table[256];
+unsigned	d_8to24table[256];
+
+byte		vid_curpal[768];		// with the current palette shift applied
+
+cvar_t		vid_dumpframes = {"vid_dumpframes", "0"};	// write every nth frame
+cvar_t		vid_dumppng = {"vid_dumppng", "0"};			// png instead of ppm
+cvar_t		vid_checksum = {"vid_checksum", "0"};		// hash every frame
+
+int			vid_framecount;			// VID_Update calls
+int			vid_dumpcount;			// frames written by vid_dumpframes
+unsigned	vid_framehash;			// last frame hashed
+unsigned	vid_runhash;			// all frames since vid_checksum was set
+int			vid_hashedframes;
+
+unsigned	vid_crctable[256];
+
+
+/*
+===============================================================================
+
+FRAME FILES
+
+===============================================================================
+*/
+
+/*
+================
+VID_PNGCRC
+
+The png chunk crc is the zip crc-32, not the ccitt one in crc.c
+================
+*/
+unsigned VID_PNGCRC (unsigned crc, byte *data, int len)
+{
+	int		i, j;
+	unsigned	c;
+
+	if (!vid_crctable[1])
+	{
+		for (i=0 ; i<256 ; i++)
+		{
+			c = i;
+			for (j=0 ; j<8 ; j++)
+				c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+			vid_crctable[i] = c;
+		}
+	}
+
+	crc = ~crc;
+	while (len--)
+		crc = vid_crctable[(crc ^ *data++) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
+
+/*
+================
+VID_PutBigLong
+================
+*/
+byte *VID_PutBigLong (byte *out, unsigned l)
+{
+	out[0] = l >> 24;
+	out[1] = l >> 16;
+	out[2] = l >> 8;
+	out[3] = l;
+	return out + 4;
+}
+
+/*
+================
+VID_PNGChunk
+
+Wraps the len bytes already stored at chunk+8 with the length, type and crc
+================
+*/
+byte *VID_PNGChunk (byte *chunk, char *type, int len)
+{
+	VID_PutBigLong (chunk, len);
+	memcpy (chunk + 4, type, 4);
+	VID_PutBigLong (chunk + 8 + len, VID_PNGCRC (0, chunk + 4, len + 4));
+	return chunk + 12 + len;
+}
+
+/*
+================
+VID_EncodePNG
+
+Writes the frame as an 8 bit paletted png.  The image data goes out as
+uncompressed deflate blocks, so there is no zlib dependency and the encoder
+costs little more than the copy.
+================
+*/
+int VID_EncodePNG (byte *out)
+{
+	static byte	signature[8] = {137, 'P', 'N', 'G', 13, 10, 26, 10};
+	byte		*p, *data, *src = NULL;
+	int			x, y, rowlen, total, left, block;
+	unsigned	a, b;
+
+	p = out;
+	memcpy (p, signature, 8);
+	p += 8;
+
+	data = p + 8;
+	data = VID_PutBigLong (data, vid.width);
+	data = VID_PutBigLong (data, vid.height);
+	data[0] = 8;		// bit depth
+	data[1] = 3;		// paletted
+	data[2] = data[3] = data[4] = 0;
+	p = VID_PNGChunk (p, "IHDR", 13);
+
+	memcpy (p + 8, vid_curpal, 768);
+	p = VID_PNGChunk (p, "PLTE", 768);
+
+// each row gets a filter type byte of 0 in front
+	data = p + 8;
+	*data++ = 0x78;		// zlib header, 32k window, no compression
+	*data++ = 0x01;
+
+	rowlen = vid.width + 1;
+	total = rowlen * vid.height;
+	left = total;
+	a = 1;
+	b = 0;
+	y = 0;
+	x = -1;
+	while (left)
+	{
+		block = left > 0xffff ? 0xffff : left;
+		left -= block;
+		*data++ = left ? 0 : 1;		// final block flag, stored
+		*data++ = block;
+		*data++ = block >> 8;
+		*data++ = ~block;
+		*data++ = ~block >> 8;
+
+		while (block--)
+		{
+			if (x < 0)
+			{
+				*data = 0;
+				src = vid.buffer + y*vid.rowbytes;
+			}
+			else
+				*data = src[x];
+
+			a = (a + *data) % 65521;
+			b = (b + a) % 65521;
+			data++;
+
+			if (++x == vid.width)
+			{
+				x = -1;
+				y++;
+			}
+		}
+	}
+	data = VID_PutBigLong (data, (b << 16) | a);
+	p = VID_PNGChunk (p, "IDAT", data - (p + 8));
+
+	p = VID_PNGChunk (p, "IEND", 0);
+
+	return p - out;
+}
+
+/*
+================
+VID_EncodePPM
+================
+*/
+int VID_EncodePPM (byte *out)
+{
+	byte		*p, *src;
+	unsigned	*src32;
+	int		x, y;
+
+	sprintf ((char *)out, "P6\n%i %i\n255\n", vid.width, vid.height);
+	p = out + strlen ((char *)out);
+
+	for (y=0 ; y<vid.height ; y++)
+	{
+		if (vid_buffer32)
+		{
+		// what was presented, rather than a second palette expansion
+			src32 = vid_buffer32 + y*vid.width;
+			for (x=0 ; x<vid.width ; x++, p+=3)
+			{
+				p[0] = src32[x] >> 16;
+				p[1] = src32[x] >> 8;
+				p[2] = src32[x];
+			}
+			continue;
+		}
+
+		src = vid.buffer + y*vid.rowbytes;
+		for (x=0 ; x<vid.width ; x++, p+=3)
+		{
+			p[0] = vid_curpal[src[x]*3+0];
+			p[1] = vid_curpal[src[x]*3+1];
+			p[2] = vid_curpal[src[x]*3+2];
+		}
+	}
+
+	return p - out;
+}
+
+/*
+================
+VID_WriteFrame
+
+The filename will be prefixed by the current game directory, and its
+extension picks the format
+================
+*/
+void VID_WriteFrame (char *filename)
+{
+	char	name[MAX_OSPATH];
+	byte	*out;
+	int		len, handle, blocks;
+
+	len = strlen (filename);
+
+// room for the larger of the two formats
+	blocks = (vid.width + 1) * vid.height / 0xffff + 1;
+	out = malloc (vid.width * vid.height * 3 + 1024 + blocks * 5);
+	if (!out)
+		Sys_Error ("VID_WriteFrame: out of memory");
+
+	if (len > 4 && !Q_strcasecmp (filename + len - 4, ".png"))
+		len = VID_EncodePNG (out);
+	else
+		len = VID_EncodePPM (out);
+
+	snprintf (name, sizeof(name), "%s/%s", com_gamedir, filename);
+	COM_CreatePath (name);
+	handle = Sys_FileOpenWrite (name);
+	if (handle == -1)
+		Con_Printf ("VID_WriteFrame: couldn't write %s\n", name);
+	else
+	{
+		Sys_FileWrite (handle, out, len);
+		Sys_FileClose (handle);
+	}
+
+	free (out);
+}
+
+/*
+================
+VID_Dump_f
+
+vid_dump [filename]
+================
+*/
+void VID_Dump_f (void)
+{
+	char	name[MAX_QPATH];
+	char	checkname[MAX_OSPATH];
+	int		i;
+
+	if (Cmd_Argc () == 2)
+	{
+		Q_strncpy (name, Cmd_Argv (1), sizeof(name) - 5);
+		name[sizeof(name) - 5] = 0;
+		COM_DefaultExtension (name, vid_dumppng.value ? ".png" : ".ppm");
+	}
+	else
+	{
+	// find a file name to save it to
+		for (i=0 ; i<=9999 ; i++)
+		{
+			snprintf (name, sizeof(name), "quake%04i.%s", i, vid_dumppng.value ? "png" : "ppm");
+			snprintf (checkname, sizeof(checkname), "%s/%s", com_gamedir, name);
+			if (Sys_FileTime (checkname) == -1)
+				break;	// file doesn't exist
+		}
+		if (i == 10000)
+		{
+			Con_Printf ("vid_dump: couldn't create a file\n");
+			return;
+		}
+	}
+
+	VID_WriteFrame (name);
+	Con_Printf ("Wrote %s\n", name);
+}
+
+/*
+================
+VID_Checksums_f
+================
+*/
+void VID_Checksums_f (void)
+{
+	if (!vid_hashedframes)
+	{
+		Con_Printf ("no frames hashed; set vid_checksum 1\n");
+		return;
+	}
+
+	Con_Printf ("frame %08x  run %08x over %i frames\n",
+			vid_framehash, vid_runhash, vid_hashedframes);
+}
+
+/*
+================
+VID_HashFrame
+
+FNV-1a over the palette indices, which is what a renderer change would alter
+================
+*/
+void VID_HashFrame (void)
+{
+	byte		*src;
+	unsigned	hash;
+	int			x, y;
+
+	if (!vid_hashedframes)
+		vid_runhash = 2166136261u;
+
+	hash = 2166136261u;
+	for (y=0 ; y<vid.height ; y++)
+	{
+		src = vid.buffer + y*vid.rowbytes;
+		for (x=0 ; x<vid.width ; x++)
+			hash = (hash ^ src[x]) * 16777619u;
+	}
+
+	vid_framehash = hash;
+	vid_runhash = (vid_runhash ^ hash) * 16777619u;
+	vid_hashedframes++;
+}
+
+
+/*
+===============================================================================
+
+DRIVER
+
+===============================================================================
+*/
+
+void	VID_SetPalette (unsigned char *palette)
+{
+	memcpy (vid_curpal, palette, sizeof(vid_curpal));
+	D_BuildPalette32 (vid_lut32, palette);
+}
+
+/*
+================
+VID_ShiftPalette
+
+Flashes and gamma changes only swap the expansion table
+================
+*/
+void	VID_ShiftPalette (unsigned char *palette)
+{
+	VID_SetPalette (palette);
+}
+
+/*
+================
+VID_Init
+
+-width and -height pick any size the renderer can allocate; the console and
+status bar still need 320x200
+================
+*/
+void	VID_Init (unsigned char *palette)
+{
+	int		i, width, height, cachesize;
+
+	Cvar_RegisterVariable (&vid_dumpframes);
+	Cvar_RegisterVariable (&vid_dumppng);
+	Cvar_RegisterVariable (&vid_checksum);
+	Cmd_AddCommand ("vid_dump", VID_Dump_f);
+	Cmd_AddCommand ("vid_checksums", VID_Checksums_f);
+
+	width = BASEWIDTH;
+	height = BASEHEIGHT;
+
+	i = COM_CheckParm ("-width");
+	if (i && i < com_argc-1)
+		width = Q_atoi (com_argv[i+1]);
+
+	i = COM_CheckParm ("-height");
+	if (i && i < com_argc-1)
+		height = Q_atoi (com_argv[i+1]);
+
+	if (width < BASEWIDTH)
+		width = BASEWIDTH;
+	if (height < BASEHEIGHT)
+		height = BASEHEIGHT;
+	width &= ~3;		// D_WarpScreen writes four pixels at a time
+
+	vid.maxwarpwidth = WARP_WIDTH;
+	vid.maxwarpheight = WARP_HEIGHT;
+	vid.width = vid.conwidth = width;
+	vid.height = vid.conheight = height;
+	vid.aspect = ((float)vid.height / (float)vid.width) *
+				(320.0 / 240.0);
+	vid.numpages = 1;
+	vid.colormap = host_colormap;
+	vid.fullbright = 256 - LittleLong (*((int *)vid.colormap + 2048));
+	vid.recalc_refdef = 1;
+
+	vid_buffer = malloc (width * height);
+	zbuffer = malloc (width * height * sizeof(*zbuffer));
+	cachesize = D_SurfaceCacheForRes (width, height);
+	surfcache = malloc (cachesize);
+	if (!vid_buffer || !zbuffer || !surfcache)
+		Sys_Error ("VID_Init: not enough memory for %ix%i", width, height);
+
+	i = COM_CheckParm ("-bpp");
+	if (i && i < com_argc-1 && Q_atoi (com_argv[i+1]) == 32)
+	{
+		vid_buffer32 = malloc (width * height * sizeof(*vid_buffer32));
+		if (!vid_buffer32)
+			Sys_Error ("VID_Init: not enough memory for %ix%i", width, height);
+	}
+
+	vid.buffer = vid.conbuffer = vid_buffer;
+	vid.rowbytes = vid.conrowbytes = width;
+
+	d_pzbuffer = zbuffer;
+	D_InitCaches (surfcache, cachesize);
+
+	VID_SetPalette (palette);
+
+	Con_Printf ("Offscreen video %ix%i, %i bit\n", width, height,
+			vid_buffer32 ? 32 : 8);
+}
+
+/*
+================
+VID_Shutdown
+
+A run with vid_checksum set reports its hash on the way out, so a timedemo
+can be compared between builds without dumping any frames
+================
+*/
+void	VID_Shutdown (void)
+{
+	if (vid_hashedframes)
+		VID_Checksums_f ();
+}
+
+/*
+================
+VID_Update
+
+Nothing to present; this is where finished frames are hashed and dumped
+================
+*/
+void	VID_Update (vrect_t *rects)
+{
+	char	name[MAX_QPATH];
+
+	vid_framecount++;
+
+	if (vid_buffer32)
+		D_Blit32 (vid_buffer32, vid.width, vid.buffer, vid.rowbytes,
+				vid.width, vid.height, vid_lut32);
+
+// frames with the console down carry timings and other text that changes
+// from run to run, and the loading plaque is drawn part way through a
+// frame, so only the settled game view is hashed
+	if (!vid_checksum.value)
+		vid_hashedframes = 0;
+	else if (!scr_con_current && !scr_drawloading &&
+		cls.state == ca_connected && cls.signon == SIGNONS)
+		VID_HashFrame ();
+
+	if (vid_dumpframes.value >= 1 &&
+		!(vid_framecount % (int)vid_dumpframes.value))
+	{
+		snprintf (name, sizeof(name), "dump/frame%05i.%s", vid_dumpcount++,
+				vid_dumppng.value ? "png" : "ppm");
+		VID_WriteFrame (name);
+	}
+}
+
+/*
+================
+D_BeginDirectRect
+================
+*/
+void D_BeginDirectRect (int x, int y, byte *pbitmap, int width, int height)
+{
+}
+
+
+/*
+================
+D_EndDirectRect
+================
+*/
+void D_EndDirectRect (int x, int y, int width, int height)
+{
+}
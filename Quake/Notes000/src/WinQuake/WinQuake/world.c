@@ -924,6 +924,9 @@ trace_t SV_Move (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, e
 {
 	moveclip_t	clip;
 	int			i;
+	double		prof_start;
+
+	prof_start = Prof_Begin ();
 
 	memset ( &clip, 0, sizeof ( moveclip_t ) );
 
@@ -957,6 +960,8 @@ trace_t SV_Move (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, e
 // clip to entities
 	SV_ClipToLinks ( sv_areanodes, &clip );
 
+	Prof_End (PROF_MOVE, prof_start);
+
 	return clip.trace;
 }
 